@@ -0,0 +1,17 @@
+package com.shockwave.pdfium;
+
+/**
+ * Renders pages with their form fields into a surface, see {@link PdfiumCore#newFormRenderer}.
+ * Keeps the page content and the form overlay as separate layers, so an edit
+ * only redraws the part of the overlay that changed.
+ * Holds two native canvases the size of the surface until released.
+ */
+public class FormRenderer {
+    /*package*/ FormRenderer(PdfDocument doc, long nativeRenderPtr){
+        mDoc = doc;
+        mNativeRenderPtr = nativeRenderPtr;
+    }
+
+    /*package*/ final PdfDocument mDoc;
+    /*package*/ long mNativeRenderPtr;
+}
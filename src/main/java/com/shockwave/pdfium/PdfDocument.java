@@ -1,16 +1,72 @@
 package com.shockwave.pdfium;
 
-import android.support.v4.util.ArrayMap;
-
-import java.util.Map;
+import java.nio.ByteBuffer;
 
 public class PdfDocument {
     public final Object Lock = new Object();
 
-    /*package*/ PdfDocument(){}
+    /*package*/ PdfDocument(PdfiumCore core){ mCore = core; }
 
     /*package*/ long mNativeDocPtr;
+    /*package*/ ByteBuffer mSourceBuffer; //Pins in-memory documents while native code reads them
+
+    /*package*/ final PdfiumCore mCore;
+
+    //Guards the worker only, so posting a task never waits for a running one
+    /*package*/ final Object mWorkerLock = new Object();
+    /*package*/ long mNativeWorkerPtr;
+    /*package*/ boolean mWorkerClosed;
+
+    //Reference counted natively, background jobs may hold it past close
+    /*package*/ final Object mSchedulerLock = new Object();
+    /*package*/ long mNativeSchedulerPtr;
+
+    /**
+     * @return Whether the page is currently loaded in the native page cache
+     */
+    public boolean hasPage(int index){ return mCore != null && mCore.hasPage(this, index); }
+
+    /**
+     * Layout data of a whole document, see {@link PdfiumCore#getDocumentMetadata}.
+     * Sizes and rectangles are in PDF points (1/72 inch).
+     */
+    public static class Metadata {
+        private static final int PAGE_RECORD_SIZE = 5;
+        private static final int LINK_RECORD_SIZE = 4;
+
+        private final float[] mData;
+        //Start of each page record in mData
+        private final int[] mPageOffsets;
+
+        /*package*/ Metadata(float[] data){
+            mData = data;
+            int pageCount = (data.length > 0)? (int)data[0] : 0;
+            mPageOffsets = new int[pageCount];
+
+            int offset = 1;
+            for(int i = 0; i < pageCount; i++){
+                mPageOffsets[i] = offset;
+                offset += PAGE_RECORD_SIZE + (int)data[offset + 4] * LINK_RECORD_SIZE;
+            }
+        }
 
-    /*package*/ final Map<Integer, Long> mNativePagesPtr = new ArrayMap<>();
-    public boolean hasPage(int index){ return mNativePagesPtr.containsKey(index); }
+        public int getPageCount(){ return mPageOffsets.length; }
+        public float getPageWidth(int index){ return mData[mPageOffsets[index]]; }
+        public float getPageHeight(int index){ return mData[mPageOffsets[index] + 1]; }
+        /**
+         * @return 0 (normal), 1 (90 degrees clockwise), 2 (180 degrees) or 3 (90 degrees counter-clockwise)
+         */
+        public int getPageRotation(int index){ return (int)mData[mPageOffsets[index] + 2]; }
+        public int getPageCharCount(int index){ return (int)mData[mPageOffsets[index] + 3]; }
+        public int getPageLinkCount(int index){ return (int)mData[mPageOffsets[index] + 4]; }
+        /**
+         * @return Link rectangle as {left, top, right, bottom} in page coordinates
+         */
+        public float[] getPageLinkRect(int index, int linkIndex){
+            int offset = mPageOffsets[index] + PAGE_RECORD_SIZE + linkIndex * LINK_RECORD_SIZE;
+            float[] rect = new float[LINK_RECORD_SIZE];
+            System.arraycopy(mData, offset, rect, 0, LINK_RECORD_SIZE);
+            return rect;
+        }
+    }
 }
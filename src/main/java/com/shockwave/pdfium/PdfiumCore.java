@@ -1,11 +1,31 @@
 package com.shockwave.pdfium;
 
+import android.content.ComponentCallbacks2;
 import android.content.Context;
+import android.graphics.Bitmap;
+import android.os.Process;
 import android.util.Log;
 import android.view.Surface;
 
+import java.io.File;
 import java.io.FileDescriptor;
+import java.io.IOException;
+import java.io.RandomAccessFile;
 import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.Callable;
+import java.util.concurrent.Future;
+import java.util.concurrent.FutureTask;
+import java.util.concurrent.ScheduledFuture;
+import java.util.concurrent.ScheduledThreadPoolExecutor;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.locks.ReentrantReadWriteLock;
 
 public class PdfiumCore {
     private static final String TAG = PdfiumCore.class.getName();
@@ -14,29 +34,228 @@ public class PdfiumCore {
         System.loadLibrary("jniPdfium");
     }
 
-    private native long nativeOpenDocument(int fd);
+    /**
+     * Map the whole file into memory, fastest for small documents
+     */
+    public static final int OPEN_MODE_MMAP = 0;
+    /**
+     * Read the file on demand through a small block cache,
+     * memory usage scales with the pages touched instead of file size
+     */
+    public static final int OPEN_MODE_STREAM = 1;
+
+    /**
+     * Don't fdatasync saved files
+     */
+    public static final long SAVE_SYNC_NONE = -1;
+    /**
+     * fdatasync saved files once, after everything was written. Any positive
+     * value instead syncs every that many bytes, plus once at the end.
+     */
+    public static final long SAVE_SYNC_AT_END = 0;
+
+    /**
+     * Progressive render status, see {@link #continueProgressiveRender}
+     */
+    public static final int RENDER_IN_PROGRESS = 1;
+    public static final int RENDER_DONE = 2;
+    public static final int RENDER_FAILED = 3;
+    public static final int RENDER_CANCELLED = 4;
+
+    /**
+     * Pixel formats renderPage can put into a Surface, see {@link #setSurfacePixelFormat}
+     */
+    public static final int PIXEL_FORMAT_RGBA_8888 = 0;
+    public static final int PIXEL_FORMAT_RGB_565 = 1;
+    //Internal, RGB_565 with dithering
+    private static final int PIXEL_FORMAT_RGB_565_DITHERED = 2;
+
+    /**
+     * How {@link #renderPageGray} reduces gray to 1, 2 or 4 bits per pixel
+     */
+    public static final int DITHER_NONE = 0;
+    public static final int DITHER_ORDERED = 1;
+    public static final int DITHER_FLOYD_STEINBERG = 2;
+
+    /**
+     * Render quality of renderPage and renderPageBitmap. Drafts are rendered at a fraction
+     * of the resolution with pdfium's cheaper image paths and scaled up, for flings and pinches.
+     */
+    public static final int QUALITY_FINAL = 0;
+    public static final int QUALITY_DRAFT = 1;
+
+    /**
+     * Form field input, see {@link #formMouseEvent} and {@link #formKeyEvent}
+     */
+    public static final int FORM_MOUSE_DOWN = 0;
+    public static final int FORM_MOUSE_UP = 1;
+    public static final int FORM_MOUSE_MOVE = 2;
+    public static final int FORM_KEY_DOWN = 3;
+    public static final int FORM_KEY_UP = 4;
+    public static final int FORM_CHAR = 5;
+
+    /**
+     * Priority classes of the work on a document, most urgent first. Work of a
+     * class waits while a more urgent class has work, and its renders give way
+     * at the next checkpoint when such work arrives. See {@link #getSchedulerStats}.
+     * Renders meant for the screen are JOB_VISIBLE, the prefetcher is
+     * JOB_NEAR_VISIBLE, thumbnail atlases JOB_THUMBNAIL and document metadata JOB_INDEXING.
+     */
+    public static final int JOB_VISIBLE = 0;
+    public static final int JOB_NEAR_VISIBLE = 1;
+    public static final int JOB_THUMBNAIL = 2;
+    public static final int JOB_INDEXING = 3;
+    private static final int JOB_CLASS_COUNT = 4;
+
+    private native long nativeOpenDocument(int fd, int mode);
+    private native boolean nativeSaveDocument(long docPtr, int fd, boolean incremental, long syncInterval);
+    private native long nativeOpenMemDocument(ByteBuffer buffer, int offset, int length);
+    private native long nativeOpenPartialDocument(int fd, long fileLength);
+    private native void nativeAddAvailableRange(long docPtr, long offset, long length);
+    private native boolean nativeIsDocumentAvailable(long docPtr);
+    private native boolean nativeIsPageAvailable(long docPtr, int pageIndex);
+    private native int nativeGetFirstAvailablePage(long docPtr);
+    private native long[] nativeGetDownloadHints(long docPtr);
     private native void nativeCloseDocument(long docPtr);
+    private native void nativeSetDocumentCacheCapacity(int capacity);
+    private native int nativeTrimDocumentCache(int keepCount);
+    private native int nativeGetOOMCount();
+    private native long nativeTrimDocument(long docPtr, int keepPercent);
+    private native long nativeTrimSharedCaches(int keepPercent);
     private native int nativeGetPageCount(long docPtr);
-    private native long nativeLoadPage(long docPtr, int pageIndex);
-    private native long[] nativeLoadPages(long docPtr, int fromIndex, int toIndex);
-    private native void nativeClosePage(long pagePtr);
-    private native void nativeClosePages(long[] pagesPtr);
-    private native int nativeGetPageWidthPixel(long pagePtr, int dpi);
-    private native int nativeGetPageHeightPixel(long pagePtr, int dpi);
+    private native boolean nativeLoadPage(long docPtr, int pageIndex);
+    private native int nativeLoadPages(long docPtr, int fromIndex, int toIndex);
+    private native boolean nativeHasPage(long docPtr, int pageIndex);
+    private native void nativeClosePage(long docPtr, int pageIndex);
+    private native void nativeSetPageCacheSize(long docPtr, int maxPages);
+    private native int nativeGetPageWidthPixel(long docPtr, int pageIndex, int dpi);
+    private native int nativeGetPageHeightPixel(long docPtr, int pageIndex, int dpi);
+    private native float[] nativeGetPageSizes(long docPtr, int dpi);
+    private native void nativeInitMetadataCache(String filePath, int maxBytes);
+    private native float[] nativeGetDocumentMetadata(long docPtr, PdfDocument document, long schedulerPtr);
     //private native long nativeGetNativeWindow(Surface surface);
     //private native void nativeRenderPage(long pagePtr, long nativeWindowPtr);
-    private native void nativeRenderPage(long pagePtr, Surface surface, int dpi,
+    private native int nativeRenderPage(long docPtr, int pageIndex, Surface surface, int dpi,
                                          int startX, int startY,
-                                         int drawSizeHor, int drawSizeVer);
+                                         int drawSizeHor, int drawSizeVer,
+                                         int pixelFormat, int draftScale, boolean offscreen,
+                                         long previewPtr, long tokenPtr);
+    private native long nativeNewPinchPreview();
+    private native void nativeRetainPinchPreview(long previewPtr);
+    private native void nativeReleasePinchPreview(long previewPtr);
+    private native int nativeRenderPinchFrame(long previewPtr, int pageIndex, Surface surface,
+                                              int startX, int startY,
+                                              int drawSizeHor, int drawSizeVer,
+                                              int pixelFormat, float maxDrift);
+    private native int nativeRenderPageTiled(long docPtr, int pageIndex, Surface surface,
+                                             int startX, int startY,
+                                             int drawSizeHor, int drawSizeVer,
+                                             long tokenPtr);
+    private native int nativeRenderPageBitmap(long docPtr, int pageIndex, Bitmap bitmap,
+                                              int startX, int startY,
+                                              int drawSizeHor, int drawSizeVer,
+                                              boolean dither, int draftScale, long tokenPtr);
+    private native int nativeRenderPageGray(long docPtr, int pageIndex, ByteBuffer buffer,
+                                            int width, int height, int stride,
+                                            int bitsPerPixel, int ditherMode,
+                                            int startX, int startY,
+                                            int drawSizeHor, int drawSizeVer,
+                                            long tokenPtr);
+    private native void nativeSetTileCacheSize(long docPtr, long maxBytes);
+    private native long[] nativeGetTileCacheStats(long docPtr);
+    private native long nativeNewPrefetcher(long docPtr);
+    private native void nativeUpdatePrefetch(long prefetcherPtr, int pageIndex, int startX,
+                                             int viewWidth, int viewHeight, int dpi, float velocity);
+    private native void nativeRunPrefetch(long prefetcherPtr, PdfDocument document, long docPtr,
+                                          long schedulerPtr);
+    private native void nativeStopPrefetch(long prefetcherPtr);
+    private native void nativeReleasePrefetcher(long prefetcherPtr);
+    private native long nativeNewRenderPool(long docPtr, int workerCount, int maxWidth, int maxHeight);
+    private native int[] nativeRenderPooled(long poolPtr, int[] pageIndices, Bitmap[] bitmaps,
+                                            int[] placements, boolean dither, long tokenPtr);
+    private native long[] nativeGetRenderPoolStats(long poolPtr);
+    private native void nativeReleaseRenderPool(long poolPtr);
+    private native int nativeRenderThumbnailAtlas(long docPtr, PdfDocument document,
+                                                  int fromIndex, int toIndex,
+                                                  int targetWidth, boolean rgb565, int fd,
+                                                  long tokenPtr, long schedulerPtr,
+                                                  ThumbnailAtlas.Listener listener);
+    private native long nativeStartProgressiveRender(long docPtr, int pageIndex,
+                                                     int canvasHorSize, int canvasVerSize,
+                                                     int startX, int startY,
+                                                     int drawSizeHor, int drawSizeVer,
+                                                     long tokenPtr);
+    private native int nativeContinueProgressiveRender(long renderPtr, int budgetMillis, Surface surface);
+    private native void nativeCloseProgressiveRender(long renderPtr);
+    private native long nativeNewViewportRender();
+    private native int nativeRenderViewport(long viewportPtr, long docPtr, int pageIndex, Surface surface,
+                                            int startX, int startY,
+                                            int drawSizeHor, int drawSizeVer,
+                                            long tokenPtr);
+    private native void nativeInvalidateViewport(long viewportPtr);
+    private native void nativeReleaseViewportRender(long viewportPtr);
+    private native boolean nativeEnableForms(long docPtr);
+    private native boolean nativeFormMouseEvent(long docPtr, int pageIndex, int event,
+                                                int deviceX, int deviceY,
+                                                int startX, int startY,
+                                                int drawSizeHor, int drawSizeVer);
+    private native boolean nativeFormKeyEvent(long docPtr, int pageIndex, int event, int code, int modifiers);
+    private native long nativeNewLayeredRender(long docPtr);
+    private native int nativeRenderLayered(long renderPtr, long docPtr, int pageIndex, Surface surface,
+                                           int startX, int startY,
+                                           int drawSizeHor, int drawSizeVer,
+                                           long tokenPtr);
+    private native void nativeReleaseLayeredRender(long renderPtr);
+    private native long nativeStartWorker(String name);
+    private native boolean nativePostTask(long workerPtr, FutureTask<?> task);
+    private native void nativeQuitWorker(long workerPtr);
+    private native long nativeNewCancelToken();
+    private native void nativeCancel(long tokenPtr);
+    private native boolean nativeIsCancelled(long tokenPtr);
+    private native long nativeGetCancelLatency(long tokenPtr);
+    private native void nativeReleaseCancelToken(long tokenPtr);
+    private native long[] nativeGetCancelLatencyStats();
+    private native long nativeNewScheduler();
+    private native void nativeRetainScheduler(long schedulerPtr);
+    private native void nativeReleaseScheduler(long schedulerPtr);
+    private native long nativeEnterJob(long schedulerPtr, int jobClass);
+    private native void nativeBeginJob(long jobPtr);
+    private native boolean nativeLeaveJob(long jobPtr);
+    private native long[] nativeGetSchedulerStats(long schedulerPtr);
 
     private static final Class FD_CLASS = FileDescriptor.class;
     private static final String FD_FIELD_NAME = "descriptor";
     private static Field mFdField = null;
 
+    private static final String METADATA_CACHE_FILE_NAME = "pdfium_metadata.cache";
+    private static final int DEFAULT_METADATA_CACHE_SIZE = 1024 * 1024;
+
+    /*
+     * Shared by the calls entering pdfium outside any document's lock (opens, the
+     * closed document cache), taken exclusively by newRenderPool while it forks
+     */
+    private static final ReentrantReadWriteLock sForkLock = new ReentrantReadWriteLock();
+
+    //Documents not closed yet, for trimMemory
+    private static final List<PdfDocument> sOpenDocuments = new ArrayList<>();
+    private static final AtomicInteger sWorkerCount = new AtomicInteger();
+
     private int mCurrentDpi;
+    private int mSurfacePixelFormat = PIXEL_FORMAT_RGBA_8888;
+    private boolean mDither565 = true;
+    private int mDraftScale = 2;
+    private long mRefineDelayMillis = 150;
+    //Refines waiting for the viewport to settle, one per Surface
+    private final Map<Surface, Refine> mRefines = new HashMap<>();
+    private ScheduledThreadPoolExecutor mRefineTimer;
+    //Surfaces keeping their last frame for pinch steps
+    private final Map<Surface, PinchPreview> mPreviews = new HashMap<>();
+    private final File mMetadataCacheFile;
 
     public PdfiumCore(Context ctx){
         mCurrentDpi = ctx.getResources().getDisplayMetrics().densityDpi;
+        mMetadataCacheFile = new File(ctx.getCacheDir(), METADATA_CACHE_FILE_NAME);
+        nativeInitMetadataCache(mMetadataCacheFile.getAbsolutePath(), DEFAULT_METADATA_CACHE_SIZE);
     }
 
     public static int getNumFd(FileDescriptor fdObj){
@@ -57,83 +276,1264 @@ public class PdfiumCore {
     }
 
     public PdfDocument newDocument(FileDescriptor fd){
-        PdfDocument document = new PdfDocument();
+        return newDocument(fd, OPEN_MODE_MMAP);
+    }
+    public PdfDocument newDocument(FileDescriptor fd, int mode){
+        PdfDocument document = new PdfDocument(this);
+
+        sForkLock.readLock().lock();
+        try{
+            document.mNativeDocPtr = nativeOpenDocument(getNumFd(fd), mode);
+            if(document.mNativeDocPtr <= 0) Log.e(TAG, "Open document failed");
+
+            return trackDocument(document);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
+    }
+
+    /**
+     * Open a document straight from memory, the remaining bytes of buffer are used in place.
+     * A direct buffer is never copied and is kept alive until the document is closed,
+     * so it must not be modified meanwhile. Heap buffers are copied into a direct one first.
+     * @throws IllegalArgumentException if the buffer has no bytes remaining
+     */
+    public PdfDocument newDocument(ByteBuffer buffer){
+        PdfDocument document = new PdfDocument(this);
+
+        if(!buffer.isDirect()){
+            ByteBuffer direct = ByteBuffer.allocateDirect(buffer.remaining());
+            direct.put(buffer.duplicate());
+            direct.flip();
+            buffer = direct;
+        }
 
-        document.mNativeDocPtr = nativeOpenDocument(getNumFd(fd));
-        if(document.mNativeDocPtr <= 0) Log.e(TAG, "Open document failed");
+        sForkLock.readLock().lock();
+        try{
+            document.mNativeDocPtr = nativeOpenMemDocument(buffer, buffer.position(), buffer.remaining());
+            if(document.mNativeDocPtr <= 0){
+                Log.e(TAG, "Open document from buffer failed");
+            }else{
+                document.mSourceBuffer = buffer;
+            }
+
+            return trackDocument(document);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
+    }
+    public PdfDocument newDocument(byte[] data){
+        ByteBuffer buffer = ByteBuffer.allocateDirect(data.length);
+        buffer.put(data);
+        buffer.flip();
+        return newDocument(buffer);
+    }
+
+    /**
+     * Open a document whose content is still arriving, e.g. being downloaded into fd.
+     * Report the byte ranges already written with {@link #notifyDataAvailable}
+     * and poll {@link #isDocumentAvailable} / {@link #isPageAvailable} before loading pages.
+     * @param fileLength Final length of the file, not the number of bytes present now
+     */
+    public PdfDocument newPartialDocument(FileDescriptor fd, long fileLength){
+        PdfDocument document = new PdfDocument(this);
 
-        return document;
+        sForkLock.readLock().lock();
+        try{
+            document.mNativeDocPtr = nativeOpenPartialDocument(getNumFd(fd), fileLength);
+            if(document.mNativeDocPtr <= 0) Log.e(TAG, "Open partial document failed");
+
+            return trackDocument(document);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
     }
+    /**
+     * Can be called from the fetcher thread, ranges arriving after closeDocument are ignored
+     */
+    public void notifyDataAvailable(PdfDocument doc, long offset, long length){
+        synchronized (doc.Lock){
+            if(doc.mNativeDocPtr <= 0) return;
+            nativeAddAvailableRange(doc.mNativeDocPtr, offset, length);
+        }
+    }
+    public boolean isDocumentAvailable(PdfDocument doc){
+        synchronized (doc.Lock){
+            return nativeIsDocumentAvailable(doc.mNativeDocPtr);
+        }
+    }
+    public boolean isPageAvailable(PdfDocument doc, int pageIndex){
+        synchronized (doc.Lock){
+            return nativeIsPageAvailable(doc.mNativeDocPtr, pageIndex);
+        }
+    }
+    /**
+     * @return Index of the page that becomes available first (linearized documents), -1 if the document isn't loaded yet
+     */
+    public int getFirstAvailablePage(PdfDocument doc){
+        synchronized (doc.Lock){
+            return nativeGetFirstAvailablePage(doc.mNativeDocPtr);
+        }
+    }
+    /**
+     * Byte ranges pdfium asked for since the last call, as (offset, size) pairs.
+     * The fetcher should prioritize them, part of a range may already be present.
+     */
+    public long[] getDownloadHints(PdfDocument doc){
+        synchronized (doc.Lock){
+            long[] hints = nativeGetDownloadHints(doc.mNativeDocPtr);
+            return (hints != null)? hints : new long[0];
+        }
+    }
+
+    /**
+     * Documents opened from a file descriptor are kept parsed for a while after
+     * {@link #closeDocument}, so opening the same unchanged file again in the same
+     * open mode skips parsing. Documents with forms enabled or saved since opening
+     * are closed for real, they may no longer match the file.
+     * @param capacity Number of closed documents to keep, 0 disables the cache. Default is 3.
+     */
+    public void setDocumentCacheCapacity(int capacity){
+        //Shrinking closes the documents evicted
+        sForkLock.readLock().lock();
+        try{
+            nativeSetDocumentCacheCapacity(capacity);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
+    }
+    /**
+     * Release cached closed documents, e.g. under memory pressure
+     * @return Number of documents released
+     */
+    public int trimDocumentCache(){
+        sForkLock.readLock().lock();
+        try{
+            return nativeTrimDocumentCache(0);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
+    }
+
+    //Under the read lock of sForkLock, so newRenderPool sees every document open
+    private PdfDocument trackDocument(PdfDocument doc){
+        if(doc.mNativeDocPtr > 0){
+            doc.mNativeSchedulerPtr = nativeNewScheduler();
+            synchronized (sOpenDocuments){
+                sOpenDocuments.add(doc);
+            }
+        }
+        return doc;
+    }
+
+    /**
+     * Release native memory according to a {@link ComponentCallbacks2} trim level,
+     * meant to be called from onTrimMemory. Idle pages and cached closed documents
+     * are released, the more the higher the level; pages being rendered are kept.
+     * @return Heap bytes freed
+     */
+    public long trimMemory(int level){
+        int keepPercent;
+        if(level >= ComponentCallbacks2.TRIM_MEMORY_BACKGROUND ||
+                level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL){
+            keepPercent = 0;
+        }else if(level >= ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN ||
+                level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW){
+            keepPercent = 25;
+        }else{
+            keepPercent = 50;
+        }
+
+        List<PdfDocument> docs;
+        synchronized (sOpenDocuments){
+            docs = new ArrayList<>(sOpenDocuments);
+        }
+
+        long freed = 0;
+        for(PdfDocument doc : docs){
+            synchronized (doc.Lock){
+                if(doc.mNativeDocPtr > 0){
+                    freed += nativeTrimDocument(doc.mNativeDocPtr, keepPercent);
+                }
+            }
+        }
+        sForkLock.readLock().lock();
+        try{
+            freed += nativeTrimSharedCaches(keepPercent);
+        }finally{
+            sForkLock.readLock().unlock();
+        }
+
+        return freed;
+    }
+
+    /**
+     * Number of native allocation failures since the library was loaded.
+     * Each one made the binding release native caches and retry the failed
+     * operation once, a growing count means the cache budgets are too large.
+     */
+    public int getOOMCount(){
+        return nativeGetOOMCount();
+    }
+
     public int getPageCount(PdfDocument doc){
         synchronized (doc.Lock){
             return nativeGetPageCount(doc.mNativeDocPtr);
         }
     }
 
-    public long openPage(PdfDocument doc, int pageIndex){
+    /**
+     * Load a page ahead of use. Pages live in a native cache bounded by
+     * {@link #setPageCacheSize}, they are reloaded on demand if evicted,
+     * so every page API takes the page index and this call is only a warm-up.
+     * @return pageIndex, or -1 if the page can't be loaded
+     */
+    public int openPage(PdfDocument doc, int pageIndex){
         synchronized (doc.Lock){
-            long pagePtr = nativeLoadPage(doc.mNativeDocPtr, pageIndex);
-            doc.mNativePagesPtr.put(pageIndex, pagePtr);
-            return pagePtr;
+            return nativeLoadPage(doc.mNativeDocPtr, pageIndex)? pageIndex : -1;
         }
     }
-    public long[] openPage(PdfDocument doc, int fromIndex, int toIndex){
+    /**
+     * @return Number of pages in the range that could be loaded
+     */
+    public int openPage(PdfDocument doc, int fromIndex, int toIndex){
         synchronized (doc.Lock){
-            long[] pagesPtr = nativeLoadPages(doc.mNativeDocPtr, fromIndex, toIndex);
-            int pageIndex = fromIndex;
-            for(long page : pagesPtr){
-                if(pageIndex > toIndex) break;
-                doc.mNativePagesPtr.put(pageIndex, page);
-                pageIndex++;
-            }
-
-            return pagesPtr;
+            return nativeLoadPages(doc.mNativeDocPtr, fromIndex, toIndex);
+        }
+    }
+    /**
+     * Release a page now instead of waiting for it to be evicted
+     */
+    public void closePage(PdfDocument doc, int pageIndex){
+        synchronized (doc.Lock){
+            nativeClosePage(doc.mNativeDocPtr, pageIndex);
+        }
+    }
+    /**
+     * @param maxPages Number of idle pages kept loaded, pages being rendered don't count. Default is 10.
+     */
+    public void setPageCacheSize(PdfDocument doc, int maxPages){
+        synchronized (doc.Lock){
+            nativeSetPageCacheSize(doc.mNativeDocPtr, maxPages);
+        }
+    }
+    /*package*/ boolean hasPage(PdfDocument doc, int pageIndex){
+        synchronized (doc.Lock){
+            return nativeHasPage(doc.mNativeDocPtr, pageIndex);
         }
     }
     public int getPageWidth(PdfDocument doc, int index){
         synchronized (doc.Lock){
-            Long pagePtr;
-            if( (pagePtr = doc.mNativePagesPtr.get(index)) != null ){
-                return nativeGetPageWidthPixel(pagePtr, mCurrentDpi);
-            }
-            return 0;
+            return nativeGetPageWidthPixel(doc.mNativeDocPtr, index, mCurrentDpi);
         }
     }
     public int getPageHeight(PdfDocument doc, int index){
         synchronized (doc.Lock){
-            Long pagePtr;
-            if( (pagePtr = doc.mNativePagesPtr.get(index)) != null ){
-                return nativeGetPageHeightPixel(pagePtr, mCurrentDpi);
-            }
-            return 0;
+            return nativeGetPageHeightPixel(doc.mNativeDocPtr, index, mCurrentDpi);
+        }
+    }
+
+    /**
+     * Size of every page in one call, without loading any page.
+     * Crop box and page rotation are already applied.
+     * @return Pixel sizes packed as [width0, height0, width1, height1, ...]
+     */
+    public float[] getPageSizes(PdfDocument doc){
+        synchronized (doc.Lock){
+            float[] sizes = nativeGetPageSizes(doc.mNativeDocPtr, mCurrentDpi);
+            return (sizes != null)? sizes : new float[0];
+        }
+    }
+
+    /**
+     * Page count, sizes, rotations, link rectangles and character counts of every page.
+     * The first call for a file loads each page once and stores the result in a sidecar
+     * in the app cache dir, later calls (also after restarts) don't load any page
+     * until the file changes. Documents not opened from a file descriptor are never stored.
+     * The document lock is only taken per page, as JOB_INDEXING work, so renders aren't
+     * held up by a long document. Call it without holding doc.Lock.
+     */
+    public PdfDocument.Metadata getDocumentMetadata(PdfDocument doc){
+        long schedulerPtr = retainScheduler(doc);
+        try{
+            float[] data = nativeGetDocumentMetadata(doc.mNativeDocPtr, doc, schedulerPtr);
+            return new PdfDocument.Metadata((data != null)? data : new float[0]);
+        }finally{
+            releaseScheduler(schedulerPtr);
         }
     }
+    /**
+     * @param maxBytes Size budget of the metadata sidecar, least recently used documents are dropped first
+     */
+    public void setMetadataCacheSize(int maxBytes){
+        nativeInitMetadataCache(mMetadataCacheFile.getAbsolutePath(), maxBytes);
+    }
+
+    /**
+     * Write a complete copy of the document into fd, which must not be the file it was opened from
+     */
+    public boolean saveAsCopy(PdfDocument doc, FileDescriptor fd){
+        return saveAsCopy(doc, fd, SAVE_SYNC_AT_END);
+    }
+    public boolean saveAsCopy(PdfDocument doc, FileDescriptor fd, long syncInterval){
+        synchronized (doc.Lock){
+            return nativeSaveDocument(doc.mNativeDocPtr, getNumFd(fd), false, syncInterval);
+        }
+    }
+    /**
+     * Save changed objects as an incremental update. When fd is the (unchanged) file
+     * the document was opened from, only the update section is appended to it,
+     * otherwise fd receives the original content followed by the update.
+     */
+    public boolean saveIncremental(PdfDocument doc, FileDescriptor fd){
+        return saveIncremental(doc, fd, SAVE_SYNC_AT_END);
+    }
+    public boolean saveIncremental(PdfDocument doc, FileDescriptor fd, long syncInterval){
+        synchronized (doc.Lock){
+            return nativeSaveDocument(doc.mNativeDocPtr, getNumFd(fd), true, syncInterval);
+        }
+    }
+
+    /**
+     * Format renderPage switches Surfaces to. RGB_565 halves the memory and bandwidth
+     * of every frame at the cost of color depth; pages are still rendered in 32 bit
+     * into a reused scratch buffer and converted.
+     * Tiled and progressive renders always use RGBA_8888.
+     */
+    public void setSurfacePixelFormat(int pixelFormat){
+        mSurfacePixelFormat = (pixelFormat == PIXEL_FORMAT_RGB_565)? PIXEL_FORMAT_RGB_565 : PIXEL_FORMAT_RGBA_8888;
+    }
+
+    /**
+     * Ordered dithering for RGB_565 Surfaces and Bitmaps, on by default. Hides banding in gradients.
+     */
+    public void setRgb565Dithering(boolean dither){
+        mDither565 = dither;
+    }
+
+    /**
+     * Drafts are rendered at 1/scale of the resolution in each direction, 2 by default
+     */
+    public void setDraftScale(int scale){
+        mDraftScale = Math.max(1, scale);
+    }
+
+    /**
+     * How long a Surface has to go without a new renderPage before its last draft
+     * is redrawn at final quality, 150ms by default. 0 turns refining off.
+     */
+    public void setRefineDelay(long millis){
+        mRefineDelayMillis = Math.max(0, millis);
+    }
 
     public void renderPage(PdfDocument doc, Surface surface, int pageIndex,
                            int startX, int startY, int drawSizeX, int drawSizeY){
+        renderPage(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Stops the render early once cancelled, may be null
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPage(PdfDocument doc, Surface surface, int pageIndex,
+                          int startX, int startY, int drawSizeX, int drawSizeY,
+                          RenderCancelToken token){
+        return renderPage(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, token, QUALITY_FINAL);
+    }
+
+    /**
+     * A draft is redrawn at final quality once no other renderPage came for the Surface
+     * within the refine delay, see setRefineDelay. Any render into the Surface drops a
+     * pending refine, so the refine never draws over a newer frame.
+     * @param quality QUALITY_FINAL or QUALITY_DRAFT
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPage(PdfDocument doc, Surface surface, int pageIndex,
+                          int startX, int startY, int drawSizeX, int drawSizeY,
+                          RenderCancelToken token, int quality){
+        cancelRefine(surface);
+        int draftScale = (quality == QUALITY_DRAFT)? mDraftScale : 1;
+        int status = renderPageToSurface(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY,
+                                         token, draftScale, false, JOB_VISIBLE);
+        if(status == RENDER_DONE && draftScale > 1){
+            scheduleRefine(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY);
+        }
+        return status;
+    }
+
+    private int renderPageToSurface(PdfDocument doc, Surface surface, int pageIndex,
+                                    int startX, int startY, int drawSizeX, int drawSizeY,
+                                    RenderCancelToken token, int draftScale, boolean offscreen,
+                                    int jobClass){
+        long job = enterJob(doc, jobClass);
+        long previewPtr;
+        synchronized (mPreviews){
+            previewPtr = retainPreview(mPreviews.get(surface));
+        }
+        try{
+            synchronized (doc.Lock){
+                beginJob(job);
+                try{
+                    return nativeRenderPage(doc.mNativeDocPtr, pageIndex, surface, mCurrentDpi,
+                                               startX, startY, drawSizeX, drawSizeY,
+                                               getSurfaceRenderFormat(), draftScale, offscreen,
+                                               previewPtr, getTokenPtr(token));
+                }catch(NullPointerException e){
+                    Log.e(TAG, "mContext may be null");
+                    e.printStackTrace();
+                }catch(Exception e){
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                }
+                return RENDER_FAILED;
+            }
+        }finally{
+            releasePreview(previewPtr);
+            leaveJob(job);
+        }
+    }
+
+    private int getSurfaceRenderFormat(){
+        if(mSurfacePixelFormat == PIXEL_FORMAT_RGB_565 && mDither565) return PIXEL_FORMAT_RGB_565_DITHERED;
+        return mSurfacePixelFormat;
+    }
+
+    /**
+     * Keep the last full quality frame renderPage draws into the Surface, for renderPinchFrame.
+     * Replaces the Surface's previous preview, release it before the Surface is destroyed.
+     * @param maxDrift How far the zoom may get from the kept frame's before pinch steps
+     *                 are rendered again, e.g. 1.5 for 1/1.5 to 1.5 times
+     */
+    public PinchPreview newPinchPreview(Surface surface, float maxDrift){
+        PinchPreview preview = new PinchPreview(surface, Math.max(1f, maxDrift), nativeNewPinchPreview());
+        PinchPreview previous;
+        synchronized (mPreviews){
+            previous = mPreviews.put(surface, preview);
+        }
+        if(previous != null) releasePinchPreview(previous);
+        return preview;
+    }
+
+    public void releasePinchPreview(PinchPreview preview){
+        long previewPtr;
+        synchronized (mPreviews){
+            if(mPreviews.get(preview.mSurface) == preview) mPreviews.remove(preview.mSurface);
+            previewPtr = preview.mNativePreviewPtr;
+            preview.mNativePreviewPtr = 0;
+        }
+        //Renders still using it hold their own reference
+        if(previewPtr != 0) nativeReleasePinchPreview(previewPtr);
+    }
+
+    private long retainPreview(PinchPreview preview){
+        if(preview == null) return 0;
+        synchronized (mPreviews){
+            if(preview.mNativePreviewPtr != 0) nativeRetainPinchPreview(preview.mNativePreviewPtr);
+            return preview.mNativePreviewPtr;
+        }
+    }
+    private void releasePreview(long previewPtr){
+        if(previewPtr != 0) nativeReleasePinchPreview(previewPtr);
+    }
+
+    /**
+     * A step of a pinch on the preview's Surface. While the zoom stays within the preview's
+     * drift of the kept frame, the frame is resampled into the Surface without waiting for
+     * the document or pdfium; otherwise, or without a frame of the page, the page is rendered
+     * at full quality and becomes the kept frame. The crisp frame follows once the gesture
+     * rests for the refine delay, or call renderPage when it ends.
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPinchFrame(PdfDocument doc, PinchPreview preview, int pageIndex,
+                                int startX, int startY, int drawSizeX, int drawSizeY){
+        Surface surface = preview.mSurface;
+        cancelRefine(surface);
+        long previewPtr = retainPreview(preview);
+        if(previewPtr != 0){
+            int status;
+            try{
+                status = nativeRenderPinchFrame(previewPtr, pageIndex, surface, startX, startY,
+                                                drawSizeX, drawSizeY, getSurfaceRenderFormat(), preview.mMaxDrift);
+            }finally{
+                releasePreview(previewPtr);
+            }
+            if(status == RENDER_DONE){
+                scheduleRefine(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY);
+                return status;
+            }
+        }
+        return renderPage(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, null, QUALITY_FINAL);
+    }
+
+    /**
+     * Render into the pixels of a bitmap instead of a Surface, placed like in renderPage
+     * with the bitmap as the canvas. Supports ARGB_8888 and RGB_565 bitmaps.
+     * @return RENDER_DONE or RENDER_FAILED
+     */
+    public int renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
+                                int startX, int startY, int drawSizeX, int drawSizeY){
+        return renderPageBitmap(doc, bitmap, pageIndex, startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Stops the render early once cancelled, may be null
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
+                                int startX, int startY, int drawSizeX, int drawSizeY,
+                                RenderCancelToken token){
+        return renderPageBitmap(doc, bitmap, pageIndex, startX, startY, drawSizeX, drawSizeY, token, QUALITY_FINAL);
+    }
+
+    /**
+     * Bitmaps aren't refined automatically, the caller renders again at QUALITY_FINAL.
+     * @param quality QUALITY_FINAL or QUALITY_DRAFT
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPageBitmap(PdfDocument doc, Bitmap bitmap, int pageIndex,
+                                int startX, int startY, int drawSizeX, int drawSizeY,
+                                RenderCancelToken token, int quality){
+        int draftScale = (quality == QUALITY_DRAFT)? mDraftScale : 1;
+        long job = enterJob(doc, JOB_VISIBLE);
+        try{
+            synchronized (doc.Lock){
+                beginJob(job);
+                return nativeRenderPageBitmap(doc.mNativeDocPtr, pageIndex, bitmap,
+                                                startX, startY, drawSizeX, drawSizeY,
+                                                mDither565, draftScale, getTokenPtr(token));
+            }
+        }finally{
+            leaveJob(job);
+        }
+    }
+
+    private class Refine implements Runnable {
+        final PdfDocument mDoc;
+        final Surface mSurface;
+        final int mPageIndex, mStartX, mStartY, mDrawSizeX, mDrawSizeY;
+        final RenderCancelToken mToken = newCancelToken();
+        ScheduledFuture<?> mTimer;
+
+        Refine(PdfDocument doc, Surface surface, int pageIndex,
+               int startX, int startY, int drawSizeX, int drawSizeY){
+            mDoc = doc;
+            mSurface = surface;
+            mPageIndex = pageIndex;
+            mStartX = startX;
+            mStartY = startY;
+            mDrawSizeX = drawSizeX;
+            mDrawSizeY = drawSizeY;
+        }
+
+        @Override
+        public void run(){
+            try{
+                //Offscreen, a refine cancelled by the next frame leaves the draft alone
+                if(mDoc.mNativeDocPtr != 0 && !mToken.isCancelled()){
+                    renderPageToSurface(mDoc, mSurface, mPageIndex, mStartX, mStartY, mDrawSizeX, mDrawSizeY,
+                                        mToken, 1, true, JOB_VISIBLE);
+                }
+            }finally{
+                synchronized (mRefines){
+                    if(mRefines.get(mSurface) == this) mRefines.remove(mSurface);
+                }
+                mToken.release();
+            }
+        }
+    }
+
+    private void scheduleRefine(PdfDocument doc, Surface surface, int pageIndex,
+                                int startX, int startY, int drawSizeX, int drawSizeY){
+        if(mRefineDelayMillis == 0) return;
+        Refine refine = new Refine(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY);
+        Refine previous;
+        synchronized (mRefines){
+            if(mRefineTimer == null){
+                mRefineTimer = new ScheduledThreadPoolExecutor(1, new ThreadFactory(){
+                    @Override
+                    public Thread newThread(Runnable r){
+                        Thread thread = new Thread(r, "PdfiumRefine");
+                        thread.setDaemon(true);
+                        return thread;
+                    }
+                });
+            }
+            refine.mTimer = mRefineTimer.schedule(refine, mRefineDelayMillis, TimeUnit.MILLISECONDS);
+            previous = mRefines.put(surface, refine);
+        }
+        if(previous != null) dropRefine(previous);
+    }
+
+    /**
+     * Drops the Surface's pending refine, a running one gives up at its next checkpoint.
+     * Call before the Surface is destroyed.
+     */
+    public void cancelRefine(Surface surface){
+        Refine refine;
+        synchronized (mRefines){
+            refine = mRefines.remove(surface);
+        }
+        if(refine != null) dropRefine(refine);
+    }
+
+    private void dropRefine(Refine refine){
+        if(refine.mTimer.cancel(false)){
+            //Never ran, nobody else has the token
+            refine.mToken.release();
+        }else{
+            refine.mToken.cancel();
+        }
+    }
+
+    /**
+     * Render thumbnails of pages fromIndex..toIndex, targetWidth pixels wide, into one
+     * atlas file on a background thread. The document is only locked while a page
+     * renders, and pages are closed again right after unless they were open already.
+     * @param config ARGB_8888 or RGB_565
+     * @return Token to cancel the job with, released by the job when it ends
+     */
+    public RenderCancelToken generateThumbnailAtlas(final PdfDocument doc, final int fromIndex, final int toIndex,
+                                                    final int targetWidth, final Bitmap.Config config,
+                                                    final File atlasFile, final ThumbnailAtlas.Listener listener){
+        final RenderCancelToken token = newCancelToken();
+        new Thread("ThumbnailAtlas"){
+            @Override
+            public void run(){
+                ThumbnailAtlas atlas = null;
+                long schedulerPtr = retainScheduler(doc);
+                try{
+                    RandomAccessFile raf = new RandomAccessFile(atlasFile, "rw");
+                    int rendered;
+                    try{
+                        rendered = nativeRenderThumbnailAtlas(doc.mNativeDocPtr, doc, fromIndex, toIndex,
+                                                                targetWidth, config == Bitmap.Config.RGB_565,
+                                                                getNumFd(raf.getFD()), token.mNativeTokenPtr,
+                                                                schedulerPtr, listener);
+                    }finally{
+                        raf.close();
+                    }
+                    if(rendered >= 0) atlas = ThumbnailAtlas.open(atlasFile);
+                }catch(IOException e){
+                    Log.e(TAG, "Generating thumbnail atlas failed", e);
+                }finally{
+                    releaseScheduler(schedulerPtr);
+                    token.release();
+                }
+                if(listener != null) listener.onFinished(atlas);
+            }
+        }.start();
+        return token;
+    }
+
+    /**
+     * Render in grayscale for e-paper panels, placed like in renderPage with the
+     * buffer as a width x height canvas. pdfium renders one byte per pixel; with 1, 2
+     * or 4 bitsPerPixel that is dithered down and packed, leftmost pixel in the most
+     * significant bits, the highest value being white.
+     * @param buffer Direct buffer of at least stride * height bytes
+     * @param dither One of DITHER_*, ignored for 8 bits per pixel
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderPageGray(PdfDocument doc, ByteBuffer buffer, int pageIndex,
+                              int width, int height, int stride, int bitsPerPixel, int dither,
+                              int startX, int startY, int drawSizeX, int drawSizeY,
+                              RenderCancelToken token){
+        if(!buffer.isDirect()) throw new IllegalArgumentException("Buffer must be direct");
+        long job = enterJob(doc, JOB_VISIBLE);
+        try{
+            synchronized (doc.Lock){
+                beginJob(job);
+                return nativeRenderPageGray(doc.mNativeDocPtr, pageIndex, buffer,
+                                            width, height, stride, bitsPerPixel, dither,
+                                            startX, startY, drawSizeX, drawSizeY, getTokenPtr(token));
+            }
+        }finally{
+            leaveJob(job);
+        }
+    }
+
+    /**
+     * Like renderPage, but composed from 256x256 tiles cached per document and zoom
+     * level, so panning only renders the tiles that scrolled into view.
+     * @return number of tiles rendered, -1 on failure
+     */
+    public int renderPageTiled(PdfDocument doc, Surface surface, int pageIndex,
+                               int startX, int startY, int drawSizeX, int drawSizeY){
+        return renderPageTiled(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Stops the render early once cancelled, may be null
+     * @return number of tiles rendered, -1 on failure or when cancelled
+     */
+    public int renderPageTiled(PdfDocument doc, Surface surface, int pageIndex,
+                               int startX, int startY, int drawSizeX, int drawSizeY,
+                               RenderCancelToken token){
+        cancelRefine(surface);
+        long job = enterJob(doc, JOB_VISIBLE);
+        try{
+            synchronized (doc.Lock){
+                beginJob(job);
+                return nativeRenderPageTiled(doc.mNativeDocPtr, pageIndex, surface,
+                                                startX, startY, drawSizeX, drawSizeY, getTokenPtr(token));
+            }
+        }finally{
+            leaveJob(job);
+        }
+    }
+
+    /**
+     * Byte budget of the document's tile cache, 0 disables it
+     */
+    public void setTileCacheSize(PdfDocument doc, long maxBytes){
+        synchronized (doc.Lock){
+            nativeSetTileCacheSize(doc.mNativeDocPtr, maxBytes);
+        }
+    }
+
+    /**
+     * Counters of the document's tile cache
+     * @return {hits, misses, tiles prefetched, prefetched tiles drawn later,
+     *          prefetched tiles evicted unused}
+     */
+    public long[] getTileCacheStats(PdfDocument doc){
+        synchronized (doc.Lock){
+            return nativeGetTileCacheStats(doc.mNativeDocPtr);
+        }
+    }
+
+    /**
+     * Start a background thread that renders the tiles of the pages a scrolling
+     * view will reach next into the tile cache, so renderPageTiled finds them there.
+     * Feed it with {@link #updatePrefetch}; it holds the document lock for one tile at a time.
+     */
+    public Prefetcher startPrefetcher(final PdfDocument doc){
+        final Prefetcher prefetcher;
+        final long docPtr;
         synchronized (doc.Lock){
+            docPtr = doc.mNativeDocPtr;
+            prefetcher = new Prefetcher(doc, nativeNewPrefetcher(docPtr));
+        }
+        prefetcher.mThread = new Thread("Prefetcher"){
+            @Override
+            public void run(){
+                Process.setThreadPriority(Process.THREAD_PRIORITY_BACKGROUND);
+                long schedulerPtr = retainScheduler(doc);
+                try{
+                    nativeRunPrefetch(prefetcher.mNativePrefetcherPtr, doc, docPtr, schedulerPtr);
+                }finally{
+                    releaseScheduler(schedulerPtr);
+                }
+            }
+        };
+        prefetcher.mThread.start();
+        return prefetcher;
+    }
+
+    /**
+     * Report the scroll state, cheap enough for every frame and never waits for the document.
+     * Pages are expected to be drawn at getPageWidthPixel/getPageHeightPixel for dpi.
+     * @param pageIndex Page mostly in view
+     * @param startX Horizontal position of that page, as passed to renderPageTiled
+     * @param velocity Pages per second, positive towards the end of the document.
+     *                 Turning around drops what was planned for the old direction.
+     */
+    public void updatePrefetch(Prefetcher prefetcher, int pageIndex, int startX,
+                               int viewWidth, int viewHeight, int dpi, float velocity){
+        synchronized (prefetcher){
+            if(prefetcher.mNativePrefetcherPtr == 0) return;
+            nativeUpdatePrefetch(prefetcher.mNativePrefetcherPtr, pageIndex, startX,
+                                    viewWidth, viewHeight, dpi, velocity);
+        }
+    }
+
+    /**
+     * Stop the prefetcher and wait for its thread, must not be called holding the document
+     */
+    public void stopPrefetcher(Prefetcher prefetcher){
+        synchronized (prefetcher){
+            if(prefetcher.mNativePrefetcherPtr == 0) return;
+            nativeStopPrefetch(prefetcher.mNativePrefetcherPtr);
+        }
+        boolean interrupted = false;
+        while(true){
             try{
-                //nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi);
-                nativeRenderPage(doc.mNativePagesPtr.get(pageIndex), surface, mCurrentDpi,
-                                    startX, startY, drawSizeX, drawSizeY);
-            }catch(NullPointerException e){
-                Log.e(TAG, "mContext may be null");
-                e.printStackTrace();
-            }catch(Exception e){
-                Log.e(TAG, "Exception throw from native");
-                e.printStackTrace();
+                prefetcher.mThread.join();
+                break;
+            }catch(InterruptedException e){
+                interrupted = true;
             }
         }
+        if(interrupted) Thread.currentThread().interrupt();
+        synchronized (prefetcher){
+            if(prefetcher.mNativePrefetcherPtr == 0) return;
+            nativeReleasePrefetcher(prefetcher.mNativePrefetcherPtr);
+            prefetcher.mNativePrefetcherPtr = 0;
+        }
     }
 
-    public void closeDocument(PdfDocument doc){
+    /**
+     * Start child processes for batch rendering of the document on all cores.
+     * pdfium can't render on several threads, so each worker is a process with
+     * its own copy of the document, forked from its current state; pages go
+     * back through shared memory. While the processes fork every open document is
+     * locked and no document is being opened, so no other thread is inside pdfium.
+     * Don't open documents while holding a document's Lock, that can deadlock with it.
+     * @param workerCount Number of processes, 0 for one per core
+     * @param maxWidth Largest bitmap width that will be rendered with it
+     * @param maxHeight Largest bitmap height that will be rendered with it
+     * @return null if no process could be started
+     */
+    public RenderPool newRenderPool(PdfDocument doc, int workerCount, int maxWidth, int maxHeight){
+        if(workerCount <= 0) workerCount = Runtime.getRuntime().availableProcessors();
+        sForkLock.writeLock().lock();
+        try{
+            List<PdfDocument> docs;
+            synchronized (sOpenDocuments){
+                docs = new ArrayList<>(sOpenDocuments);
+            }
+            long poolPtr = forkRenderPool(docs, 0, doc, workerCount, maxWidth, maxHeight);
+            return (poolPtr == 0)? null : new RenderPool(doc, poolPtr);
+        }finally{
+            sForkLock.writeLock().unlock();
+        }
+    }
+    //Takes the Lock of docs[index] and the following ones, then forks
+    private long forkRenderPool(List<PdfDocument> docs, int index, PdfDocument doc,
+                                int workerCount, int maxWidth, int maxHeight){
+        if(index == docs.size()){
+            synchronized (doc.Lock){
+                return nativeNewRenderPool(doc.mNativeDocPtr, workerCount, maxWidth, maxHeight);
+            }
+        }
+        synchronized (docs.get(index).Lock){
+            return forkRenderPool(docs, index + 1, doc, workerCount, maxWidth, maxHeight);
+        }
+    }
+
+    /**
+     * Render every page of pageIndices into the bitmap at the same position, spread
+     * over the pool's processes. Doesn't hold the document lock, the workers don't
+     * share anything with it. Bitmaps are ARGB_8888 or RGB_565 (dithered as set by
+     * setRgb565Dithering), no larger than the pool's maximum.
+     * @param placements startX, startY, drawSizeX, drawSizeY for each job like renderPageBitmap,
+     *                   null to fill each bitmap with its page
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED for each job
+     */
+    public int[] renderPagesPooled(RenderPool pool, int[] pageIndices, Bitmap[] bitmaps,
+                                   int[] placements, RenderCancelToken token){
+        if(placements == null){
+            placements = new int[bitmaps.length * 4];
+            for(int i = 0; i < bitmaps.length; i++){
+                placements[i * 4 + 2] = bitmaps[i].getWidth();
+                placements[i * 4 + 3] = bitmaps[i].getHeight();
+            }
+        }
+        synchronized (pool){
+            if(pool.mNativePoolPtr == 0) throw new IllegalStateException("Render pool released");
+            return nativeRenderPooled(pool.mNativePoolPtr, pageIndices, bitmaps,
+                                        placements, mDither565, getTokenPtr(token));
+        }
+    }
+
+    public int[] renderPagesPooled(RenderPool pool, int[] pageIndices, Bitmap[] bitmaps){
+        return renderPagesPooled(pool, pageIndices, bitmaps, null, null);
+    }
+
+    /**
+     * Throughput counters of the pool, render time over wall time is the
+     * number of cores it kept busy
+     * @return {worker processes, jobs, wall time of all batches in ns, render time summed over workers in ns}
+     */
+    public long[] getRenderPoolStats(RenderPool pool){
+        synchronized (pool){
+            if(pool.mNativePoolPtr == 0) return null;
+            return nativeGetRenderPoolStats(pool.mNativePoolPtr);
+        }
+    }
+
+    /**
+     * Stop the pool's processes, the document stays open
+     */
+    public void releaseRenderPool(RenderPool pool){
+        synchronized (pool){
+            if(pool.mNativePoolPtr == 0) return;
+            nativeReleaseRenderPool(pool.mNativePoolPtr);
+            pool.mNativePoolPtr = 0;
+        }
+    }
+
+    /**
+     * Prepare a render of the page that is carried out in time slices by
+     * {@link #continueProgressiveRender}, so heavy pages don't block for long.
+     * The canvas should have the size of the surface it will be posted to.
+     * Only one progressive render per page may be open at a time.
+     * @return null if the page can't be rendered
+     */
+    public ProgressiveRender startProgressiveRender(PdfDocument doc, int pageIndex,
+                                                    int canvasWidth, int canvasHeight,
+                                                    int startX, int startY, int drawSizeX, int drawSizeY){
+        return startProgressiveRender(doc, pageIndex, canvasWidth, canvasHeight,
+                                        startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Ends the render with RENDER_CANCELLED once cancelled, may be null.
+     *              Must not be released before the render is closed.
+     */
+    public ProgressiveRender startProgressiveRender(PdfDocument doc, int pageIndex,
+                                                    int canvasWidth, int canvasHeight,
+                                                    int startX, int startY, int drawSizeX, int drawSizeY,
+                                                    RenderCancelToken token){
+        return startProgressiveRender(doc, pageIndex, canvasWidth, canvasHeight,
+                                        startX, startY, drawSizeX, drawSizeY, token, JOB_VISIBLE);
+    }
+
+    /**
+     * @param jobClass One of JOB_*. Below JOB_VISIBLE a slice ends early with
+     *                 RENDER_IN_PROGRESS when more urgent work arrives, the next
+     *                 continueProgressiveRender resumes where it stopped.
+     */
+    public ProgressiveRender startProgressiveRender(PdfDocument doc, int pageIndex,
+                                                    int canvasWidth, int canvasHeight,
+                                                    int startX, int startY, int drawSizeX, int drawSizeY,
+                                                    RenderCancelToken token, int jobClass){
         synchronized (doc.Lock){
-            for(Integer index : doc.mNativePagesPtr.keySet()){
-                nativeClosePage(doc.mNativePagesPtr.get(index));
+            long renderPtr = nativeStartProgressiveRender(doc.mNativeDocPtr, pageIndex,
+                                                            canvasWidth, canvasHeight,
+                                                            startX, startY, drawSizeX, drawSizeY,
+                                                            getTokenPtr(token));
+            if(renderPtr == -1) return null;
+            ProgressiveRender render = new ProgressiveRender(doc, renderPtr);
+            render.mJobClass = jobClass;
+            return render;
+        }
+    }
+
+    /**
+     * Render for about budgetMillis, then post the picture so far to surface unless it is null.
+     * @return RENDER_IN_PROGRESS while more calls are needed, RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int continueProgressiveRender(ProgressiveRender render, int budgetMillis, Surface surface){
+        if(surface != null) cancelRefine(surface);
+        long job = enterJob(render.mDoc, render.mJobClass);
+        try{
+            synchronized (render.mDoc.Lock){
+                beginJob(job);
+                if(render.mNativeRenderPtr == 0) return RENDER_FAILED;
+                render.mStatus = nativeContinueProgressiveRender(render.mNativeRenderPtr, budgetMillis, surface);
+                return render.mStatus;
             }
-            doc.mNativePagesPtr.clear();
+        }finally{
+            leaveJob(job);
+        }
+    }
 
+    /**
+     * Release the render, also when it didn't finish. Must happen before its document is closed.
+     */
+    public void closeProgressiveRender(ProgressiveRender render){
+        synchronized (render.mDoc.Lock){
+            if(render.mNativeRenderPtr == 0) return;
+            nativeCloseProgressiveRender(render.mNativeRenderPtr);
+            render.mNativeRenderPtr = 0;
+        }
+    }
+
+    /**
+     * Create a renderer for one surface showing pages of the document, for
+     * scrolling: when only startX/startY changed since its last frame, the
+     * still visible part is moved and just the newly exposed strips are rendered.
+     * Release it when the surface goes away.
+     */
+    public ViewportRenderer newViewportRenderer(PdfDocument doc){
+        return new ViewportRenderer(doc, nativeNewViewportRender());
+    }
+
+    /**
+     * Like renderPage in RGBA_8888, reusing the renderer's last frame where possible.
+     * A change of page, zoom or surface size renders the whole viewport again.
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderViewport(ViewportRenderer viewport, Surface surface, int pageIndex,
+                              int startX, int startY, int drawSizeX, int drawSizeY){
+        return renderViewport(viewport, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Ends the render with RENDER_CANCELLED once cancelled, may be null.
+     *              The next frame is then rendered in full.
+     */
+    public int renderViewport(ViewportRenderer viewport, Surface surface, int pageIndex,
+                              int startX, int startY, int drawSizeX, int drawSizeY,
+                              RenderCancelToken token){
+        cancelRefine(surface);
+        long job = enterJob(viewport.mDoc, JOB_VISIBLE);
+        try{
+            synchronized (viewport.mDoc.Lock){
+                beginJob(job);
+                if(viewport.mNativeViewportPtr == 0) return RENDER_FAILED;
+                return nativeRenderViewport(viewport.mNativeViewportPtr, viewport.mDoc.mNativeDocPtr,
+                                            pageIndex, surface, startX, startY, drawSizeX, drawSizeY,
+                                            getTokenPtr(token));
+            }
+        }finally{
+            leaveJob(job);
+        }
+    }
+
+    /**
+     * Make the next renderViewport render everything, e.g. after the surface
+     * was drawn to by other means
+     */
+    public void invalidateViewport(ViewportRenderer viewport){
+        synchronized (viewport.mDoc.Lock){
+            if(viewport.mNativeViewportPtr != 0) nativeInvalidateViewport(viewport.mNativeViewportPtr);
+        }
+    }
+
+    public void releaseViewportRenderer(ViewportRenderer viewport){
+        synchronized (viewport.mDoc.Lock){
+            if(viewport.mNativeViewportPtr == 0) return;
+            nativeReleaseViewportRender(viewport.mNativeViewportPtr);
+            viewport.mNativeViewportPtr = 0;
+        }
+    }
+
+    /**
+     * Set up form filling for the document; without it form fields can't be
+     * edited and are only drawn by a FormRenderer. JavaScript isn't supported.
+     * @return false if the form environment couldn't be created
+     */
+    public boolean enableForms(PdfDocument doc){
+        synchronized (doc.Lock){
+            return nativeEnableForms(doc.mNativeDocPtr);
+        }
+    }
+
+    /**
+     * Pass a touch to the form fields of a page shown with the given placement.
+     * @param event FORM_MOUSE_DOWN, FORM_MOUSE_UP or FORM_MOUSE_MOVE
+     * @return Whether a form field handled it
+     */
+    public boolean formMouseEvent(PdfDocument doc, int pageIndex, int event, int x, int y,
+                                  int startX, int startY, int drawSizeX, int drawSizeY){
+        synchronized (doc.Lock){
+            return nativeFormMouseEvent(doc.mNativeDocPtr, pageIndex, event, x, y,
+                                        startX, startY, drawSizeX, drawSizeY);
+        }
+    }
+
+    /**
+     * Pass a key to the focused form field of a page.
+     * @param event FORM_KEY_DOWN or FORM_KEY_UP with a Windows virtual key code,
+     *              or FORM_CHAR with a UTF-16 character
+     * @param modifiers FWL_EVENTFLAG_* bits as in fpdf_fwlevent.h
+     * @return Whether a form field handled it
+     */
+    public boolean formKeyEvent(PdfDocument doc, int pageIndex, int event, int code, int modifiers){
+        synchronized (doc.Lock){
+            return nativeFormKeyEvent(doc.mNativeDocPtr, pageIndex, event, code, modifiers);
+        }
+    }
+
+    /**
+     * Create a renderer drawing pages with their form fields into one surface;
+     * enables forms for the document. Release it before closing the document.
+     * @return null if forms can't be enabled
+     */
+    public FormRenderer newFormRenderer(PdfDocument doc){
+        synchronized (doc.Lock){
+            long renderPtr = nativeNewLayeredRender(doc.mNativeDocPtr);
+            if(renderPtr == -1) return null;
+            return new FormRenderer(doc, renderPtr);
+        }
+    }
+
+    /**
+     * Like renderPage in RGBA_8888, with forms and annotations. The page content
+     * is only rendered again when page, placement or surface size changed.
+     * @return RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public int renderFormPage(FormRenderer renderer, Surface surface, int pageIndex,
+                              int startX, int startY, int drawSizeX, int drawSizeY){
+        return renderFormPage(renderer, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, null);
+    }
+
+    /**
+     * @param token Stops rendering the page content with RENDER_CANCELLED once cancelled,
+     *              may be null. The frame is still posted.
+     */
+    public int renderFormPage(FormRenderer renderer, Surface surface, int pageIndex,
+                              int startX, int startY, int drawSizeX, int drawSizeY,
+                              RenderCancelToken token){
+        cancelRefine(surface);
+        long job = enterJob(renderer.mDoc, JOB_VISIBLE);
+        try{
+            synchronized (renderer.mDoc.Lock){
+                beginJob(job);
+                if(renderer.mNativeRenderPtr == 0) return RENDER_FAILED;
+                return nativeRenderLayered(renderer.mNativeRenderPtr, renderer.mDoc.mNativeDocPtr,
+                                           pageIndex, surface, startX, startY, drawSizeX, drawSizeY,
+                                           getTokenPtr(token));
+            }
+        }finally{
+            leaveJob(job);
+        }
+    }
+
+    public void releaseFormRenderer(FormRenderer renderer){
+        synchronized (renderer.mDoc.Lock){
+            if(renderer.mNativeRenderPtr == 0) return;
+            nativeReleaseLayeredRender(renderer.mNativeRenderPtr);
+            renderer.mNativeRenderPtr = 0;
+        }
+    }
+
+    public RenderCancelToken newCancelToken(){
+        return new RenderCancelToken(this, nativeNewCancelToken());
+    }
+
+    /*package*/ void cancel(RenderCancelToken token){ nativeCancel(token.mNativeTokenPtr); }
+    /*package*/ boolean isCancelled(RenderCancelToken token){ return nativeIsCancelled(token.mNativeTokenPtr); }
+    /*package*/ long getCancelLatency(RenderCancelToken token){ return nativeGetCancelLatency(token.mNativeTokenPtr); }
+    /*package*/ void releaseCancelToken(RenderCancelToken token){ nativeReleaseCancelToken(token.mNativeTokenPtr); }
+
+    private static long getTokenPtr(RenderCancelToken token){
+        return (token != null)? token.mNativeTokenPtr : 0;
+    }
+
+    /**
+     * How long cancelled renders took to give up, over all tokens
+     * @return {count, total nanoseconds, max nanoseconds}
+     */
+    public long[] getCancelLatencyStats(){
+        return nativeGetCancelLatencyStats();
+    }
+
+    //A reference on the document's scheduler for background work, 0 once closed
+    private long retainScheduler(PdfDocument doc){
+        synchronized (doc.mSchedulerLock){
+            if(doc.mNativeSchedulerPtr != 0) nativeRetainScheduler(doc.mNativeSchedulerPtr);
+            return doc.mNativeSchedulerPtr;
+        }
+    }
+    private void releaseScheduler(long schedulerPtr){
+        if(schedulerPtr != 0) nativeReleaseScheduler(schedulerPtr);
+    }
+
+    /*
+     * A job of jobClass around one hold of doc.Lock: enterJob before taking the
+     * lock (it waits for more urgent work), beginJob once held, leaveJob after.
+     */
+    private long enterJob(PdfDocument doc, int jobClass){
+        long schedulerPtr = retainScheduler(doc);
+        if(schedulerPtr == 0) return 0;
+        try{
+            return nativeEnterJob(schedulerPtr, jobClass);
+        }finally{
+            nativeReleaseScheduler(schedulerPtr);
+        }
+    }
+    private void beginJob(long job){
+        if(job != 0) nativeBeginJob(job);
+    }
+    //True if the job's render gave way to more urgent work
+    private boolean leaveJob(long job){
+        return job != 0 && nativeLeaveJob(job);
+    }
+
+    /**
+     * Queueing of the document's work per priority class, see JOB_*
+     * @return For each class in JOB_* order: {jobs run, renders preempted,
+     *         total wait ns, max wait ns, waiting now, max waiting}
+     */
+    public long[] getSchedulerStats(PdfDocument doc){
+        long schedulerPtr = retainScheduler(doc);
+        if(schedulerPtr == 0) return new long[JOB_CLASS_COUNT * 6];
+        try{
+            return nativeGetSchedulerStats(schedulerPtr);
+        }finally{
+            nativeReleaseScheduler(schedulerPtr);
+        }
+    }
+
+    /**
+     * Run a task on the document's own worker thread, started with the first task.
+     * Tasks of one document run one after the other in the order submitted, tasks of
+     * different documents in parallel, and the caller never waits for the document.
+     * Tasks still pending when the document is closed get cancelled.
+     */
+    public <T> Future<T> submit(PdfDocument doc, Callable<T> task){
+        FutureTask<T> future = new FutureTask<T>(task);
+        synchronized (doc.mWorkerLock){
+            if(!doc.mWorkerClosed && doc.mNativeWorkerPtr == 0){
+                doc.mNativeWorkerPtr = nativeStartWorker("PdfDocument-" + sWorkerCount.incrementAndGet());
+            }
+            if(doc.mNativeWorkerPtr == 0){
+                future.cancel(false);
+            }else{
+                nativePostTask(doc.mNativeWorkerPtr, future);
+            }
+        }
+        return future;
+    }
+
+    /**
+     * renderPage on the document's worker thread, see {@link #submit}
+     * @return Future of RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public Future<Integer> renderPageAsync(final PdfDocument doc, final Surface surface, final int pageIndex,
+                                           final int startX, final int startY,
+                                           final int drawSizeX, final int drawSizeY,
+                                           final RenderCancelToken token){
+        return submit(doc, new Callable<Integer>(){
+            @Override
+            public Integer call(){
+                return renderPage(doc, surface, pageIndex, startX, startY, drawSizeX, drawSizeY, token);
+            }
+        });
+    }
+
+    /**
+     * renderPageBitmap on the document's worker thread, see {@link #submit}
+     * @return Future of RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED
+     */
+    public Future<Integer> renderPageBitmapAsync(final PdfDocument doc, final Bitmap bitmap, final int pageIndex,
+                                                 final int startX, final int startY,
+                                                 final int drawSizeX, final int drawSizeY,
+                                                 final RenderCancelToken token){
+        return submit(doc, new Callable<Integer>(){
+            @Override
+            public Integer call(){
+                return renderPageBitmap(doc, bitmap, pageIndex, startX, startY, drawSizeX, drawSizeY, token);
+            }
+        });
+    }
+
+    public void closeDocument(PdfDocument doc){
+        //Outside doc.Lock, the running task may be waiting for it
+        long workerPtr;
+        synchronized (doc.mWorkerLock){
+            workerPtr = doc.mNativeWorkerPtr;
+            doc.mNativeWorkerPtr = 0;
+            doc.mWorkerClosed = true;
+        }
+        if(workerPtr != 0) nativeQuitWorker(workerPtr);
+
+        synchronized (doc.Lock){
+            //Pages are closed natively along with the document
             nativeCloseDocument(doc.mNativeDocPtr);
+            doc.mNativeDocPtr = 0;
+            doc.mSourceBuffer = null;
+        }
+        //Background jobs may still hold references
+        synchronized (doc.mSchedulerLock){
+            releaseScheduler(doc.mNativeSchedulerPtr);
+            doc.mNativeSchedulerPtr = 0;
+        }
+        synchronized (sOpenDocuments){
+            sOpenDocuments.remove(doc);
         }
     }
 }
@@ -0,0 +1,19 @@
+package com.shockwave.pdfium;
+
+import android.view.Surface;
+
+/**
+ * The last full quality frame of a Surface, resampled to draw the steps of a
+ * pinch without rendering, see {@link PdfiumCore#newPinchPreview}.
+ */
+public class PinchPreview {
+    /*package*/ PinchPreview(Surface surface, float maxDrift, long nativePreviewPtr){
+        mSurface = surface;
+        mMaxDrift = maxDrift;
+        mNativePreviewPtr = nativePreviewPtr;
+    }
+
+    /*package*/ final Surface mSurface;
+    /*package*/ final float mMaxDrift;
+    /*package*/ long mNativePreviewPtr;
+}
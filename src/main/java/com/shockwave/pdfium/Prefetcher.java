@@ -0,0 +1,16 @@
+package com.shockwave.pdfium;
+
+/**
+ * Background renderer filling a document's tile cache with the pages a
+ * scrolling view is about to show, see {@link PdfiumCore#startPrefetcher}.
+ */
+public class Prefetcher {
+    /*package*/ Prefetcher(PdfDocument doc, long nativePrefetcherPtr){
+        mDoc = doc;
+        mNativePrefetcherPtr = nativePrefetcherPtr;
+    }
+
+    /*package*/ final PdfDocument mDoc;
+    /*package*/ long mNativePrefetcherPtr;
+    /*package*/ Thread mThread;
+}
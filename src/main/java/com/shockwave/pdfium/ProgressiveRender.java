@@ -0,0 +1,23 @@
+package com.shockwave.pdfium;
+
+/**
+ * A page render split into time slices, see {@link PdfiumCore#startProgressiveRender}.
+ * Holds native memory and keeps its page loaded until closed.
+ */
+public class ProgressiveRender {
+    /*package*/ ProgressiveRender(PdfDocument doc, long nativeRenderPtr){
+        mDoc = doc;
+        mNativeRenderPtr = nativeRenderPtr;
+    }
+
+    /*package*/ final PdfDocument mDoc;
+    /*package*/ long mNativeRenderPtr;
+
+    /*package*/ int mStatus = PdfiumCore.RENDER_IN_PROGRESS;
+    /*package*/ int mJobClass = PdfiumCore.JOB_VISIBLE;
+
+    /**
+     * @return One of PdfiumCore.RENDER_*, as returned by the last continueProgressiveRender
+     */
+    public int getStatus(){ return mStatus; }
+}
@@ -0,0 +1,38 @@
+package com.shockwave.pdfium;
+
+/**
+ * Lets another thread stop a render early, see {@link PdfiumCore#newCancelToken}.
+ * cancel() doesn't wait for the document lock; the render notices within a few
+ * milliseconds, gives up and releases the lock.
+ * One token per render job, release it once the render it was passed to returned.
+ */
+public class RenderCancelToken {
+    /*package*/ RenderCancelToken(PdfiumCore core, long nativeTokenPtr){
+        mCore = core;
+        mNativeTokenPtr = nativeTokenPtr;
+    }
+
+    /*package*/ final PdfiumCore mCore;
+    /*package*/ long mNativeTokenPtr;
+
+    public synchronized void cancel(){
+        if(mNativeTokenPtr != 0) mCore.cancel(this);
+    }
+
+    public synchronized boolean isCancelled(){
+        return mNativeTokenPtr != 0 && mCore.isCancelled(this);
+    }
+
+    /**
+     * @return Nanoseconds between cancel() and the render giving up, -1 if that didn't happen (yet)
+     */
+    public synchronized long getCancelLatencyNanos(){
+        return (mNativeTokenPtr != 0)? mCore.getCancelLatency(this) : -1;
+    }
+
+    public synchronized void release(){
+        if(mNativeTokenPtr == 0) return;
+        mCore.releaseCancelToken(this);
+        mNativeTokenPtr = 0;
+    }
+}
@@ -0,0 +1,15 @@
+package com.shockwave.pdfium;
+
+/**
+ * Child processes rendering a document in parallel, each with its own copy of
+ * it, see {@link PdfiumCore#newRenderPool}.
+ */
+public class RenderPool {
+    /*package*/ RenderPool(PdfDocument doc, long nativePoolPtr){
+        mDoc = doc;
+        mNativePoolPtr = nativePoolPtr;
+    }
+
+    /*package*/ final PdfDocument mDoc;
+    /*package*/ long mNativePoolPtr;
+}
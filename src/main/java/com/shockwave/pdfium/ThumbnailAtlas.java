@@ -0,0 +1,117 @@
+package com.shockwave.pdfium;
+
+import android.graphics.Bitmap;
+
+import java.io.File;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+
+/**
+ * Thumbnails of a range of pages packed into one file, written by
+ * {@link PdfiumCore#generateThumbnailAtlas}. The file is mapped, not read,
+ * and each thumbnail is a slice of the mapping.
+ */
+public class ThumbnailAtlas {
+    public interface Listener {
+        /**
+         * Called on the generating thread after every page
+         */
+        void onProgress(int pageIndex, int done, int total);
+        /**
+         * @param atlas null if generating failed or was cancelled
+         */
+        void onFinished(ThumbnailAtlas atlas);
+    }
+
+    //Keep in sync with thumbnailAtlas.hpp
+    private static final int MAGIC = ('_' << 24) + ('P' << 16) + ('T' << 8) + 'A';
+    private static final int VERSION = 1;
+    private static final int HEADER_SIZE = 16;
+    private static final int ENTRY_SIZE = 24;
+    private static final int FORMAT_RGB_565 = 1;
+    private static final int ENTRY_RENDERED = 0x1;
+
+    private final MappedByteBuffer mBuffer;
+    private final Bitmap.Config mConfig;
+    private final int mEntryCount;
+    private final int mFirstPage;
+
+    private ThumbnailAtlas(MappedByteBuffer buffer){
+        mBuffer = buffer;
+        mBuffer.order(ByteOrder.nativeOrder());
+        if(mBuffer.getInt(0) != MAGIC || mBuffer.getInt(4) != VERSION){
+            throw new IllegalArgumentException("Not a thumbnail atlas");
+        }
+        mConfig = (mBuffer.getInt(8) == FORMAT_RGB_565)? Bitmap.Config.RGB_565 : Bitmap.Config.ARGB_8888;
+        mEntryCount = mBuffer.getInt(12);
+        mFirstPage = (mEntryCount > 0)? mBuffer.getInt(HEADER_SIZE) : 0;
+    }
+
+    public static ThumbnailAtlas open(File file) throws IOException{
+        RandomAccessFile raf = new RandomAccessFile(file, "r");
+        try{
+            FileChannel channel = raf.getChannel();
+            //The mapping stays valid after the file is closed
+            return new ThumbnailAtlas(channel.map(FileChannel.MapMode.READ_ONLY, 0, channel.size()));
+        }catch(IllegalArgumentException e){
+            throw new IOException(e.getMessage());
+        }finally{
+            raf.close();
+        }
+    }
+
+    public int getFirstPage(){ return mFirstPage; }
+    public int getPageCount(){ return mEntryCount; }
+    public Bitmap.Config getConfig(){ return mConfig; }
+
+    private int getEntryOffset(int pageIndex){
+        int entry = pageIndex - mFirstPage;
+        if(entry < 0 || entry >= mEntryCount) return -1;
+        return HEADER_SIZE + entry * ENTRY_SIZE;
+    }
+
+    public boolean hasThumbnail(int pageIndex){
+        int entry = getEntryOffset(pageIndex);
+        return entry >= 0 && (mBuffer.getInt(entry + 12) & ENTRY_RENDERED) != 0;
+    }
+    public int getWidth(int pageIndex){
+        int entry = getEntryOffset(pageIndex);
+        return (entry >= 0)? mBuffer.getInt(entry + 4) : 0;
+    }
+    public int getHeight(int pageIndex){
+        int entry = getEntryOffset(pageIndex);
+        return (entry >= 0)? mBuffer.getInt(entry + 8) : 0;
+    }
+
+    /**
+     * @return The raw pixels of the page in the atlas config, rows without padding, or null
+     */
+    public ByteBuffer getPixels(int pageIndex){
+        if(!hasThumbnail(pageIndex)) return null;
+        int entry = getEntryOffset(pageIndex);
+        int bytesPerPixel = (mConfig == Bitmap.Config.RGB_565)? 2 : 4;
+        int size = mBuffer.getInt(entry + 4) * mBuffer.getInt(entry + 8) * bytesPerPixel;
+
+        ByteBuffer pixels = mBuffer.duplicate();
+        pixels.position((int)mBuffer.getLong(entry + 16));
+        pixels = pixels.slice();
+        pixels.limit(size);
+        return pixels;
+    }
+
+    /**
+     * @return A new bitmap holding a copy of the thumbnail, or null
+     */
+    public Bitmap getBitmap(int pageIndex){
+        ByteBuffer pixels = getPixels(pageIndex);
+        if(pixels == null) return null;
+
+        Bitmap bitmap = Bitmap.createBitmap(getWidth(pageIndex), getHeight(pageIndex), mConfig);
+        bitmap.copyPixelsFromBuffer(pixels);
+        return bitmap;
+    }
+}
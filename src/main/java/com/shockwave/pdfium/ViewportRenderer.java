@@ -0,0 +1,17 @@
+package com.shockwave.pdfium;
+
+/**
+ * Renders a page into a surface while keeping the last frame, see
+ * {@link PdfiumCore#newViewportRenderer}. Scrolling at a fixed zoom then only
+ * renders the strips that came into view.
+ * Holds a native canvas the size of the surface until released.
+ */
+public class ViewportRenderer {
+    /*package*/ ViewportRenderer(PdfDocument doc, long nativeViewportPtr){
+        mDoc = doc;
+        mNativeViewportPtr = nativeViewportPtr;
+    }
+
+    /*package*/ final PdfDocument mDoc;
+    /*package*/ long mNativeViewportPtr;
+}
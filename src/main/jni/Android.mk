@@ -25,8 +25,29 @@ LOCAL_MODULE := jniPdfium
 LOCAL_CFLAGS += -DHAVE_PTHREADS
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
 LOCAL_SHARED_LIBRARIES += aospPdfium
-LOCAL_LDLIBS += -llog -landroid
-
-LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp
+LOCAL_LDLIBS += -llog -landroid -ljnigraphics
+
+LOCAL_SRC_FILES :=  $(LOCAL_PATH)/src/mainJNILib.cpp \
+                    $(LOCAL_PATH)/src/documentFile.cpp \
+                    $(LOCAL_PATH)/src/pageCache.cpp \
+                    $(LOCAL_PATH)/src/oomHandler.cpp \
+                    $(LOCAL_PATH)/src/fileAccess.cpp \
+                    $(LOCAL_PATH)/src/dataAvail.cpp \
+                    $(LOCAL_PATH)/src/metadataCache.cpp \
+                    $(LOCAL_PATH)/src/tileCache.cpp \
+                    $(LOCAL_PATH)/src/progressiveRender.cpp \
+                    $(LOCAL_PATH)/src/renderControl.cpp \
+                    $(LOCAL_PATH)/src/bitmapRender.cpp \
+                    $(LOCAL_PATH)/src/pixelConvert.cpp \
+                    $(LOCAL_PATH)/src/thumbnailAtlas.cpp \
+                    $(LOCAL_PATH)/src/scratchBuffer.cpp \
+                    $(LOCAL_PATH)/src/viewportRender.cpp \
+                    $(LOCAL_PATH)/src/formFill.cpp \
+                    $(LOCAL_PATH)/src/layeredRender.cpp \
+                    $(LOCAL_PATH)/src/prefetch.cpp \
+                    $(LOCAL_PATH)/src/serialWorker.cpp \
+                    $(LOCAL_PATH)/src/renderPool.cpp \
+                    $(LOCAL_PATH)/src/jobScheduler.cpp \
+                    $(LOCAL_PATH)/src/pinchPreview.cpp
 
 include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,151 @@
+#include "hostTest.hpp"
+#include "fileAccess.hpp"
+#include "dataAvail.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+}
+
+#include <string>
+#include <vector>
+
+static const size_t kFileSize = BlockFileReader::kBlockSize * 4 + 1000;
+
+//Content the file should end up with, distinct per offset
+static unsigned char expectedByte(size_t offset){
+    return (unsigned char)((offset * 31 + offset / 251) | 1);
+}
+
+static void writeRange(int fd, size_t offset, size_t size){
+    std::vector<unsigned char> data(size);
+    size_t i;
+    for(i = 0; i < size; i++) data[i] = expectedByte(offset + i);
+    CHECK(pwrite(fd, &data[0], size, (off_t)offset) == (ssize_t)size);
+}
+
+static bool readMatches(BlockFileReader &reader, size_t offset, size_t size){
+    std::vector<unsigned char> data(size);
+    FPDF_FILEACCESS *access = reader.getFileAccess();
+    if(!access->m_GetBlock(access->m_Param, (unsigned long)offset, &data[0], (unsigned long)size)) return false;
+    size_t i;
+    for(i = 0; i < size; i++){
+        if(data[i] != expectedByte(offset + i)) return false;
+    }
+    return true;
+}
+
+static int openTempFile(){
+    char path[] = "/tmp/fileAccessTestXXXXXX";
+    int fd = mkstemp(path);
+    if(fd >= 0) unlink(path);
+    return fd;
+}
+
+//A preallocated file filled out of order, like a download following pdfium's hints
+static void testPreallocatedOutOfOrder(){
+    int fd = openTempFile();
+    CHECK(fd >= 0);
+    CHECK(ftruncate(fd, kFileSize) == 0);
+
+    AvailabilityTracker tracker;
+    BlockFileReader reader(fd, kFileSize);
+    reader.setAvailability(&tracker);
+    CHECK(reader.isValid());
+
+    //Tail first, the first block is still a hole of zeros
+    size_t tail = BlockFileReader::kBlockSize * 3;
+    writeRange(fd, tail, kFileSize - tail);
+    tracker.addRange(tail, kFileSize - tail);
+    CHECK(readMatches(reader, tail + 100, 300));
+    CHECK(!readMatches(reader, 10, 300));
+
+    //The head arrives, what was read from the hole must not come back
+    writeRange(fd, 0, tail);
+    tracker.addRange(0, tail);
+    CHECK(readMatches(reader, 10, 300));
+    CHECK(readMatches(reader, BlockFileReader::kBlockSize - 50, 100));
+    CHECK(readMatches(reader, 0, kFileSize));
+    close(fd);
+}
+
+//A file appended to while it is read, shorter than its final length at first
+static void testGrowingFile(){
+    int fd = openTempFile();
+    CHECK(fd >= 0);
+
+    AvailabilityTracker tracker;
+    BlockFileReader reader(fd, kFileSize);
+    reader.setAvailability(&tracker);
+
+    size_t written = 0;
+    while(written < kFileSize){
+        size_t chunk = 7000;
+        if(chunk > kFileSize - written) chunk = kFileSize - written;
+        writeRange(fd, written, chunk);
+        written += chunk;
+        tracker.addRange(0, written);
+
+        //Reads straddling the edge of the data pull in partial blocks
+        size_t from = (written > 500)? written - 500 : 0;
+        CHECK(readMatches(reader, from, written - from));
+        CHECK(readMatches(reader, 0, (written < 200)? written : 200));
+    }
+    CHECK(readMatches(reader, 0, kFileSize));
+    close(fd);
+}
+
+//Complete files cache every block, reads across block edges still line up
+static void testCompleteFile(){
+    int fd = openTempFile();
+    CHECK(fd >= 0);
+    writeRange(fd, 0, kFileSize);
+
+    BlockFileReader reader(fd, kFileSize);
+    size_t offset;
+    for(offset = 0; offset + 4096 <= kFileSize; offset += 4001){
+        CHECK(readMatches(reader, offset, 4096));
+    }
+    CHECK(readMatches(reader, kFileSize - 10, 10));
+    CHECK(!readMatches(reader, kFileSize - 10, 20));
+    close(fd);
+}
+
+static uint64_t fingerprintOf(const std::string &content){
+    int fd = openTempFile();
+    CHECK(fd >= 0);
+    CHECK(pwrite(fd, content.data(), content.size(), 0) == (ssize_t)content.size());
+    uint64_t fingerprint = getDocumentFingerprint(fd, (int64_t)content.size());
+    close(fd);
+    return fingerprint;
+}
+
+//The /ID of a classic trailer, and of an xref stream dictionary far from the end of the file
+static void testFingerprint(){
+    std::string body = "%PDF-1.4\n1 0 obj\n<< /Type /Catalog >>\nendobj\n";
+    std::string trailer = "trailer\n<< /Size 2 /Root 1 0 R\n/ID [<0A1B2C> <3D4E5F>] >>\nstartxref\n9\n%%EOF\n";
+    uint64_t classic = fingerprintOf(body + "xref\n0 2\n" + trailer);
+    CHECK(classic != 0);
+    //Whitespace inside the array doesn't matter, the second ID does
+    CHECK(fingerprintOf(body + std::string(3000, ' ') + "xref\n0 2\n" + trailer) == classic);
+    std::string resaved = trailer;
+    resaved.replace(resaved.find("3D4E5F"), 6, "3D4E60");
+    CHECK(fingerprintOf(body + "xref\n0 2\n" + resaved) != classic);
+    CHECK(fingerprintOf(body + "trailer\n<< /Size 2 /Root 1 0 R >>\nstartxref\n9\n%%EOF\n") == 0);
+
+    std::string xrefObject = "2 0 obj\n<< /Type /XRef /Size 3 /ID [<0A1B2C><3D4E5F>] /Length 4000 >>\nstream\n";
+    char offset[32];
+    snprintf(offset, sizeof(offset), "%d", (int)body.size());
+    std::string streamed = body + xrefObject + std::string(4000, 'x') + "\nendstream\nendobj\nstartxref\n" +
+                           offset + "\n%%EOF\n";
+    CHECK(fingerprintOf(streamed) == classic);
+}
+
+int main(){
+    testPreallocatedOutOfOrder();
+    testGrowingFile();
+    testCompleteFile();
+    testFingerprint();
+    return hostTestResult("fileAccessTest");
+}
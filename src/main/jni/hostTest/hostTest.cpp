@@ -0,0 +1,23 @@
+#include "hostTest.hpp"
+
+#include <android/log.h>
+
+extern "C" {
+    #include <stdio.h>
+    #include <stdarg.h>
+}
+
+int sHostTestFailures = 0;
+
+//Warnings and errors go to stderr, the rest is dropped
+int __android_log_print(int prio, const char *tag, const char *fmt, ...){
+    if(prio < ANDROID_LOG_WARN) return 0;
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int ret = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return ret;
+}
@@ -0,0 +1,35 @@
+#ifndef _HOST_TEST_HPP_
+#define _HOST_TEST_HPP_
+
+extern "C" {
+    #include <stdio.h>
+    #include <stdint.h>
+    #include <time.h>
+}
+
+//Failures are counted and reported, main() returns hostTestResult()
+extern int sHostTestFailures;
+
+#define CHECK(cond) do{ \
+        if(!(cond)){ \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            sHostTestFailures++; \
+        } \
+    }while(0)
+
+static inline int hostTestResult(const char *name){
+    if(sHostTestFailures == 0){
+        printf("%s: passed\n", name);
+        return 0;
+    }
+    printf("%s: %d checks failed\n", name, sHostTestFailures);
+    return 1;
+}
+
+static inline int64_t hostTimeNanos(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#endif
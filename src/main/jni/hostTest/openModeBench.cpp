@@ -0,0 +1,163 @@
+#include "hostTest.hpp"
+#include "testDocument.hpp"
+#include "fileAccess.hpp"
+#include "bitmapRender.hpp"
+#include "oomHandler.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/wait.h>
+}
+
+/*
+ * OPEN_MODE_MMAP against OPEN_MODE_STREAM on a large drawing set: time to the
+ * first page on screen (open, load and render page 0 at 1080 pixels wide) and
+ * the peak resident memory and address space that took. Each run is a fresh
+ * process, with the file dropped from the page cache first for the cold runs.
+ * Needs a host build of pdfium, see the Makefile.
+ */
+
+static const int kPageCount = 160;
+static const size_t kImageBytes = 1536 * 1024;
+static const int kScreenWidth = 1080;
+static const int kRuns = 3;
+
+//No OOM handler on the host, nothing to retry for
+OOMRetry::OOMRetry(PageCache *pages) : pages(pages), oomCountBefore(0), retried(false) {}
+bool OOMRetry::shouldRetry(){ return false; }
+
+struct RunResult {
+    bool ok;
+    double openMillis;
+    double firstPageMillis;
+    long baselineKb;
+    long peakKb;
+    long baselineVirtualKb;
+    long peakVirtualKb;
+};
+
+static long readStatusKb(const char *field){
+    FILE *status = fopen("/proc/self/status", "r");
+    if(status == NULL) return -1;
+    char line[256];
+    long kb = -1;
+    size_t length = strlen(field);
+    while(fgets(line, sizeof(line), status) != NULL){
+        if(strncmp(line, field, length) == 0 && line[length] == ':'){
+            kb = atol(line + length + 1);
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+//Same steps as loadMappedDocument / loadStreamingDocument, then page 0 on a screen
+static RunResult openAndRender(const char *path, bool stream){
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    FPDF_InitLibrary(NULL);
+    result.baselineKb = readStatusKb("VmRSS");
+    result.baselineVirtualKb = readStatusKb("VmSize");
+
+    int64_t start = hostTimeNanos();
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return result;
+    size_t fileSize = (size_t)lseek(fd, 0, SEEK_END);
+
+    FPDF_DOCUMENT doc;
+    if(stream){
+        BlockFileReader *reader = new BlockFileReader(fd, fileSize);
+        doc = FPDF_LoadCustomDocument(reader->getFileAccess(), NULL);
+    }else{
+        void *map = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) return result;
+        doc = FPDF_LoadMemDocument(map, (int)fileSize, NULL);
+    }
+    if(doc == NULL) return result;
+    result.openMillis = (hostTimeNanos() - start) / 1e6;
+
+    FPDF_PAGE page = FPDF_LoadPage(doc, 0);
+    if(page == NULL) return result;
+    int height = (int)(kScreenWidth * FPDF_GetPageHeight(page) / FPDF_GetPageWidth(page));
+    void *pixels = malloc((size_t)kScreenWidth * height * 4);
+    RenderStatus status = renderPageToBuffer( page, pixels, kScreenWidth, height, kScreenWidth * 4,
+                                              PIXEL_FORMAT_RGBA_8888, 0, 0, kScreenWidth, height, NULL );
+    result.firstPageMillis = (hostTimeNanos() - start) / 1e6;
+    result.peakKb = readStatusKb("VmHWM");
+    result.peakVirtualKb = readStatusKb("VmPeak");
+    result.ok = (status == RENDER_DONE);
+    return result;
+}
+
+static RunResult runInChild(const char *path, bool stream){
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    int fds[2];
+    if(pipe(fds) != 0) return result;
+
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        RunResult childResult = openAndRender(path, stream);
+        ssize_t written = write(fds[1], &childResult, sizeof(childResult));
+        _exit(written == (ssize_t)sizeof(childResult)? 0 : 1);
+    }
+    close(fds[1]);
+    if(pid > 0){
+        if(read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result)) result.ok = false;
+        waitpid(pid, NULL, 0);
+    }
+    close(fds[0]);
+    return result;
+}
+
+static void dropFromPageCache(const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+int main(){
+    char path[] = "/tmp/openModeBenchXXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0) return 1;
+    size_t fileSize = writeTestDocument(fd, kPageCount, kImageBytes);
+    close(fd);
+    if(fileSize == 0){
+        unlink(path);
+        return 1;
+    }
+    printf("openModeBench: %d pages, %.1f MB, first page at %d pixels wide\n",
+           kPageCount, fileSize / 1048576.0, kScreenWidth);
+
+    int failures = 0;
+    int cold, run, stream;
+    for(cold = 1; cold >= 0; cold--){
+        for(run = 0; run < kRuns; run++){
+            for(stream = 0; stream < 2; stream++){
+                if(cold) dropFromPageCache(path);
+                RunResult result = runInChild(path, stream != 0);
+                if(!result.ok){
+                    printf("  %s %s: failed\n", stream? "stream" : "mmap  ", cold? "cold" : "warm");
+                    failures++;
+                    continue;
+                }
+                printf("  %s %s  open %7.1f ms  first page %7.1f ms  peak RSS +%6.1f MB  address space +%6.1f MB\n",
+                       stream? "stream" : "mmap  ", cold? "cold" : "warm",
+                       result.openMillis, result.firstPageMillis,
+                       (result.peakKb - result.baselineKb) / 1024.0,
+                       (result.peakVirtualKb - result.baselineVirtualKb) / 1024.0);
+            }
+        }
+    }
+
+    unlink(path);
+    return (failures == 0)? 0 : 1;
+}
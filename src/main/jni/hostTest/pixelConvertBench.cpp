@@ -0,0 +1,57 @@
+#include "hostTest.hpp"
+#include "pixelConvert.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+}
+
+#include <vector>
+
+/*
+ * Pinch frames: resampleRGBxBilinear against its scalar reference on full
+ * screen frames, zooming out, in a little and in twice. On x86 the vector
+ * path is SSE2; NEON has to be measured on a device.
+ */
+
+static const int kRepeats = 10;
+
+static double resampleMillis(bool vector, const std::vector<uint8_t> &src, std::vector<uint8_t> &dst,
+                             int width, int height, double zoom){
+    double step = 1 / zoom;
+    double xOrigin = (width - width * step) / 2, yOrigin = (height - height * step) / 2;
+    int64_t start = hostTimeNanos();
+    int i;
+    for(i = 0; i < kRepeats; i++){
+        if(vector){
+            resampleRGBxBilinear(&src[0], width * 4, width, height, &dst[0], width * 4, width, height,
+                                 xOrigin, step, yOrigin, step);
+        }else{
+            resampleRGBxBilinearScalar(&src[0], width * 4, width, height, &dst[0], width * 4, width, height,
+                                       xOrigin, step, yOrigin, step);
+        }
+    }
+    return (hostTimeNanos() - start) / 1e6 / kRepeats;
+}
+
+int main(){
+    static const int sizes[][2] = { { 1920, 1080 }, { 2560, 1440 } };
+    static const double zooms[] = { 0.8, 1.25, 2.0 };
+
+    printf("pixelConvertBench: resampleRGBxBilinear, ms per frame\n");
+    int s, z;
+    for(s = 0; s < 2; s++){
+        int width = sizes[s][0], height = sizes[s][1];
+        std::vector<uint8_t> src((size_t)width * height * 4);
+        std::vector<uint8_t> dst(src.size());
+        size_t i;
+        for(i = 0; i < src.size(); i++) src[i] = (uint8_t)rand();
+
+        for(z = 0; z < 3; z++){
+            double scalar = resampleMillis(false, src, dst, width, height, zooms[z]);
+            double vector = resampleMillis(true, src, dst, width, height, zooms[z]);
+            printf("  %dx%d zoom %.2f  scalar %6.2f  vector %6.2f  speedup %.1f\n",
+                   width, height, zooms[z], scalar, vector, scalar / vector);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "hostTest.hpp"
+#include "pixelConvert.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+}
+
+#include <vector>
+
+static std::vector<uint8_t> randomPixels(int width, int height){
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+    size_t i;
+    for(i = 0; i < pixels.size(); i++) pixels[i] = (uint8_t)rand();
+    return pixels;
+}
+
+//The vector kernels of resampleRGBxBilinear must match the scalar reference bit for bit
+static void testResampleMatchesScalar(){
+    int i;
+    for(i = 0; i < 300; i++){
+        int srcWidth = 1 + rand() % 97, srcHeight = 1 + rand() % 53;
+        int dstWidth = 1 + rand() % 131, dstHeight = 1 + rand() % 41;
+        std::vector<uint8_t> src = randomPixels(srcWidth, srcHeight);
+        std::vector<uint8_t> vector((size_t)dstWidth * dstHeight * 4);
+        std::vector<uint8_t> scalar(vector.size());
+
+        //Zooms in and out, origins on and off the source
+        double xStep = (rand() % 400 + 10) / 100.0, yStep = (rand() % 400 + 10) / 100.0;
+        double xOrigin = (rand() % 2000 - 1000) / 100.0, yOrigin = (rand() % 2000 - 1000) / 100.0;
+        resampleRGBxBilinear(&src[0], srcWidth * 4, srcWidth, srcHeight,
+                             &vector[0], dstWidth * 4, dstWidth, dstHeight,
+                             xOrigin, xStep, yOrigin, yStep);
+        resampleRGBxBilinearScalar(&src[0], srcWidth * 4, srcWidth, srcHeight,
+                                   &scalar[0], dstWidth * 4, dstWidth, dstHeight,
+                                   xOrigin, xStep, yOrigin, yStep);
+        CHECK(memcmp(&vector[0], &scalar[0], vector.size()) == 0);
+    }
+}
+
+//Blending equal neighbours must not drift, or flat backgrounds would band
+static void testUniformColorStaysExact(){
+    std::vector<uint8_t> src(16 * 16 * 4, 200);
+    std::vector<uint8_t> dst(40 * 40 * 4, 0);
+    scaleRGBxBilinear(&src[0], 16 * 4, 16, 16, &dst[0], 40 * 4, 40, 40);
+    size_t i;
+    bool exact = true;
+    for(i = 0; i < dst.size(); i++) exact = exact && (dst[i] == 200);
+    CHECK(exact);
+
+    resampleRGBxBilinear(&src[0], 16 * 4, 16, 16, &dst[0], 40 * 4, 40, 40, -3.3, 0.37, 2.1, 0.41);
+    for(i = 0; i < dst.size(); i++) exact = exact && (dst[i] == 200);
+    CHECK(exact);
+}
+
+int main(){
+    srand(1);
+    testResampleMatchesScalar();
+    testUniformColorStaysExact();
+    return hostTestResult("pixelConvertTest");
+}
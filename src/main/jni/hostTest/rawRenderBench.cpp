@@ -0,0 +1,113 @@
+#include "hostTest.hpp"
+#include "testDocument.hpp"
+#include "bitmapRender.hpp"
+#include "oomHandler.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+}
+
+#include <vector>
+
+/*
+ * renderPageToBuffer into a caller-owned buffer, the path renderPageBitmap
+ * takes with a locked android.graphics.Bitmap, against rendering into a
+ * bitmap pdfium allocates and copying it out, the way a frame used to reach
+ * a Surface. Full screen pages and thumbnails, RGBA_8888 and RGB_565.
+ * Needs a host build of pdfium, see the Makefile.
+ */
+
+static const int kPageCount = 8;
+static const size_t kImageBytes = 256 * 1024;
+static const int kRepeats = 5;
+
+//No OOM handler on the host, nothing to retry for
+OOMRetry::OOMRetry(PageCache *pages) : pages(pages), oomCountBefore(0), retried(false) {}
+bool OOMRetry::shouldRetry(){ return false; }
+
+//Through an intermediate pdfium bitmap, RGBA only
+static bool renderCopied(FPDF_PAGE page, void *pixels, int width, int height){
+    FPDF_BITMAP bitmap = FPDFBitmap_Create(width, height, 1);
+    if(bitmap == NULL) return false;
+    FPDFBitmap_FillRect(bitmap, 0, 0, width, height, 255, 255, 255, 255);
+    FPDF_RenderPageBitmap(bitmap, page, 0, 0, width, height, 0, FPDF_REVERSE_BYTE_ORDER);
+
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(FPDFBitmap_GetBuffer(bitmap));
+    int srcStride = FPDFBitmap_GetStride(bitmap);
+    int y;
+    for(y = 0; y < height; y++){
+        memcpy(reinterpret_cast<unsigned char*>(pixels) + y * width * 4, src + y * srcStride, width * 4);
+    }
+    FPDFBitmap_Destroy(bitmap);
+    return true;
+}
+
+//Milliseconds per page, -1 if a render failed
+static double renderMillis(const std::vector<FPDF_PAGE> &pages, int width, int height,
+                           PixelFormat format, bool copied){
+    int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+    std::vector<unsigned char> pixels((size_t)width * height * bytesPerPixel);
+    int64_t start = hostTimeNanos();
+    int i;
+    size_t p;
+    for(i = 0; i < kRepeats; i++){
+        for(p = 0; p < pages.size(); p++){
+            bool ok;
+            if(copied){
+                ok = renderCopied(pages[p], &pixels[0], width, height);
+            }else{
+                ok = renderPageToBuffer( pages[p], &pixels[0], width, height, width * bytesPerPixel, format,
+                                         0, 0, width, height, NULL ) == RENDER_DONE;
+            }
+            if(!ok) return -1;
+        }
+    }
+    return (hostTimeNanos() - start) / 1e6 / (kRepeats * pages.size());
+}
+
+int main(){
+    char path[] = "/tmp/rawRenderBenchXXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0) return 1;
+    unlink(path);
+    size_t fileSize = writeTestDocument(fd, kPageCount, kImageBytes);
+    void *data = malloc(fileSize);
+    bool read = fileSize > 0 && pread(fd, data, fileSize, 0) == (ssize_t)fileSize;
+    close(fd);
+    if(!read) return 1;
+
+    FPDF_InitLibrary(NULL);
+    FPDF_DOCUMENT doc = FPDF_LoadMemDocument(data, (int)fileSize, NULL);
+    if(doc == NULL) return 1;
+    std::vector<FPDF_PAGE> pages;
+    int i;
+    for(i = 0; i < kPageCount; i++){
+        FPDF_PAGE page = FPDF_LoadPage(doc, i);
+        if(page == NULL) return 1;
+        pages.push_back(page);
+    }
+    //Once, so the first measurement doesn't pay for the fonts
+    if(renderMillis(pages, 64, 42, PIXEL_FORMAT_RGBA_8888, false) < 0) return 1;
+
+    static const int sizes[][2] = { { 1080, 699 }, { 240, 155 } };
+    printf("rawRenderBench: ms per page\n");
+    int failures = 0;
+    int s;
+    for(s = 0; s < 2; s++){
+        int width = sizes[s][0], height = sizes[s][1];
+        double copied = renderMillis(pages, width, height, PIXEL_FORMAT_RGBA_8888, true);
+        double direct = renderMillis(pages, width, height, PIXEL_FORMAT_RGBA_8888, false);
+        double rgb565 = renderMillis(pages, width, height, PIXEL_FORMAT_RGB_565, false);
+        if(copied < 0 || direct < 0 || rgb565 < 0) failures++;
+        printf("  %4dx%-4d  RGBA copied %7.2f  RGBA direct %7.2f  RGB_565 direct %7.2f\n",
+               width, height, copied, direct, rgb565);
+    }
+
+    for(i = 0; i < kPageCount; i++) FPDF_ClosePage(pages[i]);
+    FPDF_CloseDocument(doc);
+    FPDF_DestroyLibrary();
+    free(data);
+    return (failures == 0)? 0 : 1;
+}
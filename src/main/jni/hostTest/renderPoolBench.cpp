@@ -0,0 +1,139 @@
+#include "hostTest.hpp"
+#include "renderPool.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <unistd.h>
+}
+
+/*
+ * RenderPool throughput by worker count. There's no host pdfium, so pages are
+ * rendered by the stand-in below, which spends a fixed amount of arithmetic
+ * per pixel; what's measured is how well the pool spreads that over cores,
+ * with the fork, the socket round trips and the copy out of the shared slots.
+ */
+
+static const int kPageWidth = 1080;
+static const int kPageHeight = 1920;
+static const int kPageCount = 48;
+//Per pixel, about 50 ms a page on one core of the machine this was written on
+static const int kWorkPerPixel = 24;
+
+//The only pdfium the pool's workers use
+FPDF_PAGE FPDF_LoadPage(FPDF_DOCUMENT document, int pageIndex){
+    return reinterpret_cast<FPDF_PAGE>((intptr_t)pageIndex + 1);
+}
+void FPDF_ClosePage(FPDF_PAGE page){
+}
+//Linked in by renderControl.cpp, the stand-in renderPageToBuffer doesn't get there
+void FPDF_RenderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page, int start_x, int start_y,
+                           int size_x, int size_y, int rotate, int flags){
+}
+int FPDF_RenderPageBitmap_Start(FPDF_BITMAP bitmap, FPDF_PAGE page, int start_x, int start_y,
+                                int size_x, int size_y, int rotate, int flags, IFSDK_PAUSE *pause){
+    return FPDF_RENDER_FAILED;
+}
+int FPDF_RenderPage_Continue(FPDF_PAGE page, IFSDK_PAUSE *pause){
+    return FPDF_RENDER_FAILED;
+}
+void FPDF_RenderPage_Close(FPDF_PAGE page){
+}
+
+//Not inlined into the baseline below, the workers call it from renderPool.cpp
+__attribute__((noinline))
+RenderStatus renderPageToBuffer(FPDF_PAGE page,
+                                void *pixels, int width, int height, int stride, PixelFormat format,
+                                int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                CancelToken *token){
+    uint32_t seed = (uint32_t)(intptr_t)page;
+    int y, x, i;
+    for(y = 0; y < height; y++){
+        if(token != NULL && token->isCancelled()){
+            token->onAborted();
+            return RENDER_CANCELLED;
+        }
+        uint32_t *row = reinterpret_cast<uint32_t*>(reinterpret_cast<unsigned char*>(pixels) + y * stride);
+        for(x = 0; x < width; x++){
+            uint32_t v = seed ^ (uint32_t)(y * width + x);
+            for(i = 0; i < kWorkPerPixel; i++) v = v * 1664525u + 1013904223u;
+            row[x] = v | 0xff000000u;
+        }
+    }
+    return RENDER_DONE;
+}
+
+//Copies each page out like the JNI sink does into the caller's bitmaps
+class CopySink : public RenderPool::ResultSink {
+    public:
+    CopySink(unsigned char *bitmap) : bitmap(bitmap), done(0) {}
+    void onResult(int jobIndex, RenderStatus status, const void *pixels, int stride){
+        if(status != RENDER_DONE) return;
+        memcpy(bitmap, pixels, (size_t)stride * kPageHeight);
+        done++;
+    }
+    unsigned char *bitmap;
+    int done;
+};
+
+int main(){
+    //Only pdfDocument is read, the pool doesn't touch the rest
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(calloc(1, sizeof(DocumentFile)));
+    doc->pdfDocument = reinterpret_cast<FPDF_DOCUMENT>(1);
+
+    RenderPool::Job jobs[kPageCount];
+    int i;
+    for(i = 0; i < kPageCount; i++){
+        RenderPool::Job &job = jobs[i];
+        job.pageIndex = i;
+        job.width = kPageWidth;
+        job.height = kPageHeight;
+        job.format = PIXEL_FORMAT_RGBA_8888;
+        job.startX = 0;
+        job.startY = 0;
+        job.drawSizeHor = kPageWidth;
+        job.drawSizeVer = kPageHeight;
+    }
+    unsigned char *bitmap = reinterpret_cast<unsigned char*>(malloc((size_t)kPageWidth * kPageHeight * 4));
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("renderPoolBench: %d pages of %dx%d, %ld cores\n", kPageCount, kPageWidth, kPageHeight, cores);
+
+    //In process, the baseline the pool has to beat. One page first to warm up.
+    int64_t start = 0;
+    for(i = -1; i < kPageCount; i++){
+        if(i == 0) start = hostTimeNanos();
+        renderPageToBuffer(FPDF_LoadPage(doc->pdfDocument, i < 0? 0 : i), bitmap, kPageWidth, kPageHeight, kPageWidth * 4,
+                           PIXEL_FORMAT_RGBA_8888, 0, 0, kPageWidth, kPageHeight, NULL);
+    }
+    double serialMillis = (hostTimeNanos() - start) / 1e6;
+    printf("  in process  %8.1f ms  %6.1f pages/s\n", serialMillis, kPageCount * 1000.0 / serialMillis);
+
+    int workerCounts[] = { 1, 2, 4, 8 };
+    for(i = 0; i < (int)(sizeof(workerCounts) / sizeof(workerCounts[0])); i++){
+        start = hostTimeNanos();
+        RenderPool *pool = RenderPool::start(doc, workerCounts[i], kPageWidth, kPageHeight);
+        int64_t startNanos = hostTimeNanos() - start;
+        if(pool == NULL){
+            printf("  %d workers: pool didn't start\n", workerCounts[i]);
+            return 1;
+        }
+
+        CopySink sink(bitmap);
+        start = hostTimeNanos();
+        pool->run(jobs, kPageCount, &sink, NULL);
+        double millis = (hostTimeNanos() - start) / 1e6;
+        RenderPool::Stats stats = pool->getStats();
+        delete pool;
+
+        printf("  %d workers   %8.1f ms  %6.1f pages/s  speedup %.2f  parallelism %.2f  start %.1f ms%s\n",
+               workerCounts[i], millis, kPageCount * 1000.0 / millis, serialMillis / millis,
+               (double)stats.renderNanos / stats.batchNanos, startNanos / 1e6,
+               (sink.done == kPageCount)? "" : "  (pages failed)");
+        if(sink.done != kPageCount) return 1;
+    }
+
+    free(bitmap);
+    free(doc);
+    return 0;
+}
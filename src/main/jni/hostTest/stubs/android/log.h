@@ -0,0 +1,14 @@
+#ifndef _HOST_TEST_ANDROID_LOG_H_
+#define _HOST_TEST_ANDROID_LOG_H_
+
+enum {
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR
+};
+
+//hostTest.cpp prints warnings and errors to stderr
+int __android_log_print(int prio, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _HOST_TEST_JNI_H_
+#define _HOST_TEST_JNI_H_
+
+//Just enough of jni.h for util.hpp, host tests never touch the VM
+#define JNIEXPORT __attribute__((visibility("default")))
+#define JNICALL
+
+#endif
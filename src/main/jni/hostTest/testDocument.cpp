@@ -0,0 +1,150 @@
+#include "testDocument.hpp"
+
+extern "C" {
+    #include <stdio.h>
+    #include <stdint.h>
+    #include <math.h>
+    #include <unistd.h>
+}
+
+#include <string>
+#include <vector>
+
+static const int kPageWidth = 1224;
+static const int kPageHeight = 792;
+static const int kStrokesPerPage = 1500;
+static const int kLabelsPerPage = 60;
+
+class DocumentWriter {
+    public:
+    explicit DocumentWriter(int fd) : fd(fd), offset(0), failed(false) {}
+
+    void write(const void *data, size_t size){
+        const char *src = reinterpret_cast<const char*>(data);
+        while(size > 0 && !failed){
+            ssize_t ret = ::write(fd, src, size);
+            if(ret <= 0){
+                failed = true;
+                return;
+            }
+            src += ret;
+            size -= (size_t)ret;
+            offset += (size_t)ret;
+        }
+    }
+    void write(const std::string &text){ write(text.data(), text.size()); }
+
+    //Starts object number objectOffsets.size() + 1
+    void beginObject(){
+        objectOffsets.push_back(offset);
+        char header[32];
+        snprintf(header, sizeof(header), "%d 0 obj\n", (int)objectOffsets.size());
+        write(header);
+    }
+    void endObject(){ write("endobj\n"); }
+
+    size_t getOffset() const { return offset; }
+    const std::vector<size_t>& getObjectOffsets() const { return objectOffsets; }
+    bool hasFailed() const { return failed; }
+
+    private:
+    int fd;
+    size_t offset;
+    bool failed;
+    std::vector<size_t> objectOffsets;
+};
+
+static std::string format(const char *fmt, int a, int b = 0, int c = 0, int d = 0){
+    char text[256];
+    snprintf(text, sizeof(text), fmt, a, b, c, d);
+    return text;
+}
+
+static std::string pageContent(int pageIndex){
+    std::string content = format("q %d 0 0 %d 0 0 cm /Im Do Q\n0.2 w\n", kPageWidth, kPageHeight);
+    uint32_t seed = (uint32_t)pageIndex * 2654435761u + 1;
+    int i;
+    for(i = 0; i < kStrokesPerPage; i++){
+        int coords[4];
+        int j;
+        for(j = 0; j < 4; j++){
+            seed = seed * 1664525u + 1013904223u;
+            coords[j] = (int)((seed >> 8) % (uint32_t)((j % 2 == 0)? kPageWidth : kPageHeight));
+        }
+        content += format("%d %d m %d %d l S\n", coords[0], coords[1], coords[2], coords[3]);
+    }
+    for(i = 0; i < kLabelsPerPage; i++){
+        content += format("BT /F1 9 Tf %d %d Td (Sheet %d detail %d) Tj ET\n",
+                          40 + (i % 6) * 190, 40 + (i / 6) * 70, pageIndex + 1, i + 1);
+    }
+    return content;
+}
+
+size_t writeTestDocument(int fd, int pageCount, size_t imageBytes){
+    DocumentWriter writer(fd);
+    writer.write("%PDF-1.4\n");
+
+    writer.beginObject();
+    writer.write("<< /Type /Catalog /Pages 2 0 R >>\n");
+    writer.endObject();
+
+    writer.beginObject();
+    writer.write(format("<< /Type /Pages /Count %d /Kids [", pageCount));
+    int i;
+    for(i = 0; i < pageCount; i++) writer.write(format(" %d 0 R", 4 + i * 3));
+    writer.write(" ] >>\n");
+    writer.endObject();
+
+    writer.beginObject();
+    writer.write("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\n");
+    writer.endObject();
+
+    int imageWidth = (int)sqrt((double)imageBytes / 3);
+    if(imageWidth < 1) imageWidth = 1;
+    std::vector<unsigned char> imageRow((size_t)imageWidth * 3);
+
+    for(i = 0; i < pageCount; i++){
+        writer.beginObject();
+        writer.write(format("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %d %d]", kPageWidth, kPageHeight));
+        writer.write(format(" /Resources << /Font << /F1 3 0 R >> /XObject << /Im %d 0 R >> >>", 6 + i * 3));
+        writer.write(format(" /Contents %d 0 R >>\n", 5 + i * 3));
+        writer.endObject();
+
+        std::string content = pageContent(i);
+        writer.beginObject();
+        writer.write(format("<< /Length %d >>\nstream\n", (int)content.size()));
+        writer.write(content);
+        writer.write("\nendstream\n");
+        writer.endObject();
+
+        writer.beginObject();
+        writer.write(format("<< /Type /XObject /Subtype /Image /Width %d /Height %d", imageWidth, imageWidth));
+        writer.write(format(" /ColorSpace /DeviceRGB /BitsPerComponent 8 /Length %d >>\nstream\n",
+                            imageWidth * imageWidth * 3));
+        int y, x;
+        for(y = 0; y < imageWidth; y++){
+            for(x = 0; x < imageWidth * 3; x++){
+                imageRow[x] = (unsigned char)(224 + ((x / 3 + y + i) & 31));
+            }
+            writer.write(&imageRow[0], imageRow.size());
+        }
+        writer.write("\nendstream\n");
+        writer.endObject();
+    }
+
+    size_t xrefOffset = writer.getOffset();
+    const std::vector<size_t> &offsets = writer.getObjectOffsets();
+    writer.write(format("xref\n0 %d\n0000000000 65535 f \n", (int)offsets.size() + 1));
+    for(i = 0; i < (int)offsets.size(); i++){
+        char entry[32];
+        snprintf(entry, sizeof(entry), "%010lu 00000 n \n", (unsigned long)offsets[i]);
+        writer.write(entry);
+    }
+    writer.write(format("trailer\n<< /Size %d /Root 1 0 R /ID [<%08X> <%08X>] >>\n",
+                        (int)offsets.size() + 1, pageCount, (int)imageBytes));
+    char startXref[64];
+    snprintf(startXref, sizeof(startXref), "startxref\n%lu\n%%%%EOF\n", (unsigned long)xrefOffset);
+    writer.write(startXref);
+
+    return writer.hasFailed()? 0 : writer.getOffset();
+}
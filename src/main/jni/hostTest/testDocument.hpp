@@ -0,0 +1,16 @@
+#ifndef _TEST_DOCUMENT_HPP_
+#define _TEST_DOCUMENT_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+/*
+ * Writes a PDF like a drawing set into fd: every page is a dense vector
+ * drawing with some text, over a scanned background image of imageBytes
+ * uncompressed pixels. File size is about pageCount * imageBytes.
+ * Returns the file size, 0 on failure.
+ */
+size_t writeTestDocument(int fd, int pageCount, size_t imageBytes);
+
+#endif
@@ -0,0 +1,167 @@
+#include "bitmapRender.hpp"
+#include "oomHandler.hpp"
+#include "pixelConvert.hpp"
+#include "scratchBuffer.hpp"
+
+extern "C" {
+    #include <math.h>
+}
+
+//Renders into a pdfium bitmap of the given FPDFBitmap_* format wrapping the pixels
+static RenderStatus renderPageToPdfBitmap(FPDF_PAGE page,
+                                          void *pixels, int width, int height, int stride,
+                                          int bitmapFormat, int flags,
+                                          int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                          CancelToken *token){
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(width, height, bitmapFormat, pixels, stride);
+    if(pdfBitmap == NULL) return RENDER_FAILED;
+
+    if(startX > 0 || startY > 0 ||
+       startX + drawSizeHor < width || startY + drawSizeVer < height){
+        FPDFBitmap_FillRect( pdfBitmap, 0, 0, width, height,
+                             0x84, 0x84, 0x84, 255); //Gray
+    }
+
+    //The page's part of the bitmap, exact so renders of adjacent parts of a canvas line up
+    int baseX = (startX < 0)? 0 : startX;
+    int baseY = (startY < 0)? 0 : startY;
+    int baseHorSize = ((startX + drawSizeHor < width)? startX + drawSizeHor : width) - baseX;
+    int baseVerSize = ((startY + drawSizeVer < height)? startY + drawSizeVer : height) - baseY;
+
+    //A render that ran out of memory leaves an incomplete picture, redo it once
+    RenderStatus status;
+    OOMRetry oom;
+    do{
+        if(baseHorSize > 0 && baseVerSize > 0){
+            FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
+                                 255, 255, 255, 255); //White
+        }
+
+        status = renderPageBitmap( pdfBitmap, page,
+                                   startX, startY,
+                                   drawSizeHor, drawSizeVer,
+                                   flags, token );
+    }while(status != RENDER_CANCELLED && oom.shouldRetry());
+
+    FPDFBitmap_Destroy(pdfBitmap);
+    return status;
+}
+
+static RenderStatus renderPageToRGBA(FPDF_PAGE page,
+                                     void *pixels, int width, int height, int stride,
+                                     int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                     CancelToken *token, int extraFlags = 0){
+    return renderPageToPdfBitmap( page, pixels, width, height, stride,
+                                  FPDFBitmap_BGRA, FPDF_REVERSE_BYTE_ORDER | extraFlags,
+                                  startX, startY, drawSizeHor, drawSizeVer, token );
+}
+
+RenderStatus renderPageToBuffer(FPDF_PAGE page,
+                                void *pixels, int width, int height, int stride, PixelFormat format,
+                                int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                CancelToken *token){
+    if(page == NULL || pixels == NULL || width <= 0 || height <= 0) return RENDER_FAILED;
+
+    switch(format){
+        case PIXEL_FORMAT_RGBA_8888:
+            return renderPageToRGBA( page, pixels, width, height, stride,
+                                     startX, startY, drawSizeHor, drawSizeVer, token );
+
+        case PIXEL_FORMAT_RGB_565:
+        case PIXEL_FORMAT_RGB_565_DITHERED: {
+            ScratchBuffer rgbx(width * height * 4);
+            if(rgbx.get() == NULL) return RENDER_FAILED;
+
+            RenderStatus status = renderPageToRGBA( page, rgbx.get(), width, height, width * 4,
+                                                    startX, startY, drawSizeHor, drawSizeVer, token );
+            if(status == RENDER_DONE){
+                convertRGBxToRGB565( reinterpret_cast<const uint8_t*>(rgbx.get()), width * 4,
+                                     reinterpret_cast<uint16_t*>(pixels), stride,
+                                     width, height, format == PIXEL_FORMAT_RGB_565_DITHERED );
+            }
+            return status;
+        }
+
+        case PIXEL_FORMAT_GRAY_8:
+            return renderPageToPdfBitmap( page, pixels, width, height, stride,
+                                          FPDFBitmap_Gray, FPDF_GRAYSCALE,
+                                          startX, startY, drawSizeHor, drawSizeVer, token );
+
+        default:
+            return RENDER_FAILED;
+    }
+}
+
+RenderStatus renderPageToGray(FPDF_PAGE page,
+                              void *pixels, int width, int height, int stride,
+                              int bitsPerPixel, DitherMode dither,
+                              int startX, int startY, int drawSizeHor, int drawSizeVer,
+                              CancelToken *token){
+    if(bitsPerPixel == 8){
+        return renderPageToBuffer( page, pixels, width, height, stride, PIXEL_FORMAT_GRAY_8,
+                                   startX, startY, drawSizeHor, drawSizeVer, token );
+    }
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4) return RENDER_FAILED;
+
+    ScratchBuffer gray(width * height);
+    if(gray.get() == NULL) return RENDER_FAILED;
+
+    RenderStatus status = renderPageToBuffer( page, gray.get(), width, height, width, PIXEL_FORMAT_GRAY_8,
+                                              startX, startY, drawSizeHor, drawSizeVer, token );
+    if(status == RENDER_DONE){
+        packGray( reinterpret_cast<const uint8_t*>(gray.get()), width,
+                  reinterpret_cast<uint8_t*>(pixels), stride,
+                  width, height, bitsPerPixel, dither );
+    }
+    return status;
+}
+
+//Canvas coordinate in the draft picture, which is draftSize/size of the canvas
+static int toDraft(int value, int draftSize, int size){
+    return (int)floor((double)value * draftSize / size + 0.5);
+}
+
+RenderStatus renderPageDraft(FPDF_PAGE page,
+                             void *pixels, int width, int height, int stride, PixelFormat format,
+                             int startX, int startY, int drawSizeHor, int drawSizeVer,
+                             int scaleDown, CancelToken *token){
+    if(scaleDown <= 1 || format == PIXEL_FORMAT_GRAY_8){
+        return renderPageToBuffer( page, pixels, width, height, stride, format,
+                                   startX, startY, drawSizeHor, drawSizeVer, token );
+    }
+    if(page == NULL || pixels == NULL || width <= 0 || height <= 0) return RENDER_FAILED;
+
+    int draftWidth = (width + scaleDown - 1) / scaleDown;
+    int draftHeight = (height + scaleDown - 1) / scaleDown;
+    ScratchBuffer draft(draftWidth * draftHeight * 4);
+    if(draft.get() == NULL) return RENDER_FAILED;
+
+    //Placed with the exact ratio the stretch uses, so the page lands where a full render puts it
+    int draftStartX = toDraft(startX, draftWidth, width);
+    int draftStartY = toDraft(startY, draftHeight, height);
+    int draftDrawHor = toDraft(startX + drawSizeHor, draftWidth, width) - draftStartX;
+    int draftDrawVer = toDraft(startY + drawSizeVer, draftHeight, height) - draftStartY;
+    if(draftDrawHor < 1) draftDrawHor = 1;
+    if(draftDrawVer < 1) draftDrawVer = 1;
+
+    RenderStatus status = renderPageToRGBA( page, draft.get(), draftWidth, draftHeight, draftWidth * 4,
+                                            draftStartX, draftStartY, draftDrawHor, draftDrawVer, token,
+                                            FPDF_RENDER_LIMITEDIMAGECACHE | FPDF_RENDER_FORCEHALFTONE );
+    if(status != RENDER_DONE) return status;
+
+    const uint8_t *draftPixels = reinterpret_cast<const uint8_t*>(draft.get());
+    if(format == PIXEL_FORMAT_RGBA_8888){
+        scaleRGBxBilinear( draftPixels, draftWidth * 4, draftWidth, draftHeight,
+                           reinterpret_cast<uint8_t*>(pixels), stride, width, height );
+        return RENDER_DONE;
+    }
+
+    ScratchBuffer rgbx(width * height * 4);
+    if(rgbx.get() == NULL) return RENDER_FAILED;
+    scaleRGBxBilinear( draftPixels, draftWidth * 4, draftWidth, draftHeight,
+                       reinterpret_cast<uint8_t*>(rgbx.get()), width * 4, width, height );
+    convertRGBxToRGB565( reinterpret_cast<const uint8_t*>(rgbx.get()), width * 4,
+                         reinterpret_cast<uint16_t*>(pixels), stride,
+                         width, height, format == PIXEL_FORMAT_RGB_565_DITHERED );
+    return RENDER_DONE;
+}
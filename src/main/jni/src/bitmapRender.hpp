@@ -0,0 +1,59 @@
+#ifndef _BITMAP_RENDER_HPP_
+#define _BITMAP_RENDER_HPP_
+
+#include <fpdfview.h>
+
+#include "renderControl.hpp"
+#include "pixelConvert.hpp"
+
+//Pixel layouts a page can be rendered into, keep in sync with PdfiumCore.PIXEL_FORMAT_*
+enum PixelFormat {
+    PIXEL_FORMAT_RGBA_8888 = 0,
+    PIXEL_FORMAT_RGB_565 = 1,
+    //RGB_565 with ordered dithering
+    PIXEL_FORMAT_RGB_565_DITHERED = 2,
+    //One byte per pixel, rendered by pdfium with FPDF_GRAYSCALE
+    PIXEL_FORMAT_GRAY_8 = 3
+};
+
+/*
+ * Renders a page into caller-owned pixels, no JNI or window involved.
+ * startX/startY and drawSizeHor/drawSizeVer place the whole page like
+ * FPDF_RenderPageBitmap's arguments; the area outside the page is filled gray.
+ * RGBA_8888 is rendered in place, RGB_565 goes through a reused RGBx scratch
+ * buffer since pdfium has no 16 bit format. stride is in bytes.
+ * Returns RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED.
+ */
+RenderStatus renderPageToBuffer(FPDF_PAGE page,
+                                void *pixels, int width, int height, int stride, PixelFormat format,
+                                int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                CancelToken *token);
+
+//Keep in sync with PdfiumCore.QUALITY_*
+enum RenderQuality {
+    RENDER_QUALITY_FINAL = 0,
+    //Reduced resolution and pdfium's cheap image paths, for frames during fling and pinch
+    RENDER_QUALITY_DRAFT = 1
+};
+
+/*
+ * renderPageToBuffer at 1/scaleDown of the resolution, stretched over the
+ * canvas with bilinear filtering. Images are drawn with FPDF_RENDER_LIMITEDIMAGECACHE
+ * and FPDF_RENDER_FORCEHALFTONE. scaleDown of 1 and gray output render in full.
+ */
+RenderStatus renderPageDraft(FPDF_PAGE page,
+                             void *pixels, int width, int height, int stride, PixelFormat format,
+                             int startX, int startY, int drawSizeHor, int drawSizeVer,
+                             int scaleDown, CancelToken *token);
+
+/*
+ * Grayscale output for e-paper: 8 bits per pixel straight from pdfium, or 1, 2
+ * or 4 bits packed by packGray() from an 8 bit scratch picture.
+ */
+RenderStatus renderPageToGray(FPDF_PAGE page,
+                              void *pixels, int width, int height, int stride,
+                              int bitsPerPixel, DitherMode dither,
+                              int startX, int startY, int drawSizeHor, int drawSizeVer,
+                              CancelToken *token);
+
+#endif
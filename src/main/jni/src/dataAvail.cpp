@@ -0,0 +1,65 @@
+#include "util.hpp"
+#include "dataAvail.hpp"
+
+using namespace android;
+
+AvailabilityTracker::AvailabilityTracker(){
+    fileAvail.iface.version = 1;
+    fileAvail.iface.IsDataAvail = isDataAvailCallback;
+    fileAvail.tracker = this;
+
+    downloadHints.iface.version = 1;
+    downloadHints.iface.AddSegment = addSegmentCallback;
+    downloadHints.tracker = this;
+}
+
+void AvailabilityTracker::addRange(size_t offset, size_t size){
+    if(size == 0) return;
+
+    Mutex::Autolock autoLock(lock);
+    size_t start = offset;
+    size_t end = offset + size;
+
+    //Swallow every range that overlaps or touches the new one
+    std::map<size_t, size_t>::iterator it = ranges.upper_bound(start);
+    if(it != ranges.begin()){
+        std::map<size_t, size_t>::iterator prev = it;
+        --prev;
+        if(prev->second >= start) it = prev;
+    }
+    while(it != ranges.end() && it->first <= end){
+        if(it->first < start) start = it->first;
+        if(it->second > end) end = it->second;
+        ranges.erase(it++);
+    }
+
+    ranges[start] = end;
+}
+
+bool AvailabilityTracker::isRangeAvailable(size_t offset, size_t size){
+    Mutex::Autolock autoLock(lock);
+
+    std::map<size_t, size_t>::iterator it = ranges.upper_bound(offset);
+    if(it == ranges.begin()) return false;
+    --it;
+    return it->second >= offset + size;
+}
+
+std::vector<size_t> AvailabilityTracker::takeHints(){
+    std::vector<size_t> hints;
+    Mutex::Autolock autoLock(lock);
+    hints.swap(pendingHints);
+    return hints;
+}
+
+bool AvailabilityTracker::isDataAvailCallback(FX_FILEAVAIL *pThis, size_t offset, size_t size){
+    AvailabilityTracker *tracker = reinterpret_cast<FileAvail*>(pThis)->tracker;
+    return tracker->isRangeAvailable(offset, size);
+}
+
+void AvailabilityTracker::addSegmentCallback(FX_DOWNLOADHINTS *pThis, size_t offset, size_t size){
+    AvailabilityTracker *tracker = reinterpret_cast<DownloadHints*>(pThis)->tracker;
+    Mutex::Autolock autoLock(tracker->lock);
+    tracker->pendingHints.push_back(offset);
+    tracker->pendingHints.push_back(size);
+}
@@ -0,0 +1,55 @@
+#ifndef _DATA_AVAIL_HPP_
+#define _DATA_AVAIL_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+#include <map>
+#include <vector>
+
+#include <utils/Mutex.h>
+
+#include <fpdf_dataavail.h>
+
+/**
+ * Bookkeeping for documents that are still arriving.
+ * The fetcher reports byte ranges as they land on disk, pdfium asks through
+ * FX_FILEAVAIL whether a section is present and leaves FX_DOWNLOADHINTS for
+ * the sections it wants next, which the fetcher drains to prioritize its work.
+ */
+class AvailabilityTracker {
+    public:
+    AvailabilityTracker();
+
+    FX_FILEAVAIL* getFileAvail() { return &fileAvail.iface; }
+    FX_DOWNLOADHINTS* getDownloadHints() { return &downloadHints.iface; }
+
+    void addRange(size_t offset, size_t size);
+    bool isRangeAvailable(size_t offset, size_t size);
+
+    //Returns (offset, size) pairs collected since the last call
+    std::vector<size_t> takeHints();
+
+    private:
+    //pdfium hands the interface pointer back, so keep a way home next to it
+    struct FileAvail {
+        FX_FILEAVAIL iface;
+        AvailabilityTracker *tracker;
+    } fileAvail;
+    struct DownloadHints {
+        FX_DOWNLOADHINTS iface;
+        AvailabilityTracker *tracker;
+    } downloadHints;
+
+    //The fetcher reports ranges and drains hints on its own thread while pdfium renders
+    android::Mutex lock;
+    //Start offset -> end offset (exclusive), never overlapping or touching
+    std::map<size_t, size_t> ranges;
+    std::vector<size_t> pendingHints;
+
+    static bool isDataAvailCallback(FX_FILEAVAIL *pThis, size_t offset, size_t size);
+    static void addSegmentCallback(FX_DOWNLOADHINTS *pThis, size_t offset, size_t size);
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "documentFile.hpp"
+#include "lruCache.hpp"
+#include "oomHandler.hpp"
+#include "scratchBuffer.hpp"
+
+extern "C" {
+    #include <malloc.h>
+    #include <sys/mman.h>
+}
+
+#include <set>
+
+#include <utils/Mutex.h>
+using namespace android;
+
+static Mutex sLibraryLock;
+
+static int sLibraryReferenceCount = 0;
+
+void initLibraryIfNeed(){
+    Mutex::Autolock lock(sLibraryLock);
+    if(sLibraryReferenceCount == 0){
+        LOGD("Init FPDF library");
+        FPDF_InitLibrary(NULL);
+        installOOMHandler();
+    }
+    sLibraryReferenceCount++;
+}
+
+void destroyLibraryIfNeed(){
+    Mutex::Autolock lock(sLibraryLock);
+    sLibraryReferenceCount--;
+    if(sLibraryReferenceCount == 0){
+        LOGD("Destroy FPDF library");
+        FPDF_DestroyLibrary();
+    }
+}
+
+DocumentFile::~DocumentFile(){
+    //Pages have to go before their document, after leaving the form environment
+    disableForms();
+    pageCache.clear();
+
+    if(pdfDocument != NULL){
+        FPDF_CloseDocument(pdfDocument);
+    }
+    if(availProvider != NULL){
+        FPDFAvail_Destroy(availProvider);
+    }
+    delete availTracker;
+
+    if(fileMappedBuffer != NULL){
+        munmap(fileMappedBuffer, fileSize);
+        //Leave the file closing work to Java
+        //close(fileFd);
+    }
+
+    //Must outlive the document since pdfium reads through it until closed
+    delete fileReader;
+
+    unregisterDocument(this);
+    destroyLibraryIfNeed();
+}
+
+bool DocumentFile::enableForms(){
+    if(formFiller != NULL) return true;
+
+    //Form fill edits the document in memory, from here on it can't stand in for the file
+    modified = true;
+    formFiller = new FormFiller(this);
+    if(!formFiller->isValid()){
+        disableForms();
+        return false;
+    }
+    return true;
+}
+
+void DocumentFile::disableForms(){
+    delete formFiller;
+    formFiller = NULL;
+}
+
+static Mutex sLiveDocumentsLock;
+static std::set<DocumentFile*> sLiveDocuments;
+
+void DocumentFile::registerDocument(DocumentFile *doc){
+    Mutex::Autolock lock(sLiveDocumentsLock);
+    sLiveDocuments.insert(doc);
+}
+
+void DocumentFile::unregisterDocument(DocumentFile *doc){
+    Mutex::Autolock lock(sLiveDocumentsLock);
+    sLiveDocuments.erase(doc);
+}
+
+int DocumentFile::trimCache(CacheClass cacheClass, int keepPercent){
+    switch(cacheClass){
+        case CACHE_TILES:
+            return tileCache.trim(tileCache.getMaxBytes() / 100 * keepPercent);
+        case CACHE_IDLE_PAGES:
+            return pageCache.trim(pageCache.getMaxPages() * keepPercent / 100);
+        default:
+            return 0;
+    }
+}
+
+int trimAllDocuments(CacheClass cacheClass, int keepPercent){
+    //Process wide, not per document
+    if(cacheClass == CACHE_SCRATCH_BUFFERS){
+        return (keepPercent < 100 && trimScratchBuffers() > 0)? 1 : 0;
+    }
+    //Evicting closed documents deletes them, which takes sLiveDocumentsLock
+    if(cacheClass == CACHE_CLOSED_DOCUMENTS){
+        return trimDocumentCache(getDocumentCacheCapacity() * keepPercent / 100);
+    }
+    //pdfium may be busy with the other documents on their own threads
+    if(cacheClass == CACHE_IDLE_PAGES) return 0;
+
+    Mutex::Autolock lock(sLiveDocumentsLock);
+    int released = 0;
+    for(std::set<DocumentFile*>::iterator it = sLiveDocuments.begin(); it != sLiveDocuments.end(); ++it){
+        released += (*it)->trimCache(cacheClass, keepPercent);
+    }
+    return released;
+}
+
+size_t getAllocatedHeapBytes(){
+    struct mallinfo info = mallinfo();
+    return (size_t)info.uordblks;
+}
+
+typedef BoundedLruCache<FileIdentity, DocumentFile*> DocumentCache;
+
+static const size_t kDefaultDocumentCacheCapacity = 3;
+
+class DocumentCacheRemover : public DocumentCache::OnEntryRemoved {
+    public:
+    void operator()(const FileIdentity &identity, DocumentFile *&doc){
+        LOGD("Evict cached document");
+        delete doc;
+    }
+};
+
+static Mutex sDocumentCacheLock;
+static DocumentCacheRemover sDocumentCacheRemover;
+
+//Must be called with sDocumentCacheLock held
+static DocumentCache& getDocumentCache(){
+    static DocumentCache cache(kDefaultDocumentCacheCapacity);
+    cache.setOnEntryRemovedListener(&sDocumentCacheRemover);
+    return cache;
+}
+
+DocumentFile* takeCachedDocument(const FileIdentity &identity, OpenMode openMode){
+    Mutex::Autolock lock(sDocumentCacheLock);
+    DocumentCache &cache = getDocumentCache();
+    DocumentFile *doc = NULL;
+    if(!cache.get(identity, &doc)) return NULL;
+    //A mapped copy doesn't do for a stream open, which asked for bounded memory, or the other way round
+    if(doc->openMode != openMode){
+        LOGD("Cached document was opened in another mode, dropping it");
+        cache.remove(identity);
+        return NULL;
+    }
+    cache.take(identity, &doc);
+    return doc;
+}
+
+bool cacheClosedDocument(DocumentFile *doc){
+    if(!doc->hasIdentity || doc->pdfDocument == NULL || doc->modified) return false;
+
+    Mutex::Autolock lock(sDocumentCacheLock);
+    DocumentCache &cache = getDocumentCache();
+    if(cache.getMaxCost() == 0) return false;
+
+    //Only the parsed document is worth keeping, pages and tiles are cheap to rebuild
+    doc->tileCache.clear();
+    doc->disableForms();
+    doc->pageCache.clear();
+    return cache.put(doc->identity, doc);
+}
+
+void setDocumentCacheCapacity(size_t capacity){
+    Mutex::Autolock lock(sDocumentCacheLock);
+    getDocumentCache().setMaxCost(capacity);
+}
+
+size_t getDocumentCacheCapacity(){
+    Mutex::Autolock lock(sDocumentCacheLock);
+    return getDocumentCache().getMaxCost();
+}
+
+int trimDocumentCache(size_t keepCount){
+    Mutex::Autolock lock(sDocumentCacheLock);
+    DocumentCache &cache = getDocumentCache();
+    size_t before = cache.size();
+    cache.trimToCost(keepCount);
+    return (int)(before - cache.size());
+}
+
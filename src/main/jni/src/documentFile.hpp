@@ -0,0 +1,159 @@
+#ifndef _DOCUMENT_FILE_HPP_
+#define _DOCUMENT_FILE_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_dataavail.h>
+
+#include "util.hpp"
+#include "fileAccess.hpp"
+#include "dataAvail.hpp"
+#include "pageCache.hpp"
+#include "tileCache.hpp"
+#include "formFill.hpp"
+
+void initLibraryIfNeed();
+void destroyLibraryIfNeed();
+
+//Native caches that can be given back under memory pressure, cheapest to rebuild first
+enum CacheClass {
+    CACHE_SCRATCH_BUFFERS = 0,
+    CACHE_TILES,
+    CACHE_IDLE_PAGES,
+    CACHE_CLOSED_DOCUMENTS,
+    CACHE_CLASS_COUNT
+};
+
+//Keep in sync with PdfiumCore.OPEN_MODE_*
+enum OpenMode {
+    OPEN_MODE_MMAP = 0,
+    OPEN_MODE_STREAM = 1,
+};
+
+class DocumentFile {
+    private:
+    void *fileMappedBuffer;
+    BlockFileReader *fileReader;
+    //Owned by Java (direct ByteBuffer), PdfDocument keeps it reachable
+    const void *externalBuffer;
+    int fileFd;
+
+    public:
+    FPDF_DOCUMENT pdfDocument;
+    //Set when the document came from a plain file and may be kept for reopening
+    bool hasIdentity;
+    FileIdentity identity;
+    //See getDocumentFingerprint, with identity it keys the metadata cache
+    uint64_t fingerprint;
+    //How a document with identity reads its file, a reopen has to ask for the same
+    OpenMode openMode;
+    //File pdfium reads from, saves must never rewrite it. Size and time follow our own appends.
+    bool hasSource;
+    FileIdentity source;
+    //Only set for documents opened before all their data arrived
+    FPDF_AVAIL availProvider;
+    AvailabilityTracker *availTracker;
+    PageCache pageCache;
+    TileCache tileCache;
+    //Only set once forms were enabled
+    FormFiller *formFiller;
+    //Forms were set up or the document was saved, it may no longer match its file
+    bool modified;
+    size_t fileSize;
+    void setFile(int fd, void *buffer, size_t fileLength){
+        fileFd = fd;
+        fileSize = fileLength;
+        fileMappedBuffer = buffer;
+        LOGD("File Size: %d", (int)fileSize);
+    }
+    void setFileReader(int fd, BlockFileReader *reader, size_t fileLength){
+        fileFd = fd;
+        fileSize = fileLength;
+        fileReader = reader;
+        LOGD("File Size: %d (streaming)", (int)fileSize);
+    }
+    void setExternalBuffer(const void *buffer, size_t length){
+        fileFd = -1;
+        fileSize = length;
+        externalBuffer = buffer;
+        LOGD("Buffer Size: %d", (int)fileSize);
+    }
+    void* getFileMap() { return fileMappedBuffer; }
+    BlockFileReader* getFileReader() { return fileReader; }
+
+    DocumentFile() :  fileMappedBuffer(NULL),
+                      fileReader(NULL),
+                      externalBuffer(NULL),
+                      pdfDocument(NULL),
+                      hasIdentity(false),
+                      fingerprint(0),
+                      openMode(OPEN_MODE_MMAP),
+                      hasSource(false),
+                      availProvider(NULL),
+                      availTracker(NULL),
+                      pageCache(PageCache::kDefaultMaxPages),
+                      tileCache(TileCache::kDefaultMaxBytes),
+                      formFiller(NULL),
+                      modified(false) { initLibraryIfNeed(); registerDocument(this); }
+    ~DocumentFile();
+
+    //Sets up the form fill environment unless done already, false if that failed
+    bool enableForms();
+    void disableForms();
+
+    //Shrinks the cache to keepPercent of its budget, returns the number of objects released
+    int trimCache(CacheClass cacheClass, int keepPercent = 0);
+
+    private:
+    static void registerDocument(DocumentFile *doc);
+    static void unregisterDocument(DocumentFile *doc);
+};
+
+/*
+ * Applies DocumentFile::trimCache to every live document. Idle pages are left
+ * alone: closing them needs each document's lock, see nativeTrimDocument.
+ */
+int trimAllDocuments(CacheClass cacheClass, int keepPercent = 0);
+
+//Bytes currently allocated from the malloc heap, which pdfium allocates from as well
+size_t getAllocatedHeapBytes();
+
+/*
+ * Recently closed documents, kept parsed so reopening the same file is free.
+ * Keyed by file identity so a modified or replaced file never hits, and
+ * documents changed in memory (DocumentFile::modified) aren't kept. A hit
+ * opened in another mode is dropped instead of returned.
+ */
+DocumentFile* takeCachedDocument(const FileIdentity &identity, OpenMode openMode);
+//False if the document isn't eligible (no identity, modified), the caller still owns it then
+bool cacheClosedDocument(DocumentFile *doc);
+void setDocumentCacheCapacity(size_t capacity);
+size_t getDocumentCacheCapacity();
+int trimDocumentCache(size_t keepCount);
+
+/**
+ * Keeps a page of the document loaded for as long as it is in scope.
+ */
+class PagePin {
+    public:
+    PagePin(DocumentFile *doc, int pageIndex) : doc(doc), pageIndex(pageIndex), page(NULL) {
+        if(doc != NULL) page = doc->pageCache.acquire(doc->pdfDocument, pageIndex);
+    }
+    ~PagePin(){
+        if(page != NULL) doc->pageCache.release(pageIndex);
+    }
+    FPDF_PAGE get() const { return page; }
+    DocumentFile* getDocument() const { return doc; }
+
+    private:
+    PagePin(const PagePin&); //Disallow copy
+
+    DocumentFile *doc;
+    int pageIndex;
+    FPDF_PAGE page;
+};
+
+#endif
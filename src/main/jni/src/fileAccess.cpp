@@ -0,0 +1,323 @@
+#include "util.hpp"
+#include "fileAccess.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <sys/stat.h>
+}
+
+using namespace android;
+
+bool getFileIdentity(int fd, FileIdentity *identity){
+    struct stat file_state;
+
+    if(fstat(fd, &file_state) >= 0){
+        identity->device = (int64_t)file_state.st_dev;
+        identity->inode = (int64_t)file_state.st_ino;
+        identity->size = (int64_t)file_state.st_size;
+        //bionic before L has no st_mtim, only st_mtime_nsec, which it keeps as an alias later
+#if defined(__BIONIC__)
+        int64_t nanos = (int64_t)file_state.st_mtime_nsec;
+#else
+        int64_t nanos = (int64_t)file_state.st_mtim.tv_nsec;
+#endif
+        identity->modifiedTime = (int64_t)file_state.st_mtime * 1000000000LL + nanos;
+        return true;
+    }else{
+        LOGE("Error getting file size");
+        return false;
+    }
+}
+
+//Enough for the trailer and startxref, or the head of an xref stream dictionary
+static const size_t kTrailerScanBytes = 1024;
+
+//Start of the last occurrence of word in data, NULL if there is none
+static const char* findLast(const char *data, size_t length, const char *word){
+    size_t wordLength = strlen(word);
+    if(length < wordLength) return NULL;
+    const char *at = data + length - wordLength;
+    while(true){
+        if(memcmp(at, word, wordLength) == 0) return at;
+        if(at == data) return NULL;
+        at--;
+    }
+}
+
+static bool isPdfSpace(char c){
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+//FNV-1a over the /ID array starting at id, whitespace skipped; 0 if there is none
+static uint64_t hashIdArray(const char *id, const char *end){
+    const char *p = id + 3;
+    while(p < end && isPdfSpace(*p)) p++;
+    if(p == end || *p != '[') return 0;
+
+    uint64_t hash = 14695981039346656037ULL;
+    for(p++; p < end && *p != ']'; p++){
+        if(isPdfSpace(*p)) continue;
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    if(p == end) return 0;
+    return (hash != 0)? hash : 1;
+}
+
+//Reads up to kTrailerScanBytes at offset and terminates them, returns the length read
+static size_t readForScan(int fd, int64_t offset, int64_t fileSize, char *buffer){
+    int64_t length = fileSize - offset;
+    if(length > (int64_t)kTrailerScanBytes) length = kTrailerScanBytes;
+    ssize_t ret = 0;
+    if(offset >= 0 && length > 0){
+        do{ ret = pread(fd, buffer, (size_t)length, (off_t)offset); }while(ret < 0 && errno == EINTR);
+    }
+    if(ret < 0) ret = 0;
+    buffer[ret] = '\0';
+    return (size_t)ret;
+}
+
+uint64_t getDocumentFingerprint(int fd, int64_t fileSize){
+    char buffer[kTrailerScanBytes + 1];
+    int64_t tailOffset = fileSize - (int64_t)kTrailerScanBytes;
+    size_t length = readForScan(fd, (tailOffset > 0)? tailOffset : 0, fileSize, buffer);
+
+    const char *id = findLast(buffer, length, "/ID");
+    uint64_t fingerprint = (id != NULL)? hashIdArray(id, buffer + length) : 0;
+    if(fingerprint != 0) return fingerprint;
+
+    //Cross reference streams keep the trailer entries in their dictionary
+    const char *startXref = findLast(buffer, length, "startxref");
+    if(startXref == NULL) return 0;
+    int64_t xrefOffset = strtoll(startXref + 9, NULL, 10);
+    length = readForScan(fd, xrefOffset, fileSize, buffer);
+
+    //Only the dictionary, the stream data after it is binary
+    const char *dictEnd = strstr(buffer, "stream");
+    if(dictEnd == NULL) dictEnd = buffer + length;
+    id = findLast(buffer, (size_t)(dictEnd - buffer), "/ID");
+    return (id != NULL)? hashIdArray(id, dictEnd) : 0;
+}
+
+BlockFileReader::BlockFileReader(int fd, size_t fileLength) :
+        fileFd(dup(fd)),
+        fileSize(fileLength),
+        availability(NULL),
+        useCounter(0) {
+
+    if(fileFd < 0){
+        LOGE("Duplicating file descriptor failed: %s", strerror(errno));
+    }
+
+    memset(blocks, 0, sizeof(blocks));
+    for(int i = 0; i < kBlockCount; i++){ blocks[i].offset = -1; }
+
+    fileAccess.m_FileLen = (unsigned long)fileLength;
+    fileAccess.m_GetBlock = getBlockCallback;
+    fileAccess.m_Param = this;
+}
+
+BlockFileReader::~BlockFileReader(){
+    for(int i = 0; i < kBlockCount; i++){
+        free(blocks[i].data);
+    }
+    if(fileFd >= 0) close(fileFd);
+}
+
+bool BlockFileReader::readFully(unsigned char *dst, off_t offset, size_t size){
+    while(size > 0){
+        ssize_t ret = pread(fileFd, dst, size, offset);
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            LOGE("Reading file failed: %s", strerror(errno));
+            return false;
+        }
+        if(ret == 0) return false; //Hit EOF before the requested range was satisfied
+
+        dst += ret;
+        offset += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+BlockFileReader::Block* BlockFileReader::findBlock(off_t offset){
+    for(int i = 0; i < kBlockCount; i++){
+        if(blocks[i].offset == offset) return &blocks[i];
+    }
+    return NULL;
+}
+
+size_t BlockFileReader::getBlockLength(off_t offset) const {
+    size_t length = fileSize - (size_t)offset;
+    return (length > kBlockSize)? kBlockSize : length;
+}
+
+BlockFileReader::Block* BlockFileReader::loadBlock(off_t offset){
+    Block *victim = &blocks[0];
+    for(int i = 1; i < kBlockCount && victim->data != NULL; i++){
+        if(blocks[i].data == NULL || blocks[i].lastUse < victim->lastUse){
+            victim = &blocks[i];
+        }
+    }
+
+    if(victim->data == NULL){
+        if( (victim->data = (unsigned char*)malloc(kBlockSize)) == NULL ) return NULL;
+    }
+
+    size_t length = getBlockLength(offset);
+
+    //Only keep blocks that could be read completely,
+    //a short read would otherwise stay cached as garbage
+    victim->offset = -1;
+    if(!readFully(victim->data, offset, length)) return NULL;
+    victim->offset = offset;
+
+    return victim;
+}
+
+int BlockFileReader::getBlock(unsigned long position, unsigned char *pBuf, unsigned long size){
+    if(size >= kBlockSize){
+        //Large reads (mostly image streams) gain nothing from the cache
+        return readFully(pBuf, (off_t)position, size)? 1 : 0;
+    }
+
+    Mutex::Autolock lock(cacheLock);
+    while(size > 0){
+        off_t blockOffset = (off_t)(position & ~(unsigned long)(kBlockSize - 1));
+        size_t inBlockOffset = (size_t)(position - blockOffset);
+        size_t chunk = kBlockSize - inBlockOffset;
+        if(chunk > size) chunk = size;
+
+        Block *block = findBlock(blockOffset);
+        if(block == NULL && availability != NULL &&
+           !availability->isRangeAvailable((size_t)blockOffset, getBlockLength(blockOffset))){
+            //Part of the block hasn't arrived, what's there now may still change
+            if(!readFully(pBuf, (off_t)position, chunk)) return 0;
+            pBuf += chunk;
+            position += chunk;
+            size -= chunk;
+            continue;
+        }
+        if(block == NULL && (block = loadBlock(blockOffset)) == NULL){
+            return readFully(pBuf, (off_t)position, size)? 1 : 0;
+        }
+        block->lastUse = ++useCounter;
+
+        memcpy(pBuf, block->data + inBlockOffset, chunk);
+        pBuf += chunk;
+        position += chunk;
+        size -= chunk;
+    }
+    return 1;
+}
+
+int BlockFileReader::getBlockCallback(void *param, unsigned long position,
+                                      unsigned char *pBuf, unsigned long size){
+    return reinterpret_cast<BlockFileReader*>(param)->getBlock(position, pBuf, size);
+}
+
+BufferedFileWriter::BufferedFileWriter(int fd, size_t skipBytes, long syncInterval) :
+        fileFd(fd),
+        skipRemaining(skipBytes),
+        syncInterval(syncInterval),
+        buffer((unsigned char*)malloc(kBufferSize)),
+        buffered(0),
+        bufferOffset((off_t)skipBytes),
+        bytesWritten(0),
+        bytesSinceSync(0),
+        failed(buffer == NULL) {
+
+    sink.iface.version = 1;
+    sink.iface.WriteBlock = writeBlockCallback;
+    sink.writer = this;
+}
+
+BufferedFileWriter::~BufferedFileWriter(){
+    free(buffer);
+}
+
+bool BufferedFileWriter::writeFully(const unsigned char *src, size_t size, off_t offset){
+    while(size > 0){
+        ssize_t ret = pwrite(fileFd, src, size, offset);
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            LOGE("Writing file failed: %s", strerror(errno));
+            return false;
+        }
+
+        src += ret;
+        offset += ret;
+        size -= (size_t)ret;
+        bytesWritten += (size_t)ret;
+        bytesSinceSync += (size_t)ret;
+    }
+
+    if(syncInterval > 0 && bytesSinceSync >= (size_t)syncInterval){
+        fdatasync(fileFd);
+        bytesSinceSync = 0;
+    }
+    return true;
+}
+
+//Writes out the first length bytes of the buffer and keeps the rest
+bool BufferedFileWriter::flushBuffer(size_t length){
+    if(length == 0) return true;
+    if(!writeFully(buffer, length, bufferOffset)) return false;
+
+    memmove(buffer, buffer + length, buffered - length);
+    buffered -= length;
+    bufferOffset += length;
+    return true;
+}
+
+int BufferedFileWriter::writeBlock(const void *data, unsigned long size){
+    if(failed) return 0;
+
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    if(skipRemaining > 0){
+        size_t skip = (size < skipRemaining)? (size_t)size : skipRemaining;
+        src += skip;
+        size -= skip;
+        skipRemaining -= skip;
+    }
+
+    while(size > 0){
+        size_t chunk = kBufferSize - buffered;
+        if(chunk > size) chunk = size;
+        memcpy(buffer + buffered, src, chunk);
+        buffered += chunk;
+        src += chunk;
+        size -= chunk;
+
+        if(buffered == kBufferSize){
+            //Stop at a block boundary, so every later write starts aligned
+            size_t length = kBufferSize - (size_t)((bufferOffset + kBufferSize) % kAlignment);
+            if(!flushBuffer(length)){
+                failed = true;
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+bool BufferedFileWriter::finish(){
+    if(failed || !flushBuffer(buffered)) return false;
+
+    if(ftruncate(fileFd, bufferOffset) != 0){
+        LOGE("Truncating file failed: %s", strerror(errno));
+        return false;
+    }
+    if(syncInterval != kSyncNone && fdatasync(fileFd) != 0){
+        LOGE("Syncing file failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int BufferedFileWriter::writeBlockCallback(FPDF_FILEWRITE *pThis, const void *data, unsigned long size){
+    return reinterpret_cast<Sink*>(pThis)->writer->writeBlock(data, size);
+}
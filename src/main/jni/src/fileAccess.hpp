@@ -0,0 +1,145 @@
+#ifndef _FILE_ACCESS_HPP_
+#define _FILE_ACCESS_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <sys/types.h>
+}
+
+#include <utils/Mutex.h>
+
+#include <fpdfview.h>
+#include <fpdfsave.h>
+
+#include "dataAvail.hpp"
+
+/**
+ * Identifies a file's content well enough to reuse what was parsed from it.
+ * A file that is modified or replaced gets a different identity.
+ */
+struct FileIdentity {
+    int64_t device;
+    int64_t inode;
+    int64_t size;
+    //Nanoseconds, so a rewrite within the same second still counts
+    int64_t modifiedTime;
+
+    bool operator<(const FileIdentity &other) const {
+        if(device != other.device) return device < other.device;
+        if(inode != other.inode) return inode < other.inode;
+        if(size != other.size) return size < other.size;
+        return modifiedTime < other.modifiedTime;
+    }
+    bool isSameFile(const FileIdentity &other) const {
+        return device == other.device && inode == other.inode;
+    }
+};
+
+bool getFileIdentity(int fd, FileIdentity *identity);
+
+/*
+ * Hash of the document's /ID array, read from the last trailer or the xref
+ * stream dictionary startxref points at. Follows the content rather than the
+ * file: copies share it, and the second ID changes when the document is saved.
+ * 0 if the file has no /ID.
+ */
+uint64_t getDocumentFingerprint(int fd, int64_t fileSize);
+
+/**
+ * Positioned-read file source for FPDF_LoadCustomDocument.
+ * Keeps a handful of aligned blocks around so the small sequential reads
+ * issued by the pdfium parser don't each turn into a syscall, while resident
+ * memory stays bounded by kBlockCount * kBlockSize regardless of file size.
+ */
+class BlockFileReader {
+    public:
+    static const size_t kBlockSize = 64 * 1024;
+    static const int kBlockCount = 16;
+
+    BlockFileReader(int fd, size_t fileLength);
+    ~BlockFileReader();
+
+    bool isValid() const { return fileFd >= 0; }
+    FPDF_FILEACCESS* getFileAccess() { return &fileAccess; }
+    /*
+     * For files still being written: only blocks the tracker reports complete
+     * are cached, the rest is read from the file every time, so a hole read
+     * back as zeros never outlives the data arriving.
+     */
+    void setAvailability(AvailabilityTracker *tracker) { availability = tracker; }
+
+    private:
+    struct Block {
+        off_t offset;
+        unsigned long lastUse;
+        unsigned char *data;
+    };
+
+    int fileFd;
+    size_t fileSize;
+    FPDF_FILEACCESS fileAccess;
+    AvailabilityTracker *availability;
+
+    android::Mutex cacheLock;
+    Block blocks[kBlockCount];
+    unsigned long useCounter;
+
+    Block* findBlock(off_t offset);
+    Block* loadBlock(off_t offset);
+    size_t getBlockLength(off_t offset) const;
+    bool readFully(unsigned char *dst, off_t offset, size_t size);
+    int getBlock(unsigned long position, unsigned char *pBuf, unsigned long size);
+
+    static int getBlockCallback(void *param, unsigned long position,
+                                unsigned char *pBuf, unsigned long size);
+};
+
+/**
+ * FPDF_FILEWRITE sink that gathers pdfium's many small WriteBlock calls into
+ * large block-aligned pwrite()s.
+ * skipBytes lets an incremental save into the source file pass over the
+ * unchanged original content pdfium emits first, so only the appended
+ * update section actually hits the disk.
+ */
+class BufferedFileWriter {
+    public:
+    static const size_t kBufferSize = 256 * 1024;
+    static const size_t kAlignment = 4096;
+
+    //Sync modes besides a byte interval
+    static const long kSyncNone = -1;
+    static const long kSyncAtEnd = 0;
+
+    BufferedFileWriter(int fd, size_t skipBytes, long syncInterval);
+    ~BufferedFileWriter();
+
+    FPDF_FILEWRITE* getFileWrite() { return &sink.iface; }
+    //Flushes, truncates the file to what was written and syncs, false if anything failed
+    bool finish();
+    size_t getBytesWritten() const { return bytesWritten; }
+
+    private:
+    struct Sink {
+        FPDF_FILEWRITE iface;
+        BufferedFileWriter *writer;
+    } sink;
+
+    int fileFd;
+    size_t skipRemaining;
+    long syncInterval;
+    unsigned char *buffer;
+    size_t buffered;
+    //File offset of buffer[0]
+    off_t bufferOffset;
+    size_t bytesWritten;
+    size_t bytesSinceSync;
+    bool failed;
+
+    bool flushBuffer(size_t length);
+    bool writeFully(const unsigned char *src, size_t size, off_t offset);
+    int writeBlock(const void *data, unsigned long size);
+
+    static int writeBlockCallback(FPDF_FILEWRITE *pThis, const void *data, unsigned long size);
+};
+
+#endif
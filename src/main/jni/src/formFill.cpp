@@ -0,0 +1,89 @@
+#include "util.hpp"
+#include "formFill.hpp"
+#include "documentFile.hpp"
+
+extern "C" {
+    #include <string.h>
+    #include <sys/time.h>
+    #include <time.h>
+}
+
+#include <algorithm>
+
+FormFiller::FormFiller(DocumentFile *doc) :
+        doc(doc),
+        formHandle(NULL) {
+
+    //Callbacks left NULL are skipped by pdfium
+    memset(&info, 0, sizeof(info));
+    info.iface.version = 1;
+    info.iface.FFI_Invalidate = invalidateCallback;
+    info.iface.FFI_GetLocalTime = getLocalTimeCallback;
+    info.filler = this;
+
+    if(doc->pdfDocument == NULL) return;
+    formHandle = FPDFDOC_InitFormFillEnviroument(doc->pdfDocument, &info.iface);
+    if(formHandle == NULL){
+        LOGE("Init form fill environment failed");
+        return;
+    }
+    doc->pageCache.setPageListener(this);
+}
+
+FormFiller::~FormFiller(){
+    std::vector<InvalidateListener*> detached(listeners);
+    for(std::vector<InvalidateListener*>::iterator it = detached.begin(); it != detached.end(); ++it){
+        (*it)->onDetached();
+    }
+    if(formHandle == NULL) return;
+
+    //Pages have to leave the environment before it goes
+    doc->pageCache.setPageListener(NULL);
+    FPDFDOC_ExitFormFillEnviroument(formHandle);
+}
+
+void FormFiller::addListener(InvalidateListener *listener){
+    if(std::find(listeners.begin(), listeners.end(), listener) == listeners.end()){
+        listeners.push_back(listener);
+    }
+}
+
+void FormFiller::removeListener(InvalidateListener *listener){
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+void FormFiller::onPageLoaded(FPDF_PAGE page){
+    FORM_OnAfterLoadPage(page, formHandle);
+}
+
+void FormFiller::onPageClosing(FPDF_PAGE page){
+    FORM_OnBeforeClosePage(page, formHandle);
+}
+
+void FormFiller::invalidateCallback(FPDF_FORMFILLINFO *pThis, FPDF_PAGE page,
+                                    double left, double top, double right, double bottom){
+    FormFiller *filler = reinterpret_cast<Info*>(pThis)->filler;
+    for(std::vector<InvalidateListener*>::iterator it = filler->listeners.begin();
+        it != filler->listeners.end(); ++it){
+        (*it)->onInvalidate(page, left, top, right, bottom);
+    }
+}
+
+FPDF_SYSTEMTIME FormFiller::getLocalTimeCallback(FPDF_FORMFILLINFO *pThis){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct tm local;
+    time_t seconds = now.tv_sec;
+    localtime_r(&seconds, &local);
+
+    FPDF_SYSTEMTIME systemTime;
+    systemTime.wYear = (unsigned short)(local.tm_year + 1900);
+    systemTime.wMonth = (unsigned short)(local.tm_mon + 1);
+    systemTime.wDayOfWeek = (unsigned short)local.tm_wday;
+    systemTime.wDay = (unsigned short)local.tm_mday;
+    systemTime.wHour = (unsigned short)local.tm_hour;
+    systemTime.wMinute = (unsigned short)local.tm_min;
+    systemTime.wSecond = (unsigned short)local.tm_sec;
+    systemTime.wMilliseconds = (unsigned short)(now.tv_usec / 1000);
+    return systemTime;
+}
@@ -0,0 +1,61 @@
+#ifndef _FORM_FILL_HPP_
+#define _FORM_FILL_HPP_
+
+#include <vector>
+
+#include <fpdfview.h>
+#include <fpdfformfill.h>
+
+#include "pageCache.hpp"
+
+class DocumentFile;
+
+/**
+ * Form fill environment of a document. pdfium draws the widgets with
+ * FPDF_FFLDraw and takes input through the FORM_On* calls; whatever a change
+ * affects comes back through FFI_Invalidate as a rectangle in page space,
+ * which is passed on to the registered listeners.
+ * Attaches itself to every page the document's page cache loads.
+ * JavaScript isn't supported. Used under the document lock only.
+ */
+class FormFiller : public PageCache::PageListener {
+    public:
+    class InvalidateListener {
+        public:
+        virtual ~InvalidateListener() { }
+        //Page rectangle in PDF units, top above bottom
+        virtual void onInvalidate(FPDF_PAGE page, double left, double top, double right, double bottom) = 0;
+        //The filler goes away, forget it
+        virtual void onDetached() = 0;
+    };
+
+    explicit FormFiller(DocumentFile *doc);
+    ~FormFiller();
+
+    bool isValid() const { return formHandle != NULL; }
+    FPDF_FORMHANDLE getHandle() const { return formHandle; }
+
+    void addListener(InvalidateListener *listener);
+    void removeListener(InvalidateListener *listener);
+
+    void onPageLoaded(FPDF_PAGE page);
+    void onPageClosing(FPDF_PAGE page);
+
+    private:
+    FormFiller(const FormFiller&); //Disallow copy
+
+    struct Info {
+        FPDF_FORMFILLINFO iface;
+        FormFiller *filler;
+    } info;
+
+    DocumentFile *doc;
+    FPDF_FORMHANDLE formHandle;
+    std::vector<InvalidateListener*> listeners;
+
+    static void invalidateCallback(FPDF_FORMFILLINFO *pThis, FPDF_PAGE page,
+                                   double left, double top, double right, double bottom);
+    static FPDF_SYSTEMTIME getLocalTimeCallback(FPDF_FORMFILLINFO *pThis);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "util.hpp"
+#include "jobScheduler.hpp"
+#include "renderControl.hpp"
+
+extern "C" {
+    #include <pthread.h>
+    #include <string.h>
+}
+
+using namespace android;
+
+//Innermost job of each thread
+static pthread_key_t sCurrentJobKey;
+static pthread_once_t sCurrentJobOnce = PTHREAD_ONCE_INIT;
+
+static void createCurrentJobKey(){
+    pthread_key_create(&sCurrentJobKey, NULL);
+}
+
+static JobScheduler::Job* getCurrentJob(){
+    pthread_once(&sCurrentJobOnce, createCurrentJobKey);
+    return reinterpret_cast<JobScheduler::Job*>(pthread_getspecific(sCurrentJobKey));
+}
+
+static void setCurrentJob(JobScheduler::Job *job){
+    pthread_once(&sCurrentJobOnce, createCurrentJobKey);
+    pthread_setspecific(sCurrentJobKey, job);
+}
+
+JobScheduler::JobScheduler() : refs(1) {
+    memset(const_cast<int*>(pending), 0, sizeof(pending));
+    memset(stats, 0, sizeof(stats));
+}
+
+JobScheduler::~JobScheduler(){}
+
+void JobScheduler::acquire(){
+    __sync_fetch_and_add(&refs, 1);
+}
+
+void JobScheduler::release(){
+    if(__sync_sub_and_fetch(&refs, 1) == 0) delete this;
+}
+
+bool JobScheduler::hasUrgentWork(JobClass jobClass) const {
+    int i;
+    for(i = 0; i < jobClass; i++){
+        if(__sync_fetch_and_add(const_cast<volatile int*>(&pending[i]), 0) > 0) return true;
+    }
+    return false;
+}
+
+JobScheduler::Job* JobScheduler::enter(JobClass jobClass){
+    acquire();
+    Job *job = new Job();
+    job->scheduler = this;
+    job->jobClass = jobClass;
+    job->enterTime = currentTimeNanos();
+    job->running = false;
+    job->preempted = false;
+    job->outer = getCurrentJob();
+
+    bool nested = false;
+    Job *outer;
+    for(outer = job->outer; outer != NULL; outer = outer->outer){
+        if(outer->scheduler == this && outer->running) nested = true;
+    }
+
+    {
+        Mutex::Autolock autoLock(lock);
+        //Counted right away, running lower classes start yielding now
+        __sync_fetch_and_add(&pending[jobClass], 1);
+        ClassStats &classStats = stats[jobClass];
+        if(++classStats.queued > classStats.maxQueued) classStats.maxQueued = classStats.queued;
+        while(!nested && hasUrgentWork(jobClass)) jobLeft.wait(lock);
+    }
+    setCurrentJob(job);
+    return job;
+}
+
+void JobScheduler::begin(Job *job){
+    int64_t wait = currentTimeNanos() - job->enterTime;
+    job->running = true;
+
+    Mutex::Autolock autoLock(lock);
+    ClassStats &classStats = stats[job->jobClass];
+    classStats.queued--;
+    classStats.jobs++;
+    classStats.totalWaitNanos += wait;
+    if(wait > classStats.maxWaitNanos) classStats.maxWaitNanos = wait;
+}
+
+bool JobScheduler::leave(Job *job){
+    bool preempted = job->preempted;
+    setCurrentJob(job->outer);
+    {
+        Mutex::Autolock autoLock(lock);
+        ClassStats &classStats = stats[job->jobClass];
+        //Gave up before getting the document, e.g. it was closed meanwhile
+        if(!job->running) classStats.queued--;
+        if(preempted) classStats.preemptions++;
+        __sync_fetch_and_sub(&pending[job->jobClass], 1);
+        jobLeft.broadcast();
+    }
+    delete job;
+    release();
+    return preempted;
+}
+
+bool JobScheduler::shouldCurrentJobYield(){
+    Job *job = getCurrentJob();
+    if(job == NULL || !job->running || !job->scheduler->hasUrgentWork(job->jobClass)) return false;
+    job->preempted = true;
+    return true;
+}
+
+bool JobScheduler::isCurrentJobPreemptible(){
+    Job *job = getCurrentJob();
+    return job != NULL && job->running && job->jobClass > JOB_VISIBLE;
+}
+
+void JobScheduler::getStats(JobClass jobClass, ClassStats *outStats){
+    Mutex::Autolock autoLock(lock);
+    *outStats = stats[jobClass];
+}
@@ -0,0 +1,96 @@
+#ifndef _JOB_SCHEDULER_HPP_
+#define _JOB_SCHEDULER_HPP_
+
+extern "C" {
+    #include <stdint.h>
+}
+
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+
+//Most urgent first, keep in sync with PdfiumCore.JOB_*
+enum JobClass {
+    JOB_VISIBLE = 0,
+    JOB_NEAR_VISIBLE,
+    JOB_THUMBNAIL,
+    JOB_INDEXING,
+    JOB_CLASS_COUNT
+};
+
+/**
+ * Orders the work competing for one document's lock by JobClass. A job
+ * waits in enter() while a more urgent class has work queued or running, and
+ * renders of a running job give way at their next IFSDK_PAUSE checkpoint as
+ * soon as more urgent work shows up (see RenderPause). A preempted job lets
+ * go of the document and comes back through enter(): progressive renders
+ * resume where they paused, one-shot renders start over.
+ *
+ * A job belongs to the thread that entered it, which is how a render's pause
+ * callback finds it without it being passed down. Shared by the document's
+ * threads and reference counted, since background jobs may outlive the
+ * document's close.
+ */
+class JobScheduler {
+    public:
+    struct Job;
+
+    struct ClassStats {
+        int64_t jobs;
+        int64_t preemptions;
+        int64_t totalWaitNanos;
+        int64_t maxWaitNanos;
+        //Entered but not begun yet
+        int queued;
+        int maxQueued;
+    };
+
+    //Starts with one reference, the document's
+    JobScheduler();
+
+    void acquire();
+    //Frees the scheduler with the last reference
+    void release();
+
+    /*
+     * Before taking the document lock, blocks while a more urgent class has
+     * work. Holds a reference until leave(). A job entered on a thread that
+     * runs a job of this scheduler already doesn't wait, it holds the lock.
+     */
+    Job* enter(JobClass jobClass);
+    //With the document lock taken, from here on the job's renders may be preempted
+    void begin(Job *job);
+    //After letting go of the document lock, frees the job. True if it was preempted.
+    bool leave(Job *job);
+
+    //From a render's pause callback: the calling thread's job should give way
+    static bool shouldCurrentJobYield();
+    //The calling thread runs a job that more urgent work may preempt
+    static bool isCurrentJobPreemptible();
+
+    void getStats(JobClass jobClass, ClassStats *outStats);
+
+    private:
+    ~JobScheduler();
+    JobScheduler(const JobScheduler&); //Disallow copy
+
+    android::Mutex lock;
+    android::Condition jobLeft;
+    //Jobs entered and not left per class, also read without the lock
+    volatile int pending[JOB_CLASS_COUNT];
+    volatile int refs;
+    ClassStats stats[JOB_CLASS_COUNT];
+
+    bool hasUrgentWork(JobClass jobClass) const;
+};
+
+struct JobScheduler::Job {
+    JobScheduler *scheduler;
+    JobClass jobClass;
+    int64_t enterTime;
+    bool running;
+    bool preempted;
+    //Job the thread was running when this one was entered
+    Job *outer;
+};
+
+#endif
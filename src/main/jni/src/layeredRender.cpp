@@ -0,0 +1,181 @@
+#include "util.hpp"
+#include "layeredRender.hpp"
+#include "bitmapRender.hpp"
+
+extern "C" {
+    #include <stdint.h>
+    #include <stdlib.h>
+    #include <string.h>
+}
+
+LayeredPageRender::LayeredPageRender(DocumentFile *doc) :
+        filler(doc->formFiller),
+        pageLayer(NULL),
+        overlay(NULL),
+        canvasHorSize(0),
+        canvasVerSize(0),
+        page(NULL),
+        pageIndex(-1),
+        startX(0),
+        startY(0),
+        drawSizeHor(0),
+        drawSizeVer(0),
+        pageValid(false),
+        dirtyLeft(0),
+        dirtyTop(0),
+        dirtyRight(0),
+        dirtyBottom(0) {
+
+    if(filler != NULL) filler->addListener(this);
+}
+
+LayeredPageRender::~LayeredPageRender(){
+    if(filler != NULL) filler->removeListener(this);
+    free(pageLayer);
+    free(overlay);
+}
+
+bool LayeredPageRender::resizeCanvas(int horSize, int verSize){
+    if(pageLayer != NULL && overlay != NULL &&
+       horSize == canvasHorSize && verSize == canvasVerSize) return true;
+
+    free(pageLayer);
+    free(overlay);
+    pageValid = false;
+    canvasHorSize = canvasVerSize = 0;
+    pageLayer = (unsigned char*)malloc(horSize * verSize * 4);
+    overlay = (unsigned char*)malloc(horSize * verSize * 4);
+    if(pageLayer == NULL || overlay == NULL){
+        LOGE("Allocating render layers failed");
+        free(pageLayer);
+        free(overlay);
+        pageLayer = overlay = NULL;
+        return false;
+    }
+    canvasHorSize = horSize;
+    canvasVerSize = verSize;
+    return true;
+}
+
+void LayeredPageRender::markDirty(int left, int top, int right, int bottom){
+    if(dirtyLeft >= dirtyRight){
+        dirtyLeft = left;
+        dirtyTop = top;
+        dirtyRight = right;
+        dirtyBottom = bottom;
+        return;
+    }
+    if(left < dirtyLeft) dirtyLeft = left;
+    if(top < dirtyTop) dirtyTop = top;
+    if(right > dirtyRight) dirtyRight = right;
+    if(bottom > dirtyBottom) dirtyBottom = bottom;
+}
+
+void LayeredPageRender::onInvalidate(FPDF_PAGE page, double left, double top, double right, double bottom){
+    if(page != this->page || overlay == NULL) return;
+
+    int x0, y0, x1, y1;
+    FPDF_PageToDevice(page, startX, startY, drawSizeHor, drawSizeVer, 0, left, top, &x0, &y0);
+    FPDF_PageToDevice(page, startX, startY, drawSizeHor, drawSizeVer, 0, right, bottom, &x1, &y1);
+    if(x0 > x1){ int t = x0; x0 = x1; x1 = t; }
+    if(y0 > y1){ int t = y0; y0 = y1; y1 = t; }
+
+    //Antialiased edges reach into the neighbouring pixels
+    markDirty(x0 - 1, y0 - 1, x1 + 2, y1 + 2);
+}
+
+void LayeredPageRender::drawOverlay(){
+    int left = (dirtyLeft < 0)? 0 : dirtyLeft;
+    int top = (dirtyTop < 0)? 0 : dirtyTop;
+    int right = (dirtyRight > canvasHorSize)? canvasHorSize : dirtyRight;
+    int bottom = (dirtyBottom > canvasVerSize)? canvasVerSize : dirtyBottom;
+    dirtyLeft = dirtyTop = dirtyRight = dirtyBottom = 0;
+    if(left >= right || top >= bottom) return;
+
+    int stride = canvasHorSize * 4;
+    unsigned char *origin = overlay + top * stride + left * 4;
+    int i;
+    for(i = 0; i < bottom - top; i++){
+        memset(origin + i * stride, 0, (right - left) * 4); //Transparent
+    }
+    if(filler == NULL) return;
+
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( right - left, bottom - top,
+                                                 FPDFBitmap_BGRA, origin, stride );
+    if(pdfBitmap == NULL) return;
+    FPDF_FFLDraw( filler->getHandle(), pdfBitmap, page,
+                  startX - left, startY - top, drawSizeHor, drawSizeVer,
+                  0, FPDF_ANNOT );
+    FPDFBitmap_Destroy(pdfBitmap);
+}
+
+//Overlay over page layer; the overlay isn't premultiplied and has red and blue swapped
+void LayeredPageRender::composite(void *dst, int dstStride) const {
+    int stride = canvasHorSize * 4;
+    int i, j;
+    for(i = 0; i < canvasVerSize; i++){
+        const uint32_t *pageRow = reinterpret_cast<const uint32_t*>(pageLayer + i * stride);
+        const unsigned char *overlayRow = overlay + i * stride;
+        uint32_t *dstRow = reinterpret_cast<uint32_t*>(reinterpret_cast<unsigned char*>(dst) + i * dstStride);
+
+        for(j = 0; j < canvasHorSize; j++){
+            const unsigned char *o = overlayRow + j * 4;
+            unsigned int alpha = o[3];
+            if(alpha == 0){
+                dstRow[j] = pageRow[j];
+                continue;
+            }
+
+            unsigned char *d = reinterpret_cast<unsigned char*>(dstRow + j);
+            if(alpha == 255){
+                d[0] = o[2];
+                d[1] = o[1];
+                d[2] = o[0];
+            }else{
+                const unsigned char *p = reinterpret_cast<const unsigned char*>(pageRow + j);
+                unsigned int inverse = 255 - alpha;
+                d[0] = (unsigned char)((o[2] * alpha + p[0] * inverse + 127) / 255);
+                d[1] = (unsigned char)((o[1] * alpha + p[1] * inverse + 127) / 255);
+                d[2] = (unsigned char)((o[0] * alpha + p[2] * inverse + 127) / 255);
+            }
+            d[3] = 255;
+        }
+    }
+}
+
+RenderStatus LayeredPageRender::render(FPDF_PAGE page, int pageIndex,
+                                       int canvasHorSize, int canvasVerSize,
+                                       int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                       CancelToken *token, void *dst, int dstStride){
+    if(page == NULL || canvasHorSize <= 0 || canvasVerSize <= 0) return RENDER_FAILED;
+    if(!resizeCanvas(canvasHorSize, canvasVerSize)) return RENDER_FAILED;
+
+    //The page handle changes when the page was closed and loaded again
+    bool moved = !pageValid ||
+                 page != this->page || pageIndex != this->pageIndex ||
+                 startX != this->startX || startY != this->startY ||
+                 drawSizeHor != this->drawSizeHor || drawSizeVer != this->drawSizeVer;
+    if(moved){
+        this->page = page;
+        this->pageIndex = pageIndex;
+        this->startX = startX;
+        this->startY = startY;
+        this->drawSizeHor = drawSizeHor;
+        this->drawSizeVer = drawSizeVer;
+        pageValid = false;
+        markDirty(0, 0, canvasHorSize, canvasVerSize);
+    }
+
+    RenderStatus status = RENDER_DONE;
+    if(!pageValid){
+        //Without FPDF_ANNOT, annotations are the overlay's
+        status = renderPageToBuffer( page, pageLayer, canvasHorSize, canvasVerSize, canvasHorSize * 4,
+                                     PIXEL_FORMAT_RGBA_8888,
+                                     startX, startY, drawSizeHor, drawSizeVer, token );
+        pageValid = (status == RENDER_DONE);
+    }
+    drawOverlay();
+
+    composite(dst, dstStride);
+    return status;
+}
@@ -0,0 +1,64 @@
+#ifndef _LAYERED_RENDER_HPP_
+#define _LAYERED_RENDER_HPP_
+
+#include <fpdfview.h>
+
+#include "documentFile.hpp"
+#include "formFill.hpp"
+#include "renderControl.hpp"
+
+/**
+ * Page view with forms, kept in two layers so editing a field doesn't render
+ * the page again: the page content without annotations is rendered once into
+ * a cached RGBA layer, widgets and annotations are drawn by FPDF_FFLDraw into a
+ * transparent overlay, and each frame composites the overlay onto the page.
+ * FFI_Invalidate only marks a rectangle of the overlay dirty, the next frame
+ * redraws just that part of it.
+ * A change of page, placement or canvas size redraws both layers.
+ * Not thread safe, callers guard it with the document lock.
+ */
+class LayeredPageRender : public FormFiller::InvalidateListener {
+    public:
+    //The document must have forms enabled
+    explicit LayeredPageRender(DocumentFile *doc);
+    ~LayeredPageRender();
+
+    /*
+     * Brings both layers up to date for the page placed like in FPDF_RenderPageBitmap,
+     * then composites them into an RGBA buffer of the canvas size.
+     * A cancel only affects the page layer, which is then rendered again next time.
+     */
+    RenderStatus render(FPDF_PAGE page, int pageIndex,
+                        int canvasHorSize, int canvasVerSize,
+                        int startX, int startY, int drawSizeHor, int drawSizeVer,
+                        CancelToken *token, void *dst, int dstStride);
+
+    void onInvalidate(FPDF_PAGE page, double left, double top, double right, double bottom);
+    void onDetached() { filler = NULL; }
+
+    private:
+    LayeredPageRender(const LayeredPageRender&); //Disallow copy
+
+    FormFiller *filler;
+    unsigned char *pageLayer;
+    //BGRA with alpha, FPDF_FFLDraw ignores FPDF_REVERSE_BYTE_ORDER
+    unsigned char *overlay;
+    int canvasHorSize, canvasVerSize;
+
+    //Placement both layers were drawn for
+    FPDF_PAGE page;
+    int pageIndex;
+    int startX, startY;
+    int drawSizeHor, drawSizeVer;
+    bool pageValid;
+
+    //Part of the overlay to redraw, empty when dirtyLeft >= dirtyRight
+    int dirtyLeft, dirtyTop, dirtyRight, dirtyBottom;
+
+    bool resizeCanvas(int horSize, int verSize);
+    void markDirty(int left, int top, int right, int bottom);
+    void drawOverlay();
+    void composite(void *dst, int dstStride) const;
+};
+
+#endif
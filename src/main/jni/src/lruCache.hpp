@@ -0,0 +1,139 @@
+#ifndef _LRU_CACHE_HPP_
+#define _LRU_CACHE_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+#include <list>
+#include <map>
+
+/**
+ * Same contract as utils/LruCache.h (OnEntryRemoved listener, removeOldest...)
+ * but header only, since BasicHashtable lives in libutils which we don't link.
+ * Every entry carries a cost (1 by default) and the cache evicts from the
+ * oldest end until the total cost fits maxCost again.
+ * Not thread safe, callers guard it with their own lock.
+ */
+template <typename TKey, typename TValue>
+class BoundedLruCache {
+    public:
+    class OnEntryRemoved {
+        public:
+        virtual ~OnEntryRemoved() { }
+        virtual void operator()(const TKey &key, TValue &value) = 0;
+    };
+
+    explicit BoundedLruCache(size_t maxCost) : listener(NULL), maxCost(maxCost), totalCost(0) { }
+    //Owners that need the listener to run for the remaining entries call clear() first
+    ~BoundedLruCache() { }
+
+    void setOnEntryRemovedListener(OnEntryRemoved *l) { listener = l; }
+
+    size_t size() const { return index.size(); }
+    size_t cost() const { return totalCost; }
+    size_t getMaxCost() const { return maxCost; }
+    void setMaxCost(size_t cost){
+        maxCost = cost;
+        trimToCost(maxCost);
+    }
+
+    bool contains(const TKey &key) const { return index.find(key) != index.end(); }
+
+    //Marks the entry as the most recently used one
+    bool get(const TKey &key, TValue *outValue){
+        TValue *value = getPointer(key);
+        if(value == NULL) return false;
+
+        if(outValue != NULL) *outValue = *value;
+        return true;
+    }
+
+    //Like get, but points at the stored value, valid until the entry is removed
+    TValue* getPointer(const TKey &key){
+        typename Index::iterator it = index.find(key);
+        if(it == index.end()) return NULL;
+
+        entries.splice(entries.end(), entries, it->second);
+        return &(it->second->value);
+    }
+
+    //Fails if the key is present already; may evict older entries to make room
+    bool put(const TKey &key, const TValue &value, size_t entryCost = 1){
+        if(contains(key)) return false;
+
+        Entry entry = { key, value, entryCost };
+        index[key] = entries.insert(entries.end(), entry);
+        totalCost += entryCost;
+
+        //Never evict the entry just added, even if it alone exceeds the budget
+        while(totalCost > maxCost && entries.size() > 1) removeOldest();
+        return true;
+    }
+
+    //Detaches the entry without notifying the listener, the caller owns it afterwards
+    bool take(const TKey &key, TValue *outValue){
+        typename Index::iterator it = index.find(key);
+        if(it == index.end()) return false;
+
+        if(outValue != NULL) *outValue = it->second->value;
+        totalCost -= it->second->cost;
+        entries.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    bool remove(const TKey &key){
+        typename Index::iterator it = index.find(key);
+        if(it == index.end()) return false;
+
+        Entry entry = *(it->second);
+        totalCost -= entry.cost;
+        entries.erase(it->second);
+        index.erase(it);
+        if(listener != NULL) (*listener)(entry.key, entry.value);
+        return true;
+    }
+
+    bool removeOldest(){
+        if(entries.empty()) return false;
+        TKey key = entries.front().key;
+        return remove(key);
+    }
+
+    //Returns the cost released
+    size_t trimToCost(size_t targetCost){
+        size_t before = totalCost;
+        while(totalCost > targetCost && removeOldest());
+        return before - totalCost;
+    }
+
+    void clear() { trimToCost(0); }
+
+    //Oldest first, for callers that need to walk the entries
+    template <typename TVisitor>
+    void forEach(TVisitor &visitor){
+        for(typename EntryList::iterator it = entries.begin(); it != entries.end(); ++it){
+            visitor(it->key, it->value);
+        }
+    }
+
+    private:
+    BoundedLruCache(const BoundedLruCache&); //Disallow copy
+
+    struct Entry {
+        TKey key;
+        TValue value;
+        size_t cost;
+    };
+    typedef std::list<Entry> EntryList;
+    typedef std::map<TKey, typename EntryList::iterator> Index;
+
+    EntryList entries;
+    Index index;
+    OnEntryRemoved *listener;
+    size_t maxCost;
+    size_t totalCost;
+};
+
+#endif
@@ -1,106 +1,157 @@
 #include "util.hpp"
+#include "documentFile.hpp"
+#include "metadataCache.hpp"
+#include "oomHandler.hpp"
+#include "progressiveRender.hpp"
+#include "renderControl.hpp"
+#include "bitmapRender.hpp"
+#include "thumbnailAtlas.hpp"
+#include "viewportRender.hpp"
+#include "layeredRender.hpp"
+#include "prefetch.hpp"
+#include "serialWorker.hpp"
+#include "renderPool.hpp"
+#include "jobScheduler.hpp"
+#include "scratchBuffer.hpp"
+#include "pinchPreview.hpp"
 
 extern "C" {
     #include <unistd.h>
     #include <sys/mman.h>
     #include <sys/stat.h>
     #include <string.h>
+    #include <sched.h>
 }
 
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
+#include <android/bitmap.h>
 #include <utils/Mutex.h>
 using namespace android;
 
 #include <fpdfview.h>
+#include <fpdfsave.h>
+#include <fpdfdoc.h>
+#include <fpdfedit.h>
+#include <fpdftext.h>
+#include <fpdfformfill.h>
 
 
-static Mutex sLibraryLock;
+extern "C" { //For JNI support
 
-static int sLibraryReferenceCount = 0;
+static void loadMappedDocument(DocumentFile *docFile, int fd, size_t fileLength){
+    void *map;
+    if( (map = mmap( docFile->getFileMap(), fileLength, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0 )) == MAP_FAILED){
+        throw "Error mapping file";
+    }
+    docFile->setFile(fd, map, fileLength);
 
-static void initLibraryIfNeed(){
-    Mutex::Autolock lock(sLibraryLock);
-    if(sLibraryReferenceCount == 0){
-        LOGD("Init FPDF library");
-        FPDF_InitLibrary(NULL);
+    if( (docFile->pdfDocument = FPDF_LoadMemDocument( reinterpret_cast<const void*>(docFile->getFileMap()),
+                                                      (int)docFile->fileSize, NULL)) == NULL) {
+        throw "Error loading document from file map";
     }
-    sLibraryReferenceCount++;
 }
 
-static void destroyLibraryIfNeed(){
-    Mutex::Autolock lock(sLibraryLock);
-    sLibraryReferenceCount--;
-    if(sLibraryReferenceCount == 0){
-        LOGD("Destroy FPDF library");
-        FPDF_DestroyLibrary();
+static void loadStreamingDocument(DocumentFile *docFile, int fd, size_t fileLength){
+    BlockFileReader *reader = new BlockFileReader(fd, fileLength);
+    docFile->setFileReader(fd, reader, fileLength);
+    if(!reader->isValid()) throw "Error opening file for streaming";
+
+    if( (docFile->pdfDocument = FPDF_LoadCustomDocument(reader->getFileAccess(), NULL)) == NULL ){
+        throw "Error loading document from file stream";
     }
 }
 
-class DocumentFile {
-    private:
-    void *fileMappedBuffer;
-    int fileFd;
+JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd, jint mode){
 
-    public:
-    FPDF_DOCUMENT pdfDocument;
-    size_t fileSize;
-    void setFile(int fd, void *buffer, size_t fileLength){
-        fileFd = fd;
-        fileSize = fileLength;
-        fileMappedBuffer = buffer;
-        LOGD("File Size: %d", (int)fileSize);
-    }
-    void* getFileMap() { return fileMappedBuffer; }
-
-    DocumentFile() :  pdfDocument(NULL),
-                      fileMappedBuffer(NULL) { initLibraryIfNeed(); }
-    ~DocumentFile();
-};
-DocumentFile::~DocumentFile(){
-    if(pdfDocument != NULL){
-        FPDF_CloseDocument(pdfDocument);
-    }
+    FileIdentity identity;
+    if(!getFileIdentity((int)fd, &identity)) return -1;
+    size_t fileLength = (size_t)identity.size;
+    if(fileLength <= 0) return -1;
+    OpenMode openMode = (mode == OPEN_MODE_STREAM)? OPEN_MODE_STREAM : OPEN_MODE_MMAP;
 
-    if(fileMappedBuffer != NULL){
-        munmap(fileMappedBuffer, fileSize);
-        //Leave the file closing work to Java
-        //close(fileFd);
+    DocumentFile *docFile;
+    if( (docFile = takeCachedDocument(identity, openMode)) != NULL ){
+        LOGD("Reopen cached document");
+        return reinterpret_cast<jlong>(docFile);
     }
 
-    destroyLibraryIfNeed();
-}
+    docFile = new DocumentFile();
+    docFile->hasIdentity = true;
+    docFile->identity = identity;
+    docFile->fingerprint = getDocumentFingerprint((int)fd, identity.size);
+    docFile->openMode = openMode;
+    docFile->hasSource = true;
+    docFile->source = identity;
+
+    try{
+        if(openMode == OPEN_MODE_STREAM){
+            loadStreamingDocument(docFile, (int)fd, fileLength);
+        }else{
+            loadMappedDocument(docFile, (int)fd, fileLength);
+        }
 
-inline long getFileSize(int fd){
-    struct stat file_state;
+        return reinterpret_cast<jlong>(docFile);
 
-    if(fstat(fd, &file_state) >= 0){
-        return (long)(file_state.st_size);
-    }else{
-        LOGE("Error getting file size");
-        return 0;
+    }catch(const char* msg){
+        delete docFile;
+        LOGE("%s", msg);
+        LOGE("Last Error: %ld", FPDF_GetLastError());
+
+        return -1;
     }
 }
 
-extern "C" { //For JNI support
+static void throwIllegalArgument(JNIEnv *env, const char *message){
+    jclass exceptionClass = env -> FindClass("java/lang/IllegalArgumentException");
+    if(exceptionClass != NULL) env -> ThrowNew(exceptionClass, message);
+}
 
-JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd){
+/*
+ * Opens length bytes at offset of a direct buffer in place. A non-direct buffer or a
+ * slice outside its capacity throws IllegalArgumentException, pdfium would read past it.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeOpenMemDocument)(JNI_ARGS, jobject buffer, jint offset, jint length){
+    unsigned char *address = reinterpret_cast<unsigned char*>(env -> GetDirectBufferAddress(buffer));
+    if(address == NULL){
+        throwIllegalArgument(env, "Buffer is not a direct buffer");
+        return -1;
+    }
+    jlong capacity = env -> GetDirectBufferCapacity(buffer);
+    if(offset < 0 || length <= 0 || (jlong)offset + (jlong)length > capacity){
+        LOGE("Buffer slice %d+%d outside its capacity %lld", (int)offset, (int)length, (long long)capacity);
+        throwIllegalArgument(env, "Buffer slice is empty or outside the buffer");
+        return -1;
+    }
+
+    DocumentFile *docFile = new DocumentFile();
+    docFile->setExternalBuffer(address + offset, (size_t)length);
+
+    if( (docFile->pdfDocument = FPDF_LoadMemDocument( address + offset, (int)length, NULL)) == NULL ){
+        LOGE("Error loading document from buffer, Last Error: %ld", FPDF_GetLastError());
+        delete docFile;
+        return -1;
+    }
+
+    return reinterpret_cast<jlong>(docFile);
+}
 
-    size_t fileLength = (size_t)getFileSize(fd);
+JNI_FUNC(jlong, PdfiumCore, nativeOpenPartialDocument)(JNI_ARGS, jint fd, jlong fileLength){
     if(fileLength <= 0) return -1;
 
     DocumentFile *docFile = new DocumentFile();
+    docFile->hasSource = getFileIdentity((int)fd, &docFile->source);
 
     try{
-        void *map;
-        if( (map = mmap( docFile->getFileMap(), fileLength, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0 )) == NULL){
-            throw "Error mapping file";
-        }
-        docFile->setFile(fd, map, fileLength);
+        BlockFileReader *reader = new BlockFileReader((int)fd, (size_t)fileLength);
+        docFile->setFileReader((int)fd, reader, (size_t)fileLength);
+        if(!reader->isValid()) throw "Error opening file for streaming";
 
-        if( (docFile->pdfDocument = FPDF_LoadMemDocument( reinterpret_cast<const void*>(docFile->getFileMap()),
-                                                          (int)docFile->fileSize, NULL)) == NULL) {
-            throw "Error loading document from file map";
+        docFile->availTracker = new AvailabilityTracker();
+        reader->setAvailability(docFile->availTracker);
+        if( (docFile->availProvider = FPDFAvail_Create(docFile->availTracker->getFileAvail(),
+                                                       reader->getFileAccess())) == NULL ){
+            throw "Error creating availability provider";
         }
 
         return reinterpret_cast<jlong>(docFile);
@@ -108,88 +159,419 @@ JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd){
     }catch(const char* msg){
         delete docFile;
         LOGE("%s", msg);
-        LOGE("Last Error: %ld", FPDF_GetLastError());
 
         return -1;
     }
 }
 
+JNI_FUNC(void, PdfiumCore, nativeAddAvailableRange)(JNI_ARGS, jlong docPtr, jlong offset, jlong length){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc == NULL || doc->availTracker == NULL || offset < 0 || length <= 0) return;
+    doc->availTracker->addRange((size_t)offset, (size_t)length);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeIsDocumentAvailable)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->pdfDocument != NULL) return JNI_TRUE;
+    if(doc->availProvider == NULL) return JNI_FALSE;
+
+    if(!FPDFAvail_IsDocAvail(doc->availProvider, doc->availTracker->getDownloadHints())){
+        return JNI_FALSE;
+    }
+    if( (doc->pdfDocument = FPDFAvail_GetDocument(doc->availProvider, NULL)) == NULL ){
+        LOGE("Error loading partial document, Last Error: %ld", FPDF_GetLastError());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeIsPageAvailable)(JNI_ARGS, jlong docPtr, jint pageIndex){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->pdfDocument == NULL) return JNI_FALSE;
+    if(doc->availProvider == NULL) return JNI_TRUE;
+
+    return FPDFAvail_IsPageAvail(doc->availProvider, (int)pageIndex,
+                                 doc->availTracker->getDownloadHints())? JNI_TRUE : JNI_FALSE;
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeGetFirstAvailablePage)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->pdfDocument == NULL) return -1;
+    return (jint)FPDFAvail_GetFirstPageNum(doc->pdfDocument);
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetDownloadHints)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->availTracker == NULL) return NULL;
+
+    std::vector<size_t> hints = doc->availTracker->takeHints();
+    jsize length = (jsize)hints.size();
+    jlongArray javaHints = env -> NewLongArray(length);
+    if(javaHints == NULL || length == 0) return javaHints;
+
+    std::vector<jlong> values(hints.begin(), hints.end());
+    env -> SetLongArrayRegion(javaHints, 0, length, &values[0]);
+
+    return javaHints;
+}
+
 JNI_FUNC(jint, PdfiumCore, nativeGetPageCount)(JNI_ARGS, jlong documentPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(documentPtr);
+    if(doc->pdfDocument == NULL) return 0;
     return (jint)FPDF_GetPageCount(doc->pdfDocument);
 }
 
 JNI_FUNC(void, PdfiumCore, nativeCloseDocument)(JNI_ARGS, jlong documentPtr){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(documentPtr);
+    if(doc == NULL || cacheClosedDocument(doc)) return;
     delete doc;
 }
 
-static jlong loadPageInternal(DocumentFile *doc, int pageIndex){
-    try{
-        if(doc == NULL) throw "Get page document null";
+JNI_FUNC(void, PdfiumCore, nativeSetDocumentCacheCapacity)(JNI_ARGS, jint capacity){
+    setDocumentCacheCapacity((capacity > 0)? (size_t)capacity : 0);
+}
 
-        FPDF_DOCUMENT pdfDoc = doc->pdfDocument;
-        if(pdfDoc != NULL){
-            return reinterpret_cast<jlong>( FPDF_LoadPage(pdfDoc, pageIndex) );
-        }else{
-            throw "Get page pdf document null";
-        }
+static jlong releasedHeapBytes(size_t heapBefore){
+    size_t heapAfter = getAllocatedHeapBytes();
+    return (heapBefore > heapAfter)? (jlong)(heapBefore - heapAfter) : 0;
+}
 
-    }catch(const char *msg){
-        LOGE("%s", msg);
-        return -1;
+/*
+ * Shrinks every cache of one document to keepPercent of its budget.
+ * Pinned pages are left alone. Returns the heap bytes given back.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeTrimDocument)(JNI_ARGS, jlong docPtr, jint keepPercent){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    size_t heapBefore = getAllocatedHeapBytes();
+
+    int cacheClass;
+    for(cacheClass = 0; cacheClass < CACHE_CLASS_COUNT; cacheClass++){
+        if(cacheClass == CACHE_SCRATCH_BUFFERS || cacheClass == CACHE_CLOSED_DOCUMENTS) continue;
+        doc->trimCache((CacheClass)cacheClass, (int)keepPercent);
     }
+
+    return releasedHeapBytes(heapBefore);
 }
-static void closePageInternal(jlong pagePtr) { FPDF_ClosePage(reinterpret_cast<FPDF_PAGE>(pagePtr)); }
 
-JNI_FUNC(jlong, PdfiumCore, nativeLoadPage)(JNI_ARGS, jlong docPtr, jint pageIndex){
+/*
+ * Shrinks the caches not owned by any open document: closed documents kept for
+ * reopening and idle scratch buffers. Returns the heap bytes given back.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeTrimSharedCaches)(JNI_ARGS, jint keepPercent){
+    size_t heapBefore = getAllocatedHeapBytes();
+    trimAllDocuments(CACHE_SCRATCH_BUFFERS, (int)keepPercent);
+    trimAllDocuments(CACHE_CLOSED_DOCUMENTS, (int)keepPercent);
+    return releasedHeapBytes(heapBefore);
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeGetOOMCount)(JNI_ARGS){
+    return (jint)getOOMCount();
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeTrimDocumentCache)(JNI_ARGS, jint keepCount){
+    return (jint)trimDocumentCache((keepCount > 0)? (size_t)keepCount : 0);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeLoadPage)(JNI_ARGS, jlong docPtr, jint pageIndex){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
-    return loadPageInternal(doc, (int)pageIndex);
+    PagePin page(doc, (int)pageIndex);
+    return (page.get() != NULL)? JNI_TRUE : JNI_FALSE;
 }
-JNI_FUNC(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint fromIndex, jint toIndex){
+JNI_FUNC(jint, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint fromIndex, jint toIndex){
     DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
 
-    if(toIndex < fromIndex) return NULL;
-    jlong pages[ toIndex - fromIndex + 1 ];
-
+    int loaded = 0;
     int i;
-    for(i = 0; i <= (toIndex - fromIndex); i++){
-        pages[i] = loadPageInternal(doc, (int)(i + fromIndex));
+    for(i = fromIndex; i <= toIndex; i++){
+        PagePin page(doc, i);
+        if(page.get() != NULL) loaded++;
+    }
+    return (jint)loaded;
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeHasPage)(JNI_ARGS, jlong docPtr, jint pageIndex){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    return doc->pageCache.contains((int)pageIndex)? JNI_TRUE : JNI_FALSE;
+}
+JNI_FUNC(void, PdfiumCore, nativeClosePage)(JNI_ARGS, jlong docPtr, jint pageIndex){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    doc->pageCache.close((int)pageIndex);
+}
+JNI_FUNC(void, PdfiumCore, nativeSetPageCacheSize)(JNI_ARGS, jlong docPtr, jint maxPages){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    doc->pageCache.setMaxPages((maxPages > 0)? (size_t)maxPages : 0);
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeGetPageWidthPixel)(JNI_ARGS, jlong docPtr, jint pageIndex, jint dpi){
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL) return 0;
+    return (jint)(FPDF_GetPageWidth(page.get()) * dpi / 72);
+}
+JNI_FUNC(jint, PdfiumCore, nativeGetPageHeightPixel)(JNI_ARGS, jlong docPtr, jint pageIndex, jint dpi){
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL) return 0;
+    return (jint)(FPDF_GetPageHeight(page.get()) * dpi / 72);
+}
+
+/*
+ * Saves through a BufferedFileWriter into fd.
+ * An incremental save into the file the document was opened from only appends
+ * the update section: pdfium starts the output with the original bytes, which
+ * are already there, so the writer skips them.
+ */
+JNI_FUNC(jboolean, PdfiumCore, nativeSaveDocument)(JNI_ARGS, jlong docPtr, jint fd,
+                                                   jboolean incremental, jlong syncInterval){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc == NULL || doc->pdfDocument == NULL) return JNI_FALSE;
+
+    FileIdentity target;
+    if(!getFileIdentity((int)fd, &target)) return JNI_FALSE;
+
+    size_t skipBytes = 0;
+    bool intoSource = doc->hasSource && target.isSameFile(doc->source);
+    if(intoSource){
+        //pdfium may still read from the source, so it can only be appended to, and only if unchanged
+        if(!incremental || target.size != doc->source.size || target.modifiedTime != doc->source.modifiedTime){
+            LOGE("Refusing to overwrite the file the document is read from");
+            return JNI_FALSE;
+        }
+        skipBytes = doc->fileSize;
     }
 
-    jlongArray javaPages = env -> NewLongArray( (jsize)(toIndex - fromIndex + 1) );
-    env -> SetLongArrayRegion(javaPages, 0, (jsize)(toIndex - fromIndex + 1), (const jlong*)pages);
+    BufferedFileWriter writer((int)fd, skipBytes, (long)syncInterval);
+    FPDF_BOOL saved = FPDF_SaveAsCopy(doc->pdfDocument, writer.getFileWrite(),
+                                      incremental? FPDF_INCREMENTAL : FPDF_NO_INCREMENTAL);
+    if(!saved || !writer.finish()){
+        LOGE("Save document failed, Last Error: %ld", FPDF_GetLastError());
+        return JNI_FALSE;
+    }
+    LOGD("Saved document, %d bytes written", (int)writer.getBytesWritten());
+    doc->modified = true;
 
-    return javaPages;
+    //The original bytes pdfium reads are untouched, the file just grew by the update.
+    //Later saves append again from doc->fileSize, replacing this update.
+    if(intoSource && getFileIdentity((int)fd, &target)){
+        doc->source.size = target.size;
+        doc->source.modifiedTime = target.modifiedTime;
+        if(doc->hasIdentity && doc->identity.isSameFile(target)){
+            doc->identity.size = target.size;
+            doc->identity.modifiedTime = target.modifiedTime;
+            doc->fingerprint = getDocumentFingerprint((int)fd, target.size);
+        }
+    }
+    return JNI_TRUE;
 }
 
-JNI_FUNC(void, PdfiumCore, nativeClosePage)(JNI_ARGS, jlong pagePtr){ closePageInternal(pagePtr); }
-JNI_FUNC(void, PdfiumCore, nativeClosePages)(JNI_ARGS, jlongArray pagesPtr){
-    int length = (int)(env -> GetArrayLength(pagesPtr));
-    jlong *pages = env -> GetLongArrayElements(pagesPtr, NULL);
+/*
+ * Sizes of every page without FPDF_LoadPage, packed as [w0, h0, w1, h1, ...] in pixels.
+ * FPDF_GetPageSizeByIndex only reads the page dictionary, and the size it reports
+ * is already the effective one: crop box (media box if absent) with /Rotate applied.
+ */
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetPageSizes)(JNI_ARGS, jlong docPtr, jint dpi){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc == NULL || doc->pdfDocument == NULL) return NULL;
+
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    if(pageCount < 0) return NULL;
 
+    jfloat *sizes = new jfloat[pageCount * 2 + 1];
+    double width, height;
     int i;
-    for(i = 0; i < length; i++){ closePageInternal(pages[i]); }
+    for(i = 0; i < pageCount; i++){
+        if(!FPDF_GetPageSizeByIndex(doc->pdfDocument, i, &width, &height)){
+            width = height = 0;
+        }
+        sizes[i * 2] = (jfloat)(width * dpi / 72);
+        sizes[i * 2 + 1] = (jfloat)(height * dpi / 72);
+    }
+
+    jfloatArray javaSizes = env -> NewFloatArray( (jsize)(pageCount * 2) );
+    if(javaSizes != NULL){
+        env -> SetFloatArrayRegion(javaSizes, 0, (jsize)(pageCount * 2), sizes);
+    }
+    delete[] sizes;
+
+    return javaSizes;
 }
 
-JNI_FUNC(jint, PdfiumCore, nativeGetPageWidthPixel)(JNI_ARGS, jlong pagePtr, jint dpi){
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
-    return (jint)(FPDF_GetPageWidth(page) * dpi / 72);
+static Mutex sMetadataCacheLock;
+static MetadataCache *sMetadataCache = NULL;
+
+JNI_FUNC(void, PdfiumCore, nativeInitMetadataCache)(JNI_ARGS, jstring filePath, jint maxBytes){
+    const char *path = env -> GetStringUTFChars(filePath, NULL);
+    if(path == NULL) return;
+
+    Mutex::Autolock lock(sMetadataCacheLock);
+    if(sMetadataCache != NULL && sMetadataCache->getFilePath() == path){
+        sMetadataCache->setMaxTotalSize((size_t)maxBytes);
+    }else{
+        delete sMetadataCache;
+        sMetadataCache = new MetadataCache(path, (size_t)maxBytes);
+        sMetadataCache->load();
+    }
+
+    env -> ReleaseStringUTFChars(filePath, path);
 }
-JNI_FUNC(jint, PdfiumCore, nativeGetPageHeightPixel)(JNI_ARGS, jlong pagePtr, jint dpi){
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
-    return (jint)(FPDF_GetPageHeight(page) * dpi / 72);
+
+/*
+ * PdfDocument.Lock taken from native code, for background jobs that hold it
+ * piecewise. With a scheduler every hold is a job of jobClass, see jobScheduler.hpp.
+ */
+class JavaDocumentLock {
+    public:
+    JavaDocumentLock(JNIEnv *env, jobject document, jlong docPtr,
+                     JobScheduler *scheduler, JobClass jobClass) :
+            env(env), document(document), docPtr(docPtr),
+            scheduler(scheduler), jobClass(jobClass), job(NULL) {
+        jclass documentClass = env->GetObjectClass(document);
+        docPtrField = env->GetFieldID(documentClass, "mNativeDocPtr", "J");
+        docLock = env->GetObjectField(document, env->GetFieldID(documentClass, "Lock", "Ljava/lang/Object;"));
+        env->DeleteLocalRef(documentClass);
+    }
+
+    //False if the document was closed meanwhile, the lock isn't held then
+    bool lock(){
+        if(scheduler != NULL) job = scheduler->enter(jobClass);
+        env->MonitorEnter(docLock);
+        //closeDocument() zeroes the pointer under the same lock
+        if(env->GetLongField(document, docPtrField) != docPtr){
+            unlock();
+            return false;
+        }
+        if(job != NULL) scheduler->begin(job);
+        return true;
+    }
+    //True if more urgent work preempted a render done under the lock
+    bool unlock(){
+        env->MonitorExit(docLock);
+        if(job == NULL) return false;
+        bool preempted = scheduler->leave(job);
+        job = NULL;
+        return preempted;
+    }
+
+    private:
+    JNIEnv *env;
+    jobject document;
+    jlong docPtr;
+    jfieldID docPtrField;
+    jobject docLock;
+    JobScheduler *scheduler;
+    JobClass jobClass;
+    JobScheduler::Job *job;
+};
+
+/*
+ * Appends the record of one page: width, height (points), rotation, char count,
+ * link count, then left, top, right, bottom of every link (page coordinates).
+ */
+static void collectPageMetadata(FPDF_PAGE page, int pageIndex, std::vector<float> *out){
+    if(page == NULL){
+        LOGE("Load page %d for metadata failed", pageIndex);
+        out->insert(out->end(), 5, 0.0f);
+        return;
+    }
+
+    out->push_back((float)FPDF_GetPageWidth(page));
+    out->push_back((float)FPDF_GetPageHeight(page));
+    out->push_back((float)FPDFPage_GetRotation(page));
+
+    FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+    if(textPage != NULL){
+        out->push_back((float)FPDFText_CountChars(textPage));
+        FPDFText_ClosePage(textPage);
+    }else{
+        out->push_back(0.0f);
+    }
+
+    size_t linkCountIndex = out->size();
+    out->push_back(0.0f);
+
+    int startPos = 0;
+    int linkCount = 0;
+    FPDF_LINK link;
+    FS_RECTF rect;
+    while(FPDFLink_Enumerate(page, &startPos, &link)){
+        if(!FPDFLink_GetAnnotRect(link, &rect)) continue;
+        out->push_back(rect.left);
+        out->push_back(rect.top);
+        out->push_back(rect.right);
+        out->push_back(rect.bottom);
+        linkCount++;
+    }
+    (*out)[linkCountIndex] = (float)linkCount;
 }
 
-static void renderPageInternal( FPDF_PAGE page,
-                                ANativeWindow_Buffer *windowBuffer,
-                                int startX, int startY,
-                                int canvasHorSize, int canvasVerSize,
-                                int drawSizeHor, int drawSizeVer){
+/*
+ * Layout data of the whole document: page count followed by one record per page.
+ * Served from the sidecar when the file is known, otherwise every page is loaded
+ * once and the result stored for the next time. PdfDocument.Lock is held per page,
+ * each hold a JOB_INDEXING job, so renders get in between; pages go through the
+ * page cache and its OOM retry. NULL if the document got closed meanwhile.
+ */
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetDocumentMetadata)(JNI_ARGS, jlong docPtr, jobject document,
+                                                             jlong schedulerPtr){
+    if(docPtr <= 0) return NULL;
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    JavaDocumentLock docLock(env, document, docPtr, reinterpret_cast<JobScheduler*>(schedulerPtr), JOB_INDEXING);
+
+    if(!docLock.lock()) return NULL;
+    if(doc->pdfDocument == NULL){
+        docLock.unlock();
+        return NULL;
+    }
+    //A save may change them while the lock is let go
+    bool hasIdentity = doc->hasIdentity;
+    FileIdentity identity = doc->identity;
+    uint64_t fingerprint = doc->fingerprint;
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    docLock.unlock();
+
+    std::vector<float> metadata;
+    bool cached = false;
+    if(hasIdentity){
+        Mutex::Autolock lock(sMetadataCacheLock);
+        cached = (sMetadataCache != NULL && sMetadataCache->get(identity, fingerprint, &metadata));
+    }
+
+    if(!cached){
+        metadata.push_back((float)pageCount);
+        int i;
+        for(i = 0; i < pageCount; i++){
+            if(!docLock.lock()) return NULL;
+            //Don't push the pages on screen out of the cache
+            bool wasLoaded = doc->pageCache.contains(i);
+            {
+                PagePin page(doc, i);
+                collectPageMetadata(page.get(), i, &metadata);
+            }
+            if(!wasLoaded) doc->pageCache.close(i);
+            docLock.unlock();
+        }
+
+        if(hasIdentity){
+            Mutex::Autolock lock(sMetadataCacheLock);
+            if(sMetadataCache != NULL){
+                sMetadataCache->put(identity, fingerprint, metadata);
+                sMetadataCache->save();
+            }
+        }
+    }
+
+    jfloatArray javaMetadata = env -> NewFloatArray( (jsize)metadata.size() );
+    if(javaMetadata != NULL){
+        env -> SetFloatArrayRegion(javaMetadata, 0, (jsize)metadata.size(), &metadata[0]);
+    }
+    return javaMetadata;
+}
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
-                                                 FPDFBitmap_BGRA,
-                                                 windowBuffer->bits, (int)(windowBuffer->stride) * 4);
+static RenderStatus renderPageInternal( FPDF_PAGE page,
+                                        ANativeWindow_Buffer *windowBuffer,
+                                        PixelFormat format,
+                                        int startX, int startY,
+                                        int canvasHorSize, int canvasVerSize,
+                                        int drawSizeHor, int drawSizeVer,
+                                        int draftScale, CancelToken *token){
 
     LOGD("Start X: %d", startX);
     LOGD("Start Y: %d", startY);
@@ -198,61 +580,857 @@ static void renderPageInternal( FPDF_PAGE page,
     LOGD("Draw Hor: %d", drawSizeHor);
     LOGD("Draw Ver: %d", drawSizeVer);
 
-    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
-        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
-                             0x84, 0x84, 0x84, 255); //Gray
+    int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+    return renderPageDraft( page, windowBuffer->bits,
+                            canvasHorSize, canvasVerSize, (int)(windowBuffer->stride) * bytesPerPixel,
+                            format,
+                            startX, startY, drawSizeHor, drawSizeVer, draftScale, token );
+}
+
+/*
+ * Locks the surface's window for drawing in the given WINDOW_FORMAT_*, NULL on failure.
+ * Also fails if the buffer still comes in another format, which the caller's pixels
+ * would overrun; that buffer is posted unchanged.
+ */
+static ANativeWindow* lockWindow(JNIEnv *env, jobject objSurface, ANativeWindow_Buffer *buffer,
+                                 int32_t windowFormat = WINDOW_FORMAT_RGBA_8888){
+    ANativeWindow *nativeWindow = ANativeWindow_fromSurface(env, objSurface);
+    if(nativeWindow == NULL){
+        LOGE("native window pointer null");
+        return NULL;
     }
 
-    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : drawSizeVer;
-    int baseX = (startX < 0)? 0 : startX;
-    int baseY = (startY < 0)? 0 : startY;
-    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
-                         255, 255, 255, 255); //White
+    if(ANativeWindow_getFormat(nativeWindow) != windowFormat){
+        LOGD("Set format to %d", (int)windowFormat);
+        ANativeWindow_setBuffersGeometry( nativeWindow,
+                                          ANativeWindow_getWidth(nativeWindow),
+                                          ANativeWindow_getHeight(nativeWindow),
+                                          windowFormat );
+    }
 
-    FPDF_RenderPageBitmap( pdfBitmap, page,
-                           startX, startY,
-                           drawSizeHor, drawSizeVer,
-                           0, FPDF_REVERSE_BYTE_ORDER );
+    int ret;
+    if( (ret = ANativeWindow_lock(nativeWindow, buffer, NULL)) != 0 ){
+        LOGE("Locking native window failed: %s", strerror(ret * -1));
+        ANativeWindow_release(nativeWindow);
+        return NULL;
+    }
+    if(buffer->format != windowFormat){
+        LOGE("Window format %d doesn't match the render format %d", (int)buffer->format, (int)windowFormat);
+        ANativeWindow_unlockAndPost(nativeWindow);
+        ANativeWindow_release(nativeWindow);
+        return NULL;
+    }
+    return nativeWindow;
 }
 
-JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject objSurface,
-                                             jint dpi, jint startX, jint startY,
-                                             jint drawSizeHor, jint drawSizeVer){
+/*
+ * Renders into memory and only touches the window once the picture is complete,
+ * so a cancel leaves the frame on screen as it was.
+ */
+static RenderStatus renderPageOffscreen(JNIEnv *env, FPDF_PAGE page, int pageIndex, jobject objSurface,
+                                        PixelFormat format, int32_t windowFormat,
+                                        int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                        PinchPreview *preview, CancelToken *token){
     ANativeWindow *nativeWindow = ANativeWindow_fromSurface(env, objSurface);
     if(nativeWindow == NULL){
         LOGE("native window pointer null");
-        return;
+        return RENDER_FAILED;
+    }
+    int width = ANativeWindow_getWidth(nativeWindow);
+    int height = ANativeWindow_getHeight(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+
+    int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+    ScratchBuffer picture(width * height * bytesPerPixel);
+    if(picture.get() == NULL) return RENDER_FAILED;
+    RenderStatus status = renderPageToBuffer( page, picture.get(), width, height, width * bytesPerPixel, format,
+                                              startX, startY, drawSizeHor, drawSizeVer, token );
+    if(status != RENDER_DONE) return status;
+    if(preview != NULL){
+        preview->capture( pageIndex, picture.get(), width, height, width * bytesPerPixel, format,
+                          startX, startY, drawSizeHor, drawSizeVer );
     }
-    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
 
-    if(page == NULL || nativeWindow == NULL){
+    ANativeWindow_Buffer buffer;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer, windowFormat)) == NULL ) return RENDER_FAILED;
+    if(buffer.width == width && buffer.height == height){
+        int i;
+        for(i = 0; i < height; i++){
+            memcpy( reinterpret_cast<unsigned char*>(buffer.bits) + i * buffer.stride * bytesPerPixel,
+                    reinterpret_cast<unsigned char*>(picture.get()) + i * width * bytesPerPixel,
+                    width * bytesPerPixel );
+        }
+    }else{
+        //Resized meanwhile, the next frame's render takes care of it
+        status = RENDER_FAILED;
+    }
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return status;
+}
+
+/*
+ * pixelFormat is a PixelFormat, the window is switched to RGBA_8888 or RGB_565 to match.
+ * draftScale above 1 renders a draft at that fraction of the resolution, see renderPageDraft.
+ * tokenPtr is a CancelToken or 0. A cancelled render still posts the window,
+ * since it can't be unlocked without, so the picture may be incomplete;
+ * offscreen renders avoid that at the cost of a copy.
+ * previewPtr is a PinchPreview or 0, it keeps a copy of each complete full resolution frame.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong docPtr, jint pageIndex, jobject objSurface,
+                                             jint dpi, jint startX, jint startY,
+                                             jint drawSizeHor, jint drawSizeVer,
+                                             jint pixelFormat, jint draftScale, jboolean offscreen,
+                                             jlong previewPtr, jlong tokenPtr){
+    //Pinned so the page cache can't close it while rendering
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL){
         LOGE("Render page pointers invalid");
-        return;
+        return RENDER_FAILED;
     }
 
-    if(ANativeWindow_getFormat(nativeWindow) != WINDOW_FORMAT_RGBA_8888){
-        LOGD("Set format to RGBA_8888");
-        ANativeWindow_setBuffersGeometry( nativeWindow,
-                                          ANativeWindow_getWidth(nativeWindow),
-                                          ANativeWindow_getHeight(nativeWindow),
-                                          WINDOW_FORMAT_RGBA_8888 );
+    PixelFormat format = (PixelFormat)pixelFormat;
+    int32_t windowFormat = (format == PIXEL_FORMAT_RGBA_8888)? WINDOW_FORMAT_RGBA_8888 : WINDOW_FORMAT_RGB_565;
+    if(offscreen){
+        return (jint)renderPageOffscreen( env, page.get(), (int)pageIndex, objSurface, format, windowFormat,
+                                          (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                                          (draftScale > 1)? NULL : reinterpret_cast<PinchPreview*>(previewPtr),
+                                          reinterpret_cast<CancelToken*>(tokenPtr) );
     }
 
     ANativeWindow_Buffer buffer;
-    int ret;
-    if( (ret = ANativeWindow_lock(nativeWindow, &buffer, NULL)) != 0 ){
-        LOGE("Locking native window failed: %s", strerror(ret * -1));
-        return;
+    ANativeWindow *nativeWindow;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer, windowFormat)) == NULL ) return RENDER_FAILED;
+
+    RenderStatus status = renderPageInternal(page.get(), &buffer, format,
+                                             (int)startX, (int)startY,
+                                             buffer.width, buffer.height,
+                                             (int)drawSizeHor, (int)drawSizeVer,
+                                             (int)draftScale, reinterpret_cast<CancelToken*>(tokenPtr));
+
+    //Drafts would only blur the pinch steps further
+    PinchPreview *preview = reinterpret_cast<PinchPreview*>(previewPtr);
+    if(preview != NULL && status == RENDER_DONE && draftScale <= 1){
+        int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+        preview->capture( (int)pageIndex, buffer.bits, buffer.width, buffer.height, buffer.stride * bytesPerPixel,
+                          format, (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer );
     }
 
-    renderPageInternal(page, &buffer,
-                       (int)startX, (int)startY,
-                       buffer.width, buffer.height,
-                       (int)drawSizeHor, (int)drawSizeVer);
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return (jint)status;
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeNewPinchPreview)(JNI_ARGS){
+    return reinterpret_cast<jlong>(new PinchPreview());
+}
+JNI_FUNC(void, PdfiumCore, nativeRetainPinchPreview)(JNI_ARGS, jlong previewPtr){
+    reinterpret_cast<PinchPreview*>(previewPtr)->acquire();
+}
+JNI_FUNC(void, PdfiumCore, nativeReleasePinchPreview)(JNI_ARGS, jlong previewPtr){
+    reinterpret_cast<PinchPreview*>(previewPtr)->release();
+}
+
+/*
+ * A pinch step drawn from the PinchPreview's kept frame, without pdfium or the
+ * document. RENDER_FAILED, leaving the surface alone, if the frame is of
+ * another page or its zoom is more than maxDrift away; the caller renders then.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderPinchFrame)(JNI_ARGS, jlong previewPtr, jint pageIndex, jobject objSurface,
+                                                   jint startX, jint startY,
+                                                   jint drawSizeHor, jint drawSizeVer,
+                                                   jint pixelFormat, jfloat maxDrift){
+    PinchPreview *preview = reinterpret_cast<PinchPreview*>(previewPtr);
+    if(!preview->canDraw((int)pageIndex, (int)drawSizeHor, (int)drawSizeVer, (float)maxDrift)) return RENDER_FAILED;
+
+    PixelFormat format = (PixelFormat)pixelFormat;
+    int32_t windowFormat = (format == PIXEL_FORMAT_RGBA_8888)? WINDOW_FORMAT_RGBA_8888 : WINDOW_FORMAT_RGB_565;
+    ANativeWindow_Buffer buffer;
+    ANativeWindow *nativeWindow;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer, windowFormat)) == NULL ) return RENDER_FAILED;
 
+    int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+    //May still fail if a render replaced the frame meanwhile, the window then shows its last frame again
+    bool drawn = preview->draw( (int)pageIndex, buffer.bits, buffer.width, buffer.height,
+                                buffer.stride * bytesPerPixel, format,
+                                (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer, (float)maxDrift );
     ANativeWindow_unlockAndPost(nativeWindow);
     ANativeWindow_release(nativeWindow);
+    return drawn? RENDER_DONE : RENDER_FAILED;
+}
+
+/*
+ * Renders straight into the pixels of an android.graphics.Bitmap,
+ * ARGB_8888 and RGB_565 are supported; dither only applies to the latter.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jint pageIndex, jobject bitmap,
+                                                   jint startX, jint startY,
+                                                   jint drawSizeHor, jint drawSizeVer,
+                                                   jboolean dither, jint draftScale, jlong tokenPtr){
+    AndroidBitmapInfo info;
+    if(AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS){
+        LOGE("Getting bitmap info failed");
+        return RENDER_FAILED;
+    }
+
+    PixelFormat format;
+    switch(info.format){
+        case ANDROID_BITMAP_FORMAT_RGBA_8888: format = PIXEL_FORMAT_RGBA_8888; break;
+        case ANDROID_BITMAP_FORMAT_RGB_565:
+            format = dither? PIXEL_FORMAT_RGB_565_DITHERED : PIXEL_FORMAT_RGB_565;
+            break;
+        default:
+            LOGE("Unsupported bitmap format %d", (int)info.format);
+            return RENDER_FAILED;
+    }
+
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL){
+        LOGE("Render page pointers invalid");
+        return RENDER_FAILED;
+    }
+
+    void *pixels;
+    if(AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS){
+        LOGE("Locking bitmap pixels failed");
+        return RENDER_FAILED;
+    }
+
+    RenderStatus status = renderPageDraft( page.get(), pixels,
+                                           (int)info.width, (int)info.height, (int)info.stride, format,
+                                           (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                                           (int)draftScale, reinterpret_cast<CancelToken*>(tokenPtr) );
+
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return (jint)status;
+}
+
+/*
+ * Grayscale render into a direct ByteBuffer, 8 bits per pixel or packed to
+ * 1, 2 or 4 with the given DitherMode. stride is in bytes.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderPageGray)(JNI_ARGS, jlong docPtr, jint pageIndex, jobject buffer,
+                                                 jint width, jint height, jint stride,
+                                                 jint bitsPerPixel, jint ditherMode,
+                                                 jint startX, jint startY,
+                                                 jint drawSizeHor, jint drawSizeVer,
+                                                 jlong tokenPtr){
+    void *pixels = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(pixels == NULL || width <= 0 || height <= 0 ||
+       (jlong)stride * height > capacity || (jlong)stride * 8 < (jlong)width * bitsPerPixel){
+        LOGE("Gray render buffer invalid");
+        return RENDER_FAILED;
+    }
+
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL){
+        LOGE("Render page pointers invalid");
+        return RENDER_FAILED;
+    }
+
+    return (jint)renderPageToGray( page.get(), pixels, (int)width, (int)height, (int)stride,
+                                   (int)bitsPerPixel, (DitherMode)ditherMode,
+                                   (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                                   reinterpret_cast<CancelToken*>(tokenPtr) );
+}
+
+//Locks PdfDocument.Lock per page and reports progress to a ThumbnailAtlas.Listener
+class JavaAtlasCallbacks : public AtlasCallbacks {
+    public:
+    JavaAtlasCallbacks(JNIEnv *env, jobject document, jlong docPtr,
+                       JobScheduler *scheduler, jobject listener) :
+            env(env), docLock(env, document, docPtr, scheduler, JOB_THUMBNAIL),
+            listener(listener), onProgressMethod(NULL) {
+        if(listener != NULL){
+            jclass listenerClass = env->GetObjectClass(listener);
+            onProgressMethod = env->GetMethodID(listenerClass, "onProgress", "(III)V");
+            env->DeleteLocalRef(listenerClass);
+        }
+    }
+
+    bool lockDocument(){ return docLock.lock(); }
+    bool unlockDocument(){ return docLock.unlock(); }
+    void onProgress(int pageIndex, int done, int total){
+        if(onProgressMethod == NULL) return;
+        env->CallVoidMethod(listener, onProgressMethod, (jint)pageIndex, (jint)done, (jint)total);
+        if(env->ExceptionCheck()){
+            //Don't leave a pending exception behind for the next JNI call
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+    }
+
+    private:
+    JNIEnv *env;
+    JavaDocumentLock docLock;
+    jobject listener;
+    jmethodID onProgressMethod;
+};
+
+/*
+ * Renders a range of pages into a thumbnail atlas file, see thumbnailAtlas.hpp.
+ * Meant to run on a background thread: PdfDocument.Lock is only held per page,
+ * and the batch stops if the document gets closed in between.
+ * Returns the number of pages rendered, -1 on failure or cancel.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderThumbnailAtlas)(JNI_ARGS, jlong docPtr, jobject document,
+                                                       jint fromIndex, jint toIndex,
+                                                       jint targetWidth, jboolean rgb565, jint fd,
+                                                       jlong tokenPtr, jlong schedulerPtr, jobject listener){
+    JavaAtlasCallbacks callbacks(env, document, docPtr,
+                                 reinterpret_cast<JobScheduler*>(schedulerPtr), listener);
+    return (jint)renderThumbnailAtlas( reinterpret_cast<DocumentFile*>(docPtr),
+                                       (int)fromIndex, (int)toIndex, (int)targetWidth,
+                                       rgb565? PIXEL_FORMAT_RGB_565 : PIXEL_FORMAT_RGBA_8888,
+                                       (int)fd, reinterpret_cast<CancelToken*>(tokenPtr), &callbacks );
+}
+
+/*
+ * Same placement as nativeRenderPage, but composed from the document's tile
+ * cache so only tiles that weren't visible before get rendered.
+ * Returns the number of tiles rendered, -1 on failure.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeRenderPageTiled)(JNI_ARGS, jlong docPtr, jint pageIndex, jobject objSurface,
+                                                  jint startX, jint startY,
+                                                  jint drawSizeHor, jint drawSizeVer,
+                                                  jlong tokenPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    PagePin page(doc, (int)pageIndex);
+    if(page.get() == NULL){
+        LOGE("Render page pointers invalid");
+        return -1;
+    }
+
+    ANativeWindow_Buffer buffer;
+    ANativeWindow *nativeWindow;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer)) == NULL ) return -1;
+
+    int rendered = drawPageTiles(&doc->tileCache, page.get(), (int)pageIndex,
+                                 buffer.bits, (int)(buffer.stride) * 4, buffer.width, buffer.height,
+                                 (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer,
+                                 reinterpret_cast<CancelToken*>(tokenPtr));
+
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return (jint)rendered;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeSetTileCacheSize)(JNI_ARGS, jlong docPtr, jlong maxBytes){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    doc->tileCache.setMaxBytes((maxBytes > 0)? (size_t)maxBytes : 0);
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetTileCacheStats)(JNI_ARGS, jlong docPtr){
+    TileCache::Stats cacheStats;
+    reinterpret_cast<DocumentFile*>(docPtr)->tileCache.getStats(&cacheStats);
+
+    jlong stats[5] = { (jlong)cacheStats.hits, (jlong)cacheStats.misses,
+                       (jlong)cacheStats.prefetched, (jlong)cacheStats.prefetchUsed,
+                       (jlong)cacheStats.prefetchWasted };
+    jlongArray result = env->NewLongArray(5);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 5, stats);
+    return result;
+}
+
+/*
+ * Prefetching into the tile cache, see prefetch.hpp. nativeRunPrefetch is the
+ * worker loop, run on a background thread until nativeStopPrefetch.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewPrefetcher)(JNI_ARGS, jlong docPtr){
+    return reinterpret_cast<jlong>(new PrefetchScheduler(reinterpret_cast<DocumentFile*>(docPtr)));
+}
+
+JNI_FUNC(void, PdfiumCore, nativeUpdatePrefetch)(JNI_ARGS, jlong prefetcherPtr, jint pageIndex, jint startX,
+                                                 jint viewHorSize, jint viewVerSize, jint dpi,
+                                                 jfloat velocity){
+    reinterpret_cast<PrefetchScheduler*>(prefetcherPtr)->update( (int)pageIndex, (int)startX,
+                                                                 (int)viewHorSize, (int)viewVerSize,
+                                                                 (int)dpi, (float)velocity );
+}
+
+JNI_FUNC(void, PdfiumCore, nativeRunPrefetch)(JNI_ARGS, jlong prefetcherPtr, jobject document, jlong docPtr,
+                                              jlong schedulerPtr){
+    PrefetchScheduler *scheduler = reinterpret_cast<PrefetchScheduler*>(prefetcherPtr);
+    JavaDocumentLock docLock(env, document, docPtr,
+                             reinterpret_cast<JobScheduler*>(schedulerPtr), JOB_NEAR_VISIBLE);
+
+    PrefetchScheduler::Job job;
+    while(scheduler->nextJob(&job)){
+        int tileIndex = 0;
+        bool more = true;
+        while(more){
+            if(!docLock.lock()) return;
+            more = scheduler->prefetchTile(job, tileIndex);
+            if(docLock.unlock()){
+                //Gave way to more urgent work, the same tile comes again
+                more = true;
+            }else{
+                tileIndex++;
+            }
+            //Let waiting visible renders have the document first
+            sched_yield();
+        }
+    }
+}
+
+JNI_FUNC(void, PdfiumCore, nativeStopPrefetch)(JNI_ARGS, jlong prefetcherPtr){
+    reinterpret_cast<PrefetchScheduler*>(prefetcherPtr)->stop();
+}
+
+JNI_FUNC(void, PdfiumCore, nativeReleasePrefetcher)(JNI_ARGS, jlong prefetcherPtr){
+    delete reinterpret_cast<PrefetchScheduler*>(prefetcherPtr);
+}
+
+/*
+ * Batch rendering on child processes, see renderPool.hpp. Returns 0 if no
+ * worker could be started.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewRenderPool)(JNI_ARGS, jlong docPtr, jint workerCount,
+                                                 jint maxWidth, jint maxHeight){
+    return reinterpret_cast<jlong>(RenderPool::start( reinterpret_cast<DocumentFile*>(docPtr),
+                                                      (int)workerCount, (int)maxWidth, (int)maxHeight ));
+}
+
+//Copies each finished slot into the job's Bitmap and records the status
+class BitmapResultSink : public RenderPool::ResultSink {
+    public:
+    BitmapResultSink(JNIEnv *env, jobjectArray bitmaps, jint *statuses) :
+            env(env), bitmaps(bitmaps), statuses(statuses) {}
+
+    void onResult(int jobIndex, RenderStatus status, const void *pixels, int stride){
+        if(status == RENDER_DONE && !copyToBitmap(jobIndex, pixels, stride)) status = RENDER_FAILED;
+        statuses[jobIndex] = (jint)status;
+    }
+
+    private:
+    JNIEnv *env;
+    jobjectArray bitmaps;
+    jint *statuses;
+
+    bool copyToBitmap(int jobIndex, const void *pixels, int stride){
+        jobject bitmap = env->GetObjectArrayElement(bitmaps, jobIndex);
+        AndroidBitmapInfo info;
+        void *dst;
+        bool copied = false;
+        if(AndroidBitmap_getInfo(env, bitmap, &info) == ANDROID_BITMAP_RESULT_SUCCESS &&
+           AndroidBitmap_lockPixels(env, bitmap, &dst) == ANDROID_BITMAP_RESULT_SUCCESS){
+            const unsigned char *src = reinterpret_cast<const unsigned char*>(pixels);
+            uint32_t i;
+            for(i = 0; i < info.height; i++){
+                memcpy(reinterpret_cast<unsigned char*>(dst) + i * info.stride, src + i * stride, stride);
+            }
+            AndroidBitmap_unlockPixels(env, bitmap);
+            copied = true;
+        }
+        env->DeleteLocalRef(bitmap);
+        return copied;
+    }
+};
+
+/*
+ * Renders job i of pageIndices into bitmaps[i], placed by placements[4i..4i+3]
+ * as startX, startY, drawSizeHor, drawSizeVer. Returns the RENDER_* status of
+ * each job.
+ */
+JNI_FUNC(jintArray, PdfiumCore, nativeRenderPooled)(JNI_ARGS, jlong poolPtr, jintArray pageIndices,
+                                                    jobjectArray bitmaps, jintArray placements,
+                                                    jboolean dither, jlong tokenPtr){
+    jsize count = env->GetArrayLength(pageIndices);
+    if(env->GetArrayLength(bitmaps) != count || env->GetArrayLength(placements) != count * 4){
+        LOGE("Render pool job arrays don't match");
+        return NULL;
+    }
+    jintArray result = env->NewIntArray(count);
+    if(result == NULL) return NULL;
+
+    jint *indices = env->GetIntArrayElements(pageIndices, NULL);
+    jint *placement = env->GetIntArrayElements(placements, NULL);
+    RenderPool::Job *jobs = new RenderPool::Job[count];
+    jsize i;
+    for(i = 0; i < count; i++){
+        RenderPool::Job &job = jobs[i];
+        job.pageIndex = (int)indices[i];
+        job.startX = (int)placement[i * 4];
+        job.startY = (int)placement[i * 4 + 1];
+        job.drawSizeHor = (int)placement[i * 4 + 2];
+        job.drawSizeVer = (int)placement[i * 4 + 3];
+        job.format = PIXEL_FORMAT_RGBA_8888;
+        job.width = job.height = 0; //Fails the job
+
+        jobject bitmap = env->GetObjectArrayElement(bitmaps, i);
+        AndroidBitmapInfo info;
+        if(bitmap != NULL && AndroidBitmap_getInfo(env, bitmap, &info) == ANDROID_BITMAP_RESULT_SUCCESS){
+            if(info.format == ANDROID_BITMAP_FORMAT_RGBA_8888){
+                job.width = (int)info.width;
+                job.height = (int)info.height;
+            }else if(info.format == ANDROID_BITMAP_FORMAT_RGB_565){
+                job.format = dither? PIXEL_FORMAT_RGB_565_DITHERED : PIXEL_FORMAT_RGB_565;
+                job.width = (int)info.width;
+                job.height = (int)info.height;
+            }else{
+                LOGE("Unsupported bitmap format %d", (int)info.format);
+            }
+        }
+        env->DeleteLocalRef(bitmap);
+    }
+    env->ReleaseIntArrayElements(pageIndices, indices, JNI_ABORT);
+    env->ReleaseIntArrayElements(placements, placement, JNI_ABORT);
+
+    jint *statuses = env->GetIntArrayElements(result, NULL);
+    BitmapResultSink sink(env, bitmaps, statuses);
+    reinterpret_cast<RenderPool*>(poolPtr)->run(jobs, (int)count, &sink,
+                                                reinterpret_cast<CancelToken*>(tokenPtr));
+    env->ReleaseIntArrayElements(result, statuses, 0);
+    delete[] jobs;
+    return result;
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetRenderPoolStats)(JNI_ARGS, jlong poolPtr){
+    RenderPool *pool = reinterpret_cast<RenderPool*>(poolPtr);
+    RenderPool::Stats poolStats = pool->getStats();
+
+    jlong stats[4] = { (jlong)pool->getWorkerCount(), (jlong)poolStats.jobs,
+                       (jlong)poolStats.batchNanos, (jlong)poolStats.renderNanos };
+    jlongArray result = env->NewLongArray(4);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 4, stats);
+    return result;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeReleaseRenderPool)(JNI_ARGS, jlong poolPtr){
+    delete reinterpret_cast<RenderPool*>(poolPtr);
+}
+
+/*
+ * Progressive rendering: the page is rendered into the render's own canvas in
+ * time slices, each nativeContinueProgressiveRender call posting what is
+ * there so far when given a surface. The canvas should match the surface size.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeStartProgressiveRender)(JNI_ARGS, jlong docPtr, jint pageIndex,
+                                                          jint canvasHorSize, jint canvasVerSize,
+                                                          jint startX, jint startY,
+                                                          jint drawSizeHor, jint drawSizeVer,
+                                                          jlong tokenPtr){
+    ProgressiveRender *render = new ProgressiveRender( reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex,
+                                                       (int)canvasHorSize, (int)canvasVerSize,
+                                                       (int)startX, (int)startY,
+                                                       (int)drawSizeHor, (int)drawSizeVer,
+                                                       reinterpret_cast<CancelToken*>(tokenPtr) );
+    if(render->getStatus() == RENDER_FAILED){
+        LOGE("Starting progressive render of page %d failed", (int)pageIndex);
+        delete render;
+        return -1;
+    }
+    return reinterpret_cast<jlong>(render);
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeContinueProgressiveRender)(JNI_ARGS, jlong renderPtr, jint budgetMillis,
+                                                            jobject objSurface){
+    ProgressiveRender *render = reinterpret_cast<ProgressiveRender*>(renderPtr);
+    RenderStatus status = render->renderFor((long)budgetMillis);
+    if(objSurface == NULL) return (jint)status;
+
+    ANativeWindow_Buffer buffer;
+    ANativeWindow *nativeWindow;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer)) == NULL ) return (jint)status;
+
+    render->copyTo(buffer.bits, (int)(buffer.stride) * 4, buffer.width, buffer.height);
+
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return (jint)status;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeCloseProgressiveRender)(JNI_ARGS, jlong renderPtr){
+    delete reinterpret_cast<ProgressiveRender*>(renderPtr);
+}
+
+/*
+ * Viewport renders keep the last frame posted to a surface, a render that only
+ * scrolled renders just the newly visible strips before posting the frame.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewViewportRender)(JNI_ARGS){
+    return reinterpret_cast<jlong>(new ViewportRender());
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeRenderViewport)(JNI_ARGS, jlong viewportPtr, jlong docPtr, jint pageIndex,
+                                                 jobject objSurface, jint startX, jint startY,
+                                                 jint drawSizeHor, jint drawSizeVer,
+                                                 jlong tokenPtr){
+    ViewportRender *viewport = reinterpret_cast<ViewportRender*>(viewportPtr);
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL){
+        LOGE("Render page pointers invalid");
+        return RENDER_FAILED;
+    }
+
+    ANativeWindow_Buffer buffer;
+    ANativeWindow *nativeWindow;
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer)) == NULL ) return RENDER_FAILED;
+
+    RenderStatus status = viewport->render(page.get(), (int)pageIndex,
+                                           buffer.width, buffer.height,
+                                           (int)startX, (int)startY,
+                                           (int)drawSizeHor, (int)drawSizeVer,
+                                           reinterpret_cast<CancelToken*>(tokenPtr));
+    LOGD("Viewport rendered %d of %d pixels", viewport->getRenderedArea(), buffer.width * buffer.height);
+
+    viewport->copyTo(buffer.bits, (int)(buffer.stride) * 4, buffer.width, buffer.height);
+
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return (jint)status;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeInvalidateViewport)(JNI_ARGS, jlong viewportPtr){
+    reinterpret_cast<ViewportRender*>(viewportPtr)->invalidate();
+}
+
+JNI_FUNC(void, PdfiumCore, nativeReleaseViewportRender)(JNI_ARGS, jlong viewportPtr){
+    delete reinterpret_cast<ViewportRender*>(viewportPtr);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeEnableForms)(JNI_ARGS, jlong docPtr){
+    return (jboolean)reinterpret_cast<DocumentFile*>(docPtr)->enableForms();
+}
+
+//Keep in sync with PdfiumCore.FORM_*
+enum FormEvent {
+    FORM_MOUSE_DOWN = 0,
+    FORM_MOUSE_UP = 1,
+    FORM_MOUSE_MOVE = 2,
+    FORM_KEY_DOWN = 3,
+    FORM_KEY_UP = 4,
+    FORM_CHAR = 5
+};
+
+/*
+ * Pointer event at a device position of the page placed like in nativeRenderPage.
+ * Returns whether a form field handled it.
+ */
+JNI_FUNC(jboolean, PdfiumCore, nativeFormMouseEvent)(JNI_ARGS, jlong docPtr, jint pageIndex, jint event,
+                                                     jint deviceX, jint deviceY,
+                                                     jint startX, jint startY,
+                                                     jint drawSizeHor, jint drawSizeVer){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->formFiller == NULL) return JNI_FALSE;
+    PagePin page(doc, (int)pageIndex);
+    if(page.get() == NULL) return JNI_FALSE;
+
+    double pageX, pageY;
+    FPDF_DeviceToPage( page.get(), (int)startX, (int)startY, (int)drawSizeHor, (int)drawSizeVer, 0,
+                       (int)deviceX, (int)deviceY, &pageX, &pageY );
+
+    FPDF_FORMHANDLE form = doc->formFiller->getHandle();
+    switch(event){
+        case FORM_MOUSE_DOWN: return (jboolean)FORM_OnLButtonDown(form, page.get(), 0, pageX, pageY);
+        case FORM_MOUSE_UP: return (jboolean)FORM_OnLButtonUp(form, page.get(), 0, pageX, pageY);
+        case FORM_MOUSE_MOVE: return (jboolean)FORM_OnMouseMove(form, page.get(), 0, pageX, pageY);
+        default: return JNI_FALSE;
+    }
+}
+
+/*
+ * code is a FWL_VKEY_* key code for key events and a UTF-16 unit for FORM_CHAR,
+ * modifiers are FWL_EVENTFLAG_* bits.
+ */
+JNI_FUNC(jboolean, PdfiumCore, nativeFormKeyEvent)(JNI_ARGS, jlong docPtr, jint pageIndex, jint event,
+                                                   jint code, jint modifiers){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(doc->formFiller == NULL) return JNI_FALSE;
+    PagePin page(doc, (int)pageIndex);
+    if(page.get() == NULL) return JNI_FALSE;
+
+    FPDF_FORMHANDLE form = doc->formFiller->getHandle();
+    switch(event){
+        case FORM_KEY_DOWN: return (jboolean)FORM_OnKeyDown(form, page.get(), (int)code, (int)modifiers);
+        case FORM_KEY_UP: return (jboolean)FORM_OnKeyUp(form, page.get(), (int)code, (int)modifiers);
+        case FORM_CHAR: return (jboolean)FORM_OnChar(form, page.get(), (int)code, (int)modifiers);
+        default: return JNI_FALSE;
+    }
+}
+
+/*
+ * Layered renders keep the page content and the form overlay apart,
+ * an edit only redraws the part of the overlay pdfium invalidated.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewLayeredRender)(JNI_ARGS, jlong docPtr){
+    DocumentFile *doc = reinterpret_cast<DocumentFile*>(docPtr);
+    if(!doc->enableForms()) return -1;
+    return reinterpret_cast<jlong>(new LayeredPageRender(doc));
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeRenderLayered)(JNI_ARGS, jlong renderPtr, jlong docPtr, jint pageIndex,
+                                                jobject objSurface, jint startX, jint startY,
+                                                jint drawSizeHor, jint drawSizeVer,
+                                                jlong tokenPtr){
+    LayeredPageRender *render = reinterpret_cast<LayeredPageRender*>(renderPtr);
+    PagePin page(reinterpret_cast<DocumentFile*>(docPtr), (int)pageIndex);
+    if(page.get() == NULL){
+        LOGE("Render page pointers invalid");
+        return RENDER_FAILED;
+    }
+
+    ANativeWindow_Buffer buffer;
+    ANativeWindow *nativeWindow;
+    //The layers are RGBA, lockWindow fails a window stuck in another format
+    if( (nativeWindow = lockWindow(env, objSurface, &buffer)) == NULL ) return RENDER_FAILED;
+
+    RenderStatus status = render->render(page.get(), (int)pageIndex,
+                                         buffer.width, buffer.height,
+                                         (int)startX, (int)startY,
+                                         (int)drawSizeHor, (int)drawSizeVer,
+                                         reinterpret_cast<CancelToken*>(tokenPtr),
+                                         buffer.bits, (int)(buffer.stride) * 4);
+
+    ANativeWindow_unlockAndPost(nativeWindow);
+    ANativeWindow_release(nativeWindow);
+    return (jint)status;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeReleaseLayeredRender)(JNI_ARGS, jlong renderPtr){
+    delete reinterpret_cast<LayeredPageRender*>(renderPtr);
+}
+
+//A java.util.concurrent.FutureTask run on a document's worker thread
+class JavaTask : public SerialWorker::Task {
+    public:
+    JavaTask(JNIEnv *env, jobject futureTask) : futureTask(env->NewGlobalRef(futureTask)) {
+        jclass taskClass = env->GetObjectClass(futureTask);
+        runMethod = env->GetMethodID(taskClass, "run", "()V");
+        cancelMethod = env->GetMethodID(taskClass, "cancel", "(Z)Z");
+        env->DeleteLocalRef(taskClass);
+    }
+
+    void run(JNIEnv *env){
+        //FutureTask catches what the task throws and hands it to get()
+        env->CallVoidMethod(futureTask, runMethod);
+        clearException(env);
+        env->DeleteGlobalRef(futureTask);
+    }
+    void discard(JNIEnv *env){
+        env->CallBooleanMethod(futureTask, cancelMethod, JNI_FALSE);
+        clearException(env);
+        env->DeleteGlobalRef(futureTask);
+    }
+
+    private:
+    jobject futureTask;
+    jmethodID runMethod;
+    jmethodID cancelMethod;
+
+    static void clearException(JNIEnv *env){
+        if(env->ExceptionCheck()){
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+    }
+};
+
+/*
+ * Worker threads of documents, see serialWorker.hpp. Returns 0 if the thread
+ * couldn't be started.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeStartWorker)(JNI_ARGS, jstring name){
+    JavaVM *vm;
+    if(env->GetJavaVM(&vm) != JNI_OK) return 0;
+
+    const char *workerName = env->GetStringUTFChars(name, NULL);
+    if(workerName == NULL) return 0;
+    SerialWorker *worker = SerialWorker::start(vm, workerName);
+    env->ReleaseStringUTFChars(name, workerName);
+    return reinterpret_cast<jlong>(worker);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativePostTask)(JNI_ARGS, jlong workerPtr, jobject futureTask){
+    SerialWorker *worker = reinterpret_cast<SerialWorker*>(workerPtr);
+    return (jboolean)worker->post(env, new JavaTask(env, futureTask));
+}
+
+JNI_FUNC(void, PdfiumCore, nativeQuitWorker)(JNI_ARGS, jlong workerPtr){
+    reinterpret_cast<SerialWorker*>(workerPtr)->quit(env);
+}
+
+/*
+ * Cancel tokens are plain native objects; cancelling only flips an atomic flag,
+ * so it is safe from any thread while a render holds the document.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewCancelToken)(JNI_ARGS){
+    return reinterpret_cast<jlong>(new CancelToken());
+}
+JNI_FUNC(void, PdfiumCore, nativeCancel)(JNI_ARGS, jlong tokenPtr){
+    reinterpret_cast<CancelToken*>(tokenPtr)->cancel();
+}
+JNI_FUNC(jboolean, PdfiumCore, nativeIsCancelled)(JNI_ARGS, jlong tokenPtr){
+    return reinterpret_cast<CancelToken*>(tokenPtr)->isCancelled()? JNI_TRUE : JNI_FALSE;
+}
+JNI_FUNC(jlong, PdfiumCore, nativeGetCancelLatency)(JNI_ARGS, jlong tokenPtr){
+    return (jlong)reinterpret_cast<CancelToken*>(tokenPtr)->getCancelLatency();
+}
+JNI_FUNC(void, PdfiumCore, nativeReleaseCancelToken)(JNI_ARGS, jlong tokenPtr){
+    delete reinterpret_cast<CancelToken*>(tokenPtr);
+}
+
+//{count, total nanoseconds, max nanoseconds}
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetCancelLatencyStats)(JNI_ARGS){
+    int64_t count, totalNanos, maxNanos;
+    getCancelLatencyStats(&count, &totalNanos, &maxNanos);
+
+    jlong stats[3] = { (jlong)count, (jlong)totalNanos, (jlong)maxNanos };
+    jlongArray result = env->NewLongArray(3);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 3, stats);
+    return result;
+}
+
+/*
+ * Job scheduling per document, see jobScheduler.hpp. PdfDocument holds the
+ * first reference; nativeEnterJob blocks and must be called without the document lock.
+ */
+JNI_FUNC(jlong, PdfiumCore, nativeNewScheduler)(JNI_ARGS){
+    return reinterpret_cast<jlong>(new JobScheduler());
+}
+JNI_FUNC(void, PdfiumCore, nativeRetainScheduler)(JNI_ARGS, jlong schedulerPtr){
+    reinterpret_cast<JobScheduler*>(schedulerPtr)->acquire();
+}
+JNI_FUNC(void, PdfiumCore, nativeReleaseScheduler)(JNI_ARGS, jlong schedulerPtr){
+    reinterpret_cast<JobScheduler*>(schedulerPtr)->release();
+}
+JNI_FUNC(jlong, PdfiumCore, nativeEnterJob)(JNI_ARGS, jlong schedulerPtr, jint jobClass){
+    if(jobClass < 0 || jobClass >= JOB_CLASS_COUNT) jobClass = JOB_VISIBLE;
+    return reinterpret_cast<jlong>(reinterpret_cast<JobScheduler*>(schedulerPtr)->enter((JobClass)jobClass));
+}
+JNI_FUNC(void, PdfiumCore, nativeBeginJob)(JNI_ARGS, jlong jobPtr){
+    JobScheduler::Job *job = reinterpret_cast<JobScheduler::Job*>(jobPtr);
+    job->scheduler->begin(job);
+}
+JNI_FUNC(jboolean, PdfiumCore, nativeLeaveJob)(JNI_ARGS, jlong jobPtr){
+    JobScheduler::Job *job = reinterpret_cast<JobScheduler::Job*>(jobPtr);
+    return job->scheduler->leave(job)? JNI_TRUE : JNI_FALSE;
+}
+
+//Per class: {jobs, preemptions, total wait ns, max wait ns, queued now, max queued}
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetSchedulerStats)(JNI_ARGS, jlong schedulerPtr){
+    JobScheduler *scheduler = reinterpret_cast<JobScheduler*>(schedulerPtr);
+    jlong stats[JOB_CLASS_COUNT * 6];
+    int i;
+    for(i = 0; i < JOB_CLASS_COUNT; i++){
+        JobScheduler::ClassStats classStats;
+        scheduler->getStats((JobClass)i, &classStats);
+        jlong *entry = stats + i * 6;
+        entry[0] = (jlong)classStats.jobs;
+        entry[1] = (jlong)classStats.preemptions;
+        entry[2] = (jlong)classStats.totalWaitNanos;
+        entry[3] = (jlong)classStats.maxWaitNanos;
+        entry[4] = (jlong)classStats.queued;
+        entry[5] = (jlong)classStats.maxQueued;
+    }
+    jlongArray result = env->NewLongArray(JOB_CLASS_COUNT * 6);
+    if(result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, JOB_CLASS_COUNT * 6, stats);
+    return result;
 }
 
 }//extern C
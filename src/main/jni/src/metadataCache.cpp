@@ -0,0 +1,222 @@
+#include "util.hpp"
+#include "metadataCache.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+}
+
+#include <utils/Flattenable.h>
+
+using namespace android;
+
+MetadataCache::MetadataCache(const char *filePath, size_t maxTotalSize) :
+        filePath(filePath),
+        maxTotalSize(maxTotalSize),
+        totalSize(sizeof(Header)),
+        useClock(0) {}
+
+size_t MetadataCache::entrySize(size_t valueCount){
+    return FlattenableUtils::align<8>(sizeof(EntryHeader) + valueCount * sizeof(float));
+}
+
+void MetadataCache::setMaxTotalSize(size_t size){
+    maxTotalSize = size;
+    trimToSize(maxTotalSize);
+}
+
+bool MetadataCache::get(const FileIdentity &key, uint64_t fingerprint, std::vector<float> *outValue){
+    EntryMap::iterator it = entries.find(key);
+    //Same size and time, yet other content
+    if(it != entries.end() && it->second.fingerprint != fingerprint) it = entries.end();
+    if(it == entries.end() && fingerprint != 0){
+        for(it = entries.begin(); it != entries.end(); ++it){
+            if(it->second.fingerprint == fingerprint && it->first.size == key.size) break;
+        }
+    }
+    if(it == entries.end()) return false;
+
+    it->second.lastUse = ++useClock;
+    *outValue = it->second.value;
+    return true;
+}
+
+void MetadataCache::put(const FileIdentity &key, uint64_t fingerprint, const std::vector<float> &value){
+    size_t size = entrySize(value.size());
+    if(maxTotalSize <= sizeof(Header)) return;
+    //Same rule as BlobCache: a single value may take at most half of the budget
+    if(size > (maxTotalSize - sizeof(Header)) / 2){
+        LOGD("Metadata too large for the cache: %d bytes", (int)size);
+        return;
+    }
+
+    EntryMap::iterator it = entries.begin();
+    while(it != entries.end()){
+        if(it->first.isSameFile(key)) removeEntry(it++);
+        else ++it;
+    }
+
+    trimToSize(maxTotalSize - size);
+
+    Entry &entry = entries[key];
+    entry.fingerprint = fingerprint;
+    entry.lastUse = ++useClock;
+    entry.value = value;
+    totalSize += size;
+}
+
+void MetadataCache::removeEntry(EntryMap::iterator it){
+    totalSize -= entrySize(it->second.value.size());
+    entries.erase(it);
+}
+
+void MetadataCache::trimToSize(size_t size){
+    while(totalSize > size && !entries.empty()){
+        EntryMap::iterator oldest = entries.begin();
+        for(EntryMap::iterator it = entries.begin(); it != entries.end(); ++it){
+            if(it->second.lastUse < oldest->second.lastUse) oldest = it;
+        }
+        removeEntry(oldest);
+    }
+}
+
+size_t MetadataCache::getFlattenedSize() const {
+    return totalSize;
+}
+
+status_t MetadataCache::flatten(void *buffer, size_t size) const {
+    if(size < getFlattenedSize()) return BAD_VALUE;
+
+    Header header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.entryCount = (uint32_t)entries.size();
+    header.useClock = useClock;
+    FlattenableUtils::write(buffer, size, header);
+
+    for(EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it){
+        size_t valueCount = it->second.value.size();
+
+        EntryHeader entryHeader;
+        entryHeader.key = it->first;
+        entryHeader.fingerprint = it->second.fingerprint;
+        entryHeader.lastUse = it->second.lastUse;
+        entryHeader.valueCount = (uint32_t)valueCount;
+
+        size_t padded = entrySize(valueCount);
+        void *entryBuffer = buffer;
+        size_t entryRemain = padded;
+        FlattenableUtils::write(entryBuffer, entryRemain, entryHeader);
+        if(valueCount > 0){
+            memcpy(entryBuffer, &it->second.value[0], valueCount * sizeof(float));
+        }
+        memset(reinterpret_cast<uint8_t*>(entryBuffer) + valueCount * sizeof(float), 0,
+               entryRemain - valueCount * sizeof(float));
+
+        FlattenableUtils::advance(buffer, size, padded);
+    }
+    return NO_ERROR;
+}
+
+status_t MetadataCache::unflatten(void const *buffer, size_t size){
+    entries.clear();
+    totalSize = sizeof(Header);
+    useClock = 0;
+
+    if(size < sizeof(Header)) return BAD_VALUE;
+    Header header;
+    FlattenableUtils::read(buffer, size, header);
+    if(header.magic != kMagic || header.version != kVersion){
+        LOGD("Discarding metadata cache of unknown format");
+        return BAD_VALUE;
+    }
+
+    for(uint32_t i = 0; i < header.entryCount; i++){
+        if(size < sizeof(EntryHeader)) break;
+
+        const void *entryBuffer = buffer;
+        size_t entryRemain = size;
+        EntryHeader entryHeader;
+        FlattenableUtils::read(entryBuffer, entryRemain, entryHeader);
+
+        size_t padded = entrySize(entryHeader.valueCount);
+        if(entryHeader.valueCount > size / sizeof(float) || padded > size){
+            LOGE("Truncated metadata cache entry");
+            entries.clear();
+            totalSize = sizeof(Header);
+            return BAD_VALUE;
+        }
+
+        Entry &entry = entries[entryHeader.key];
+        entry.fingerprint = entryHeader.fingerprint;
+        entry.lastUse = entryHeader.lastUse;
+        const float *values = reinterpret_cast<const float*>(entryBuffer);
+        entry.value.assign(values, values + entryHeader.valueCount);
+        totalSize += padded;
+
+        FlattenableUtils::advance(buffer, size, padded);
+    }
+    useClock = header.useClock;
+
+    //The budget may have shrunk since the file was written
+    trimToSize(maxTotalSize);
+    return NO_ERROR;
+}
+
+bool MetadataCache::load(){
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if(fd < 0){
+        if(errno != ENOENT) LOGE("Opening metadata cache failed: %s", strerror(errno));
+        return false;
+    }
+
+    bool loaded = false;
+    struct stat fileState;
+    if(fstat(fd, &fileState) >= 0 && fileState.st_size > 0){
+        size_t fileSize = (size_t)fileState.st_size;
+        void *map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED){
+            loaded = (unflatten(map, fileSize) == NO_ERROR);
+            munmap(map, fileSize);
+        }else{
+            LOGE("Mapping metadata cache failed: %s", strerror(errno));
+        }
+    }
+    close(fd);
+    return loaded;
+}
+
+bool MetadataCache::save() const {
+    //Write aside and rename, so a crash never leaves a half written cache behind
+    std::string tempPath = filePath + ".tmp";
+    int fd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        LOGE("Creating metadata cache failed: %s", strerror(errno));
+        return false;
+    }
+
+    size_t fileSize = getFlattenedSize();
+    bool saved = false;
+    if(ftruncate(fd, (off_t)fileSize) == 0){
+        void *map = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(map != MAP_FAILED){
+            saved = (flatten(map, fileSize) == NO_ERROR);
+            munmap(map, fileSize);
+        }else{
+            LOGE("Mapping metadata cache failed: %s", strerror(errno));
+        }
+    }
+    close(fd);
+
+    if(saved && rename(tempPath.c_str(), filePath.c_str()) != 0){
+        LOGE("Replacing metadata cache failed: %s", strerror(errno));
+        saved = false;
+    }
+    if(!saved) unlink(tempPath.c_str());
+    return saved;
+}
@@ -0,0 +1,84 @@
+#ifndef _METADATA_CACHE_HPP_
+#define _METADATA_CACHE_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <utils/Errors.h>
+
+#include "fileAccess.hpp"
+
+/**
+ * Persistent sidecar of per-document layout data, so a known document can be
+ * laid out without loading a single page.
+ * Modeled on utils/BlobCache.h: opaque values behind fixed-size keys, a total
+ * size budget, and flatten/unflatten for the on-disk image, which is read and
+ * written through mmap. BlobCache itself lives in libutils, which isn't linked.
+ *
+ * Values are the packed float records handed to Java, the cache doesn't look inside.
+ * Not thread safe, callers guard it with their own lock.
+ */
+class MetadataCache {
+    public:
+    MetadataCache(const char *filePath, size_t maxTotalSize);
+
+    const std::string& getFilePath() const { return filePath; }
+    void setMaxTotalSize(size_t size);
+
+    /*
+     * Entries are keyed by the file and the document's fingerprint (see
+     * getDocumentFingerprint), both must match. A fingerprint other than 0 also
+     * finds the entry of a copy of the same size elsewhere.
+     */
+    bool get(const FileIdentity &key, uint64_t fingerprint, std::vector<float> *outValue);
+    //Also drops entries of older versions of the same file
+    void put(const FileIdentity &key, uint64_t fingerprint, const std::vector<float> &value);
+
+    bool load();
+    bool save() const;
+
+    size_t getFlattenedSize() const;
+    android::status_t flatten(void *buffer, size_t size) const;
+    android::status_t unflatten(void const *buffer, size_t size);
+
+    private:
+    static const uint32_t kMagic = ('_' << 24) + ('P' << 16) + ('M' << 8) + 'C';
+    static const uint32_t kVersion = 2;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t useClock;
+    };
+    struct EntryHeader {
+        FileIdentity key;
+        uint64_t fingerprint;
+        uint32_t lastUse;
+        uint32_t valueCount;
+    };
+    struct Entry {
+        uint64_t fingerprint;
+        uint32_t lastUse;
+        std::vector<float> value;
+    };
+    typedef std::map<FileIdentity, Entry> EntryMap;
+
+    std::string filePath;
+    size_t maxTotalSize;
+    size_t totalSize;
+    uint32_t useClock;
+    EntryMap entries;
+
+    static size_t entrySize(size_t valueCount);
+    void removeEntry(EntryMap::iterator it);
+    void trimToSize(size_t size);
+};
+
+#endif
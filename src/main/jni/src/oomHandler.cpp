@@ -0,0 +1,63 @@
+#include "util.hpp"
+#include "oomHandler.hpp"
+#include "documentFile.hpp"
+
+extern "C" {
+    #include <pthread.h>
+    #include <stdint.h>
+}
+
+#include <fpdfoom.h>
+
+static volatile unsigned int sOOMCount = 0;
+
+//Failures of each thread, stored as the key's value itself
+static pthread_key_t sThreadOOMKey;
+static pthread_once_t sThreadOOMOnce = PTHREAD_ONCE_INIT;
+
+static void createThreadOOMKey(){
+    pthread_key_create(&sThreadOOMKey, NULL);
+}
+
+static unsigned int getThreadOOMCount(){
+    pthread_once(&sThreadOOMOnce, createThreadOOMKey);
+    return (unsigned int)reinterpret_cast<uintptr_t>(pthread_getspecific(sThreadOOMKey));
+}
+
+static void onOutOfMemory(OOM_INFO *pThis){
+    //Called from inside a failing pdfium allocation, so don't touch pdfium or the heap here
+    __sync_fetch_and_add(&sOOMCount, 1);
+    pthread_setspecific(sThreadOOMKey, reinterpret_cast<void*>((uintptr_t)(getThreadOOMCount() + 1)));
+}
+
+static OOM_INFO sOOMInfo = { 1, onOutOfMemory };
+
+void installOOMHandler(){
+    pthread_once(&sThreadOOMOnce, createThreadOOMKey);
+    if(!FSDK_SetOOMHandler(&sOOMInfo)){
+        LOGE("Installing OOM handler failed");
+    }
+}
+
+unsigned int getOOMCount(){
+    return __sync_fetch_and_add(&sOOMCount, 0);
+}
+
+OOMRetry::OOMRetry(PageCache *pages) :
+        pages(pages),
+        oomCountBefore(getThreadOOMCount()),
+        retried(false) {}
+
+bool OOMRetry::shouldRetry(){
+    if(retried || getThreadOOMCount() == oomCountBefore) return false;
+    retried = true;
+
+    //Cheapest to rebuild first, stop as soon as something was given back
+    int released = trimAllDocuments(CACHE_SCRATCH_BUFFERS);
+    if(released == 0) released = trimAllDocuments(CACHE_TILES);
+    if(released == 0 && pages != NULL) released = pages->trim(0);
+    LOGI("Out of memory, released %d cached objects, retrying", released);
+
+    oomCountBefore = getThreadOOMCount();
+    return true;
+}
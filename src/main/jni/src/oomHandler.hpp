@@ -0,0 +1,43 @@
+#ifndef _OOM_HANDLER_HPP_
+#define _OOM_HANDLER_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+class PageCache;
+
+//Registers the handler with pdfium, call right after FPDF_InitLibrary
+void installOOMHandler();
+//Number of allocation failures pdfium reported since the library was loaded
+unsigned int getOOMCount();
+
+/**
+ * Retry helper for a pdfium operation that may have failed for lack of memory.
+ * pdfium only calls the OOM handler and then returns the failure to us, so the
+ * handler just records the event; freeing caches happens here, outside pdfium,
+ * before the caller tries once more:
+ *
+ *     OOMRetry oom(&doc->pageCache);
+ *     do{ page = FPDF_LoadPage(doc, index); }while(page == NULL && oom.shouldRetry());
+ *
+ * Only failures on the calling thread count, an OOM of unrelated work elsewhere
+ * doesn't make this operation retry. Other documents may be inside pdfium on
+ * other threads, so the only pdfium objects released are the idle pages in
+ * pages, the cache of the caller's document whose lock it holds. Besides those
+ * only caches that don't touch pdfium (scratch buffers, tiles) are trimmed.
+ */
+class OOMRetry {
+    public:
+    explicit OOMRetry(PageCache *pages = NULL);
+
+    //True once if an OOM happened on this thread since construction, after native caches were released
+    bool shouldRetry();
+
+    private:
+    PageCache *pages;
+    unsigned int oomCountBefore;
+    bool retried;
+};
+
+#endif
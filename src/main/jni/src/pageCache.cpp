@@ -0,0 +1,159 @@
+#include "util.hpp"
+#include "pageCache.hpp"
+#include "oomHandler.hpp"
+
+using namespace android;
+
+PageCache::PageCache(size_t maxPages) :
+        idlePages(maxPages),
+        pageCloser(this),
+        pageListener(NULL) {
+    idlePages.setOnEntryRemovedListener(&pageCloser);
+}
+
+PageCache::~PageCache(){
+    clear();
+}
+
+FPDF_PAGE PageCache::acquire(FPDF_DOCUMENT pdfDoc, int pageIndex){
+    {
+        Mutex::Autolock lock(cacheLock);
+
+        std::map<int, PinnedPage>::iterator it = pinnedPages.find(pageIndex);
+        if(it != pinnedPages.end()){
+            it->second.pinCount++;
+            return it->second.page;
+        }
+
+        FPDF_PAGE page;
+        if(idlePages.take(pageIndex, &page)){
+            PinnedPage &pinned = pinnedPages[pageIndex];
+            pinned.page = page;
+            pinned.pinCount = 1;
+            return page;
+        }
+    }
+
+    //Load without holding the lock, page parsing can take long
+    //and may end up in the OOM handler which trims this cache
+    if(pdfDoc == NULL) return NULL;
+    FPDF_PAGE page;
+    OOMRetry oom(this);
+    do{
+        page = FPDF_LoadPage(pdfDoc, pageIndex);
+    }while(page == NULL && oom.shouldRetry());
+    if(page == NULL){
+        LOGE("Load page %d failed, Last Error: %ld", pageIndex, FPDF_GetLastError());
+        return NULL;
+    }
+
+    Mutex::Autolock lock(cacheLock);
+    std::map<int, PinnedPage>::iterator it = pinnedPages.find(pageIndex);
+    if(it != pinnedPages.end()){
+        //Someone else loaded it meanwhile
+        FPDF_ClosePage(page);
+        it->second.pinCount++;
+        return it->second.page;
+    }
+
+    PinnedPage &pinned = pinnedPages[pageIndex];
+    pinned.page = page;
+    pinned.pinCount = 1;
+    if(pageListener != NULL) pageListener->onPageLoaded(page);
+    return page;
+}
+
+void PageCache::release(int pageIndex){
+    Mutex::Autolock lock(cacheLock);
+
+    std::map<int, PinnedPage>::iterator it = pinnedPages.find(pageIndex);
+    if(it == pinnedPages.end()){
+        LOGE("Release page %d which isn't pinned", pageIndex);
+        return;
+    }
+    if(--(it->second.pinCount) > 0) return;
+
+    FPDF_PAGE page = it->second.page;
+    pinnedPages.erase(it);
+    if(idlePages.getMaxCost() == 0){
+        closePage(page);
+        return;
+    }
+    idlePages.put(pageIndex, page);
+}
+
+bool PageCache::contains(int pageIndex){
+    Mutex::Autolock lock(cacheLock);
+    return pinnedPages.find(pageIndex) != pinnedPages.end() || idlePages.contains(pageIndex);
+}
+
+bool PageCache::close(int pageIndex){
+    Mutex::Autolock lock(cacheLock);
+    return idlePages.remove(pageIndex);
+}
+
+void PageCache::setMaxPages(size_t maxPages){
+    Mutex::Autolock lock(cacheLock);
+    idlePages.setMaxCost(maxPages);
+}
+
+size_t PageCache::getMaxPages(){
+    Mutex::Autolock lock(cacheLock);
+    return idlePages.getMaxCost();
+}
+
+int PageCache::trim(size_t keepPages){
+    Mutex::Autolock lock(cacheLock);
+    return (int)idlePages.trimToCost(keepPages);
+}
+
+void PageCache::clear(){
+    Mutex::Autolock lock(cacheLock);
+
+    if(!pinnedPages.empty()){
+        LOGE("Closing %d pages still in use", (int)pinnedPages.size());
+        for(std::map<int, PinnedPage>::iterator it = pinnedPages.begin(); it != pinnedPages.end(); ++it){
+            closePage(it->second.page);
+        }
+        pinnedPages.clear();
+    }
+    idlePages.clear();
+}
+
+void PageCache::closePage(FPDF_PAGE page){
+    if(pageListener != NULL) pageListener->onPageClosing(page);
+    FPDF_ClosePage(page);
+}
+
+class PageCollector {
+    public:
+    explicit PageCollector(std::vector<FPDF_PAGE> *pages) : pages(pages) {}
+    void operator()(const int &pageIndex, FPDF_PAGE &page){ pages->push_back(page); }
+
+    private:
+    std::vector<FPDF_PAGE> *pages;
+};
+
+void PageCache::collectPages(std::vector<FPDF_PAGE> *pages){
+    for(std::map<int, PinnedPage>::iterator it = pinnedPages.begin(); it != pinnedPages.end(); ++it){
+        pages->push_back(it->second.page);
+    }
+    PageCollector collector(pages);
+    idlePages.forEach(collector);
+}
+
+void PageCache::setPageListener(PageListener *listener){
+    Mutex::Autolock lock(cacheLock);
+    if(listener == pageListener) return;
+
+    std::vector<FPDF_PAGE> pages;
+    collectPages(&pages);
+    std::vector<FPDF_PAGE>::iterator it;
+    if(pageListener != NULL){
+        for(it = pages.begin(); it != pages.end(); ++it) pageListener->onPageClosing(*it);
+    }
+    pageListener = listener;
+    if(pageListener != NULL){
+        for(it = pages.begin(); it != pages.end(); ++it) pageListener->onPageLoaded(*it);
+    }
+}
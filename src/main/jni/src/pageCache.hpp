@@ -0,0 +1,83 @@
+#ifndef _PAGE_CACHE_HPP_
+#define _PAGE_CACHE_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+#include <map>
+#include <vector>
+
+#include <utils/Mutex.h>
+
+#include <fpdfview.h>
+
+#include "lruCache.hpp"
+
+/**
+ * Loaded pages of one document, addressed by page index.
+ * Idle pages sit in an LRU bounded by a page budget and are closed when they
+ * fall out of it; pages being used (pinned) are never closed, and go back to
+ * the LRU once the last user releases them. A page that was evicted is simply
+ * loaded again by the next acquire.
+ */
+class PageCache {
+    public:
+    static const size_t kDefaultMaxPages = 10;
+
+    //Told about every page loaded and closed, e.g. to attach per page form state
+    class PageListener {
+        public:
+        virtual ~PageListener() { }
+        virtual void onPageLoaded(FPDF_PAGE page) = 0;
+        virtual void onPageClosing(FPDF_PAGE page) = 0;
+    };
+
+    explicit PageCache(size_t maxPages);
+    ~PageCache();
+
+    //Loads the page if needed and pins it, NULL if it can't be loaded
+    FPDF_PAGE acquire(FPDF_DOCUMENT pdfDoc, int pageIndex);
+    void release(int pageIndex);
+
+    bool contains(int pageIndex);
+    //Closes the page now unless it is pinned
+    bool close(int pageIndex);
+
+    void setMaxPages(size_t maxPages);
+    size_t getMaxPages();
+    //Closes idle pages until at most keepPages idle ones remain, returns the number closed
+    int trim(size_t keepPages);
+    //Closes everything, no page may be pinned
+    void clear();
+
+    //Pages loaded already are announced as closing to the old listener and as loaded to the new one
+    void setPageListener(PageListener *listener);
+
+    private:
+    struct PinnedPage {
+        FPDF_PAGE page;
+        int pinCount;
+    };
+
+    class PageCloser : public BoundedLruCache<int, FPDF_PAGE>::OnEntryRemoved {
+        public:
+        explicit PageCloser(PageCache *cache) : cache(cache) {}
+        void operator()(const int &pageIndex, FPDF_PAGE &page){ cache->closePage(page); }
+
+        private:
+        PageCache *cache;
+    };
+
+    android::Mutex cacheLock;
+    BoundedLruCache<int, FPDF_PAGE> idlePages;
+    std::map<int, PinnedPage> pinnedPages;
+    PageCloser pageCloser;
+    PageListener *pageListener;
+
+    //Must be called with cacheLock held
+    void closePage(FPDF_PAGE page);
+    void collectPages(std::vector<FPDF_PAGE> *pages);
+};
+
+#endif
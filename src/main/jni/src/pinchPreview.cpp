@@ -0,0 +1,164 @@
+#include "util.hpp"
+#include "pinchPreview.hpp"
+#include "pixelConvert.hpp"
+#include "scratchBuffer.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+    #include <math.h>
+}
+
+using namespace android;
+
+//Same gray renderPageToBuffer fills the canvas outside the page with
+static const uint8_t kOutsideGray = 0x84;
+
+//Widens 5 and 6 bit channels back to 8, replicating the top bits into the low ones
+static void expandRGB565Row(const uint16_t *src, uint8_t *dst, int width){
+    int x;
+    for(x = 0; x < width; x++){
+        uint16_t pixel = src[x];
+        int r = pixel >> 11, g = (pixel >> 5) & 0x3f, b = pixel & 0x1f;
+        dst[x * 4] = (uint8_t)((r << 3) | (r >> 2));
+        dst[x * 4 + 1] = (uint8_t)((g << 2) | (g >> 4));
+        dst[x * 4 + 2] = (uint8_t)((b << 3) | (b >> 2));
+        dst[x * 4 + 3] = 0xff;
+    }
+}
+
+static void fillGray(uint8_t *row, int from, int to){
+    int x;
+    for(x = from; x < to; x++){
+        row[x * 4] = row[x * 4 + 1] = row[x * 4 + 2] = kOutsideGray;
+        row[x * 4 + 3] = 0xff;
+    }
+}
+
+static int clampInt(int value, int low, int high){
+    return (value < low)? low : (value > high)? high : value;
+}
+
+PinchPreview::PinchPreview() :
+        refs(1),
+        frame(NULL),
+        capacity(0),
+        framePage(-1),
+        frameWidth(0), frameHeight(0),
+        frameStartX(0), frameStartY(0),
+        frameDrawHor(0), frameDrawVer(0) {}
+
+PinchPreview::~PinchPreview(){
+    free(frame);
+}
+
+void PinchPreview::acquire(){
+    __sync_fetch_and_add(&refs, 1);
+}
+
+void PinchPreview::release(){
+    if(__sync_sub_and_fetch(&refs, 1) == 0) delete this;
+}
+
+void PinchPreview::capture(int pageIndex, const void *pixels, int width, int height, int stride, PixelFormat format,
+                           int startX, int startY, int drawSizeHor, int drawSizeVer){
+    if(pixels == NULL || width <= 0 || height <= 0 || drawSizeHor <= 0 || drawSizeVer <= 0) return;
+    if(format == PIXEL_FORMAT_GRAY_8) return;
+
+    Mutex::Autolock autoLock(lock);
+    size_t size = (size_t)width * height * 4;
+    if(size > capacity){
+        free(frame);
+        capacity = 0;
+        framePage = -1;
+        if( (frame = reinterpret_cast<uint8_t*>(malloc(size))) == NULL ){
+            LOGE("No memory to keep a %dx%d pinch preview frame", width, height);
+            return;
+        }
+        capacity = size;
+    }
+
+    int y;
+    for(y = 0; y < height; y++){
+        const uint8_t *srcRow = reinterpret_cast<const uint8_t*>(pixels) + y * stride;
+        uint8_t *dstRow = frame + y * width * 4;
+        if(format == PIXEL_FORMAT_RGBA_8888){
+            memcpy(dstRow, srcRow, width * 4);
+        }else{
+            expandRGB565Row(reinterpret_cast<const uint16_t*>(srcRow), dstRow, width);
+        }
+    }
+    framePage = pageIndex;
+    frameWidth = width;
+    frameHeight = height;
+    frameStartX = startX;
+    frameStartY = startY;
+    frameDrawHor = drawSizeHor;
+    frameDrawVer = drawSizeVer;
+}
+
+bool PinchPreview::canDrawLocked(int pageIndex, int drawSizeHor, int drawSizeVer, float maxDrift) const {
+    if(framePage < 0 || framePage != pageIndex || drawSizeHor <= 0 || drawSizeVer <= 0) return false;
+    double scaleHor = (double)drawSizeHor / frameDrawHor;
+    double scaleVer = (double)drawSizeVer / frameDrawVer;
+    return scaleHor <= maxDrift && 1 / scaleHor <= maxDrift &&
+           scaleVer <= maxDrift && 1 / scaleVer <= maxDrift;
+}
+
+bool PinchPreview::canDraw(int pageIndex, int drawSizeHor, int drawSizeVer, float maxDrift){
+    Mutex::Autolock autoLock(lock);
+    return canDrawLocked(pageIndex, drawSizeHor, drawSizeVer, maxDrift);
+}
+
+void PinchPreview::drawRGBx(uint8_t *pixels, int width, int height, int stride,
+                            int startX, int startY, int drawSizeHor, int drawSizeVer) const {
+    double scaleHor = (double)drawSizeHor / frameDrawHor;
+    double scaleVer = (double)drawSizeVer / frameDrawVer;
+
+    //Part of the canvas the kept frame lands on
+    int left = clampInt((int)floor(startX - frameStartX * scaleHor + 0.5), 0, width);
+    int right = clampInt((int)floor(startX + (frameWidth - frameStartX) * scaleHor + 0.5), left, width);
+    int top = clampInt((int)floor(startY - frameStartY * scaleVer + 0.5), 0, height);
+    int bottom = clampInt((int)floor(startY + (frameHeight - frameStartY) * scaleVer + 0.5), top, height);
+
+    int y;
+    for(y = 0; y < height; y++){
+        uint8_t *row = pixels + y * stride;
+        if(y < top || y >= bottom){
+            fillGray(row, 0, width);
+        }else{
+            fillGray(row, 0, left);
+            fillGray(row, right, width);
+        }
+    }
+    if(right <= left || bottom <= top) return;
+
+    //Canvas pixel centers mapped back into the kept frame
+    resampleRGBxBilinear( frame, frameWidth * 4, frameWidth, frameHeight,
+                          pixels + top * stride + left * 4, stride, right - left, bottom - top,
+                          frameStartX + (left + 0.5 - startX) / scaleHor - 0.5, 1 / scaleHor,
+                          frameStartY + (top + 0.5 - startY) / scaleVer - 0.5, 1 / scaleVer );
+}
+
+bool PinchPreview::draw(int pageIndex, void *pixels, int width, int height, int stride, PixelFormat format,
+                        int startX, int startY, int drawSizeHor, int drawSizeVer, float maxDrift){
+    if(pixels == NULL || width <= 0 || height <= 0 || format == PIXEL_FORMAT_GRAY_8) return false;
+
+    Mutex::Autolock autoLock(lock);
+    if(!canDrawLocked(pageIndex, drawSizeHor, drawSizeVer, maxDrift)) return false;
+
+    if(format == PIXEL_FORMAT_RGBA_8888){
+        drawRGBx( reinterpret_cast<uint8_t*>(pixels), width, height, stride,
+                  startX, startY, drawSizeHor, drawSizeVer );
+        return true;
+    }
+
+    ScratchBuffer rgbx(width * height * 4);
+    if(rgbx.get() == NULL) return false;
+    drawRGBx( reinterpret_cast<uint8_t*>(rgbx.get()), width, height, width * 4,
+              startX, startY, drawSizeHor, drawSizeVer );
+    convertRGBxToRGB565( reinterpret_cast<const uint8_t*>(rgbx.get()), width * 4,
+                         reinterpret_cast<uint16_t*>(pixels), stride,
+                         width, height, format == PIXEL_FORMAT_RGB_565_DITHERED );
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef _PINCH_PREVIEW_HPP_
+#define _PINCH_PREVIEW_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <utils/Mutex.h>
+
+#include "bitmapRender.hpp"
+
+/**
+ * The last complete frame of one Surface, kept so the steps of a pinch can be
+ * drawn by resampling it (see resampleRGBxBilinear) instead of rendering the
+ * page again; only the end of the gesture, or a zoom too far from the kept
+ * frame, needs pdfium. Frames are kept as RGBx whatever the window format.
+ *
+ * Renders capture into it under the document lock while pinch steps draw from
+ * it without, so it is reference counted and locks itself.
+ */
+class PinchPreview {
+    public:
+    //Starts with one reference, the owner's
+    PinchPreview();
+
+    void acquire();
+    //Frees the preview with the last reference
+    void release();
+
+    //Keeps a copy of a finished frame of pageIndex, placed like renderPageToBuffer's arguments
+    void capture(int pageIndex, const void *pixels, int width, int height, int stride, PixelFormat format,
+                 int startX, int startY, int drawSizeHor, int drawSizeVer);
+
+    /*
+     * The kept frame is of pageIndex and its zoom is within maxDrift of
+     * drawSizeHor x drawSizeVer, e.g. 1.5 allows 1/1.5 to 1.5 times the frame's.
+     */
+    bool canDraw(int pageIndex, int drawSizeHor, int drawSizeVer, float maxDrift);
+    /*
+     * Draws the kept frame as if rendered with the new placement, the area it
+     * doesn't cover is gray. False, leaving the pixels alone, unless canDraw().
+     */
+    bool draw(int pageIndex, void *pixels, int width, int height, int stride, PixelFormat format,
+              int startX, int startY, int drawSizeHor, int drawSizeVer, float maxDrift);
+
+    private:
+    ~PinchPreview();
+    PinchPreview(const PinchPreview&); //Disallow copy
+
+    bool canDrawLocked(int pageIndex, int drawSizeHor, int drawSizeVer, float maxDrift) const;
+    void drawRGBx(uint8_t *pixels, int width, int height, int stride,
+                  int startX, int startY, int drawSizeHor, int drawSizeVer) const;
+
+    android::Mutex lock;
+    volatile int refs;
+
+    uint8_t *frame;
+    size_t capacity;
+    //-1 without a frame
+    int framePage;
+    int frameWidth, frameHeight;
+    int frameStartX, frameStartY;
+    int frameDrawHor, frameDrawVer;
+};
+
+#endif
@@ -0,0 +1,505 @@
+#include "pixelConvert.hpp"
+
+extern "C" {
+    #include <string.h>
+    #include <math.h>
+}
+
+#include <vector>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PIXEL_CONVERT_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PIXEL_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+//4x4 Bayer matrix scaled to the bits each channel loses: 3 for red and blue, 2 for green
+static const uint8_t kDitherRB[4][4] = {
+    { 0, 4, 1, 5 },
+    { 6, 2, 7, 3 },
+    { 1, 5, 0, 4 },
+    { 7, 3, 6, 2 }
+};
+static const uint8_t kDitherG[4][4] = {
+    { 0, 2, 0, 2 },
+    { 3, 1, 3, 1 },
+    { 0, 2, 0, 2 },
+    { 3, 1, 3, 1 }
+};
+
+static const uint8_t kBayer4x4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+static inline uint8_t addSaturate(uint8_t value, uint8_t add){
+    int sum = value + add;
+    return (sum > 255)? 255 : (uint8_t)sum;
+}
+
+//Converts pixels [fromX, width) of one row
+static inline void convertRowScalar(const uint8_t *src, uint16_t *dst,
+                                    int fromX, int width, int y, bool dither){
+    int x;
+    for(x = fromX; x < width; x++){
+        uint8_t r = src[x * 4];
+        uint8_t g = src[x * 4 + 1];
+        uint8_t b = src[x * 4 + 2];
+        if(dither){
+            r = addSaturate(r, kDitherRB[y & 3][x & 3]);
+            g = addSaturate(g, kDitherG[y & 3][x & 3]);
+            b = addSaturate(b, kDitherRB[y & 3][x & 3]);
+        }
+        dst[x] = (uint16_t)( ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3) );
+    }
+}
+
+void convertRGBxToRGB565Scalar(const uint8_t *src, int srcStride,
+                               uint16_t *dst, int dstStride,
+                               int width, int height, bool dither){
+    int y;
+    for(y = 0; y < height; y++){
+        convertRowScalar( src + y * srcStride,
+                          reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + y * dstStride),
+                          0, width, y, dither );
+    }
+}
+
+#if defined(PIXEL_CONVERT_NEON)
+
+//8 pixels per step, returns the first pixel left for the scalar tail
+static int convertRowVector(const uint8_t *src, uint16_t *dst, int width, int y, bool dither){
+    //The pattern repeats every 4 pixels, so one row of it fills 8 lanes twice
+    uint8_t rbRow[8], gRow[8];
+    int i;
+    for(i = 0; i < 8; i++){
+        rbRow[i] = dither? kDitherRB[y & 3][i & 3] : 0;
+        gRow[i] = dither? kDitherG[y & 3][i & 3] : 0;
+    }
+    uint8x8_t ditherRB = vld1_u8(rbRow);
+    uint8x8_t ditherG = vld1_u8(gRow);
+
+    int x;
+    for(x = 0; x + 8 <= width; x += 8){
+        uint8x8x4_t pixels = vld4_u8(src + x * 4);
+        uint8x8_t r = vqadd_u8(pixels.val[0], ditherRB);
+        uint8x8_t g = vqadd_u8(pixels.val[1], ditherG);
+        uint8x8_t b = vqadd_u8(pixels.val[2], ditherRB);
+
+        //Shift each channel to the top of a 16 bit lane, then insert the next below it
+        uint16x8_t packed = vshll_n_u8(r, 8);
+        packed = vsriq_n_u16(packed, vshll_n_u8(g, 8), 5);
+        packed = vsriq_n_u16(packed, vshll_n_u8(b, 8), 11);
+        vst1q_u16(dst + x, packed);
+    }
+    return x;
+}
+
+#elif defined(PIXEL_CONVERT_SSE2)
+
+//565 value of 4 RGBx pixels in the low half of each 32 bit lane, sign extended for packing
+static inline __m128i packPixels565(__m128i pixels){
+    __m128i r = _mm_slli_epi32(_mm_and_si128(pixels, _mm_set1_epi32(0x000000F8)), 8);
+    __m128i g = _mm_srli_epi32(_mm_and_si128(pixels, _mm_set1_epi32(0x0000FC00)), 5);
+    __m128i b = _mm_srli_epi32(_mm_and_si128(pixels, _mm_set1_epi32(0x00F80000)), 19);
+    __m128i packed = _mm_or_si128(_mm_or_si128(r, g), b);
+    //_mm_packs_epi32 saturates signed values, so make the 16 bit values look signed
+    return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+}
+
+//8 pixels per step, returns the first pixel left for the scalar tail
+static int convertRowVector(const uint8_t *src, uint16_t *dst, int width, int y, bool dither){
+    //One row of the pattern covers exactly 4 pixels
+    uint8_t thresholds[16];
+    int i;
+    for(i = 0; i < 4; i++){
+        thresholds[i * 4] = dither? kDitherRB[y & 3][i] : 0;
+        thresholds[i * 4 + 1] = dither? kDitherG[y & 3][i] : 0;
+        thresholds[i * 4 + 2] = dither? kDitherRB[y & 3][i] : 0;
+        thresholds[i * 4 + 3] = 0;
+    }
+    __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds));
+
+    int x;
+    for(x = 0; x + 8 <= width; x += 8){
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + 16));
+        low = packPixels565(_mm_adds_epu8(low, threshold));
+        high = packPixels565(_mm_adds_epu8(high, threshold));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packs_epi32(low, high));
+    }
+    return x;
+}
+
+#endif
+
+void convertRGBxToRGB565(const uint8_t *src, int srcStride,
+                         uint16_t *dst, int dstStride,
+                         int width, int height, bool dither){
+#if defined(PIXEL_CONVERT_NEON) || defined(PIXEL_CONVERT_SSE2)
+    int y;
+    for(y = 0; y < height; y++){
+        const uint8_t *srcRow = src + y * srcStride;
+        uint16_t *dstRow = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + y * dstStride);
+        int x = convertRowVector(srcRow, dstRow, width, y, dither);
+        convertRowScalar(srcRow, dstRow, x, width, y, dither);
+    }
+#else
+    convertRGBxToRGB565Scalar(src, srcStride, dst, dstStride, width, height, dither);
+#endif
+}
+
+/*
+ * levels[b][g]: output level of gray g at a pixel whose Bayer value is b.
+ * Without dithering every row rounds to the nearest level.
+ */
+static void buildLevelTable(uint8_t levels[16][256], int maxLevel, bool ordered){
+    int b, g;
+    for(b = 0; b < 16; b++){
+        for(g = 0; g < 256; g++){
+            //floor(g * maxLevel / 255 + (b + 0.5) / 16), or + 0.5 when not dithering
+            int bias = ordered? (2 * b + 1) * 255 : 16 * 255;
+            levels[b][g] = (uint8_t)((32 * g * maxLevel + bias) / (32 * 255));
+        }
+    }
+}
+
+//Puts level into the packed row at pixel x, the row must start zeroed
+static inline void putLevel(uint8_t *row, int x, int bitsPerPixel, int level){
+    int pixelsPerByte = 8 / bitsPerPixel;
+    int shift = 8 - bitsPerPixel * (x % pixelsPerByte + 1);
+    row[x / pixelsPerByte] |= (uint8_t)(level << shift);
+}
+
+#if defined(PIXEL_CONVERT_NEON)
+
+//1 bit rows 16 pixels per step, returns the first pixel left for the scalar tail
+static int packRow1BitVector(const uint8_t *src, uint8_t *dst, int width, const uint8_t thresholds[16]){
+    static const uint8_t kBitWeights[16] = { 128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1 };
+    uint8x16_t threshold = vld1q_u8(thresholds);
+    uint8x16_t weights = vld1q_u8(kBitWeights);
+
+    int x;
+    for(x = 0; x + 16 <= width; x += 16){
+        uint8x16_t bits = vandq_u8(vcgeq_u8(vld1q_u8(src + x), threshold), weights);
+        //Three pairwise adds sum each group of 8 weights into one byte
+        uint8x8_t sums = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+        sums = vpadd_u8(sums, sums);
+        sums = vpadd_u8(sums, sums);
+        dst[x / 8] = vget_lane_u8(sums, 0);
+        dst[x / 8 + 1] = vget_lane_u8(sums, 1);
+    }
+    return x;
+}
+
+#elif defined(PIXEL_CONVERT_SSE2)
+
+//Each byte with its bits in reverse order, built two bits at a time from both ends
+#define REVERSE_BITS_2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define REVERSE_BITS_4(n) REVERSE_BITS_2(n), REVERSE_BITS_2(n + 2 * 16), REVERSE_BITS_2(n + 1 * 16), REVERSE_BITS_2(n + 3 * 16)
+#define REVERSE_BITS_6(n) REVERSE_BITS_4(n), REVERSE_BITS_4(n + 2 * 4), REVERSE_BITS_4(n + 1 * 4), REVERSE_BITS_4(n + 3 * 4)
+static const uint8_t kReversedBits[256] = {
+    REVERSE_BITS_6(0), REVERSE_BITS_6(2), REVERSE_BITS_6(1), REVERSE_BITS_6(3)
+};
+#undef REVERSE_BITS_2
+#undef REVERSE_BITS_4
+#undef REVERSE_BITS_6
+
+//1 bit rows 16 pixels per step, returns the first pixel left for the scalar tail
+static int packRow1BitVector(const uint8_t *src, uint8_t *dst, int width, const uint8_t thresholds[16]){
+    //movemask puts pixel 0 into bit 0, the packed format wants it in bit 7
+    __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds));
+    int x;
+    for(x = 0; x + 16 <= width; x += 16){
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        //gray >= threshold, unsigned
+        __m128i set = _mm_cmpeq_epi8(_mm_max_epu8(gray, threshold), gray);
+        int mask = _mm_movemask_epi8(set);
+        dst[x / 8] = kReversedBits[mask & 0xFF];
+        dst[x / 8 + 1] = kReversedBits[(mask >> 8) & 0xFF];
+    }
+    return x;
+}
+
+#endif
+
+static void packGrayTable(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride,
+                          int width, int height, int bitsPerPixel, bool ordered){
+    uint8_t levels[16][256];
+    buildLevelTable(levels, (1 << bitsPerPixel) - 1, ordered);
+
+    int x, y;
+    for(y = 0; y < height; y++){
+        const uint8_t *srcRow = src + y * srcStride;
+        uint8_t *dstRow = dst + y * dstStride;
+        x = 0;
+
+#if defined(PIXEL_CONVERT_NEON) || defined(PIXEL_CONVERT_SSE2)
+        if(bitsPerPixel == 1){
+            //Smallest gray that reaches level 1, per column of the pattern
+            uint8_t thresholds[16];
+            int i, g;
+            for(i = 0; i < 16; i++){
+                const uint8_t *row = levels[kBayer4x4[y & 3][i & 3]];
+                for(g = 0; g < 255 && row[g] == 0; g++);
+                thresholds[i] = (uint8_t)g;
+            }
+            x = packRow1BitVector(srcRow, dstRow, width, thresholds);
+        }
+#endif
+        int packedStart = x * bitsPerPixel / 8;
+        memset(dstRow + packedStart, 0, (width * bitsPerPixel + 7) / 8 - packedStart);
+        for(; x < width; x++){
+            putLevel(dstRow, x, bitsPerPixel, levels[kBayer4x4[y & 3][x & 3]][srcRow[x]]);
+        }
+    }
+}
+
+static void packGrayFloydSteinberg(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride,
+                                   int width, int height, int bitsPerPixel){
+    int maxLevel = (1 << bitsPerPixel) - 1;
+    //Errors carried into the current and the next row, in 1/16 units, one pixel of margin each side
+    std::vector<int> current(width + 2, 0), next(width + 2, 0);
+
+    int x, y;
+    for(y = 0; y < height; y++){
+        const uint8_t *srcRow = src + y * srcStride;
+        uint8_t *dstRow = dst + y * dstStride;
+        memset(dstRow, 0, (width * bitsPerPixel + 7) / 8);
+        std::fill(next.begin(), next.end(), 0);
+
+        for(x = 0; x < width; x++){
+            int value = srcRow[x] + current[x + 1] / 16;
+            int level;
+            if(value <= 0) level = 0;
+            else if(value >= 255) level = maxLevel;
+            else level = (2 * value * maxLevel + 255) / 510;
+            putLevel(dstRow, x, bitsPerPixel, level);
+
+            int error = value - level * 255 / maxLevel;
+            current[x + 2] += error * 7;
+            next[x] += error * 3;
+            next[x + 1] += error * 5;
+            next[x + 2] += error;
+        }
+        current.swap(next);
+    }
+}
+
+bool packGray(const uint8_t *src, int srcStride,
+              uint8_t *dst, int dstStride,
+              int width, int height, int bitsPerPixel, DitherMode dither){
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4) return false;
+
+    if(dither == DITHER_FLOYD_STEINBERG){
+        packGrayFloydSteinberg(src, srcStride, dst, dstStride, width, height, bitsPerPixel);
+    }else{
+        packGrayTable(src, srcStride, dst, dstStride, width, height, bitsPerPixel, dither == DITHER_ORDERED);
+    }
+    return true;
+}
+
+/*
+ * Bilinear resampling runs in two passes per destination row: the two source
+ * rows are blended into 16 bit sums of the columns the row needs, then each
+ * destination pixel blends two neighbouring sums. The sums drop their lowest
+ * bit so the second pass fits signed 16 bit multiplies; the vector paths do
+ * the exact same integer math as the scalar one.
+ */
+
+//For each destination pixel the left source column and the weight of the right one, 8 bits
+static void buildResampleSteps(int srcSize, int dstSize, double origin, double step,
+                               std::vector<int> &index, std::vector<int> &weight){
+    index.resize(dstSize);
+    weight.resize(dstSize);
+    int64_t maxPos = (int64_t)(srcSize - 1) << 16;
+    int i;
+    for(i = 0; i < dstSize; i++){
+        int64_t pos = (int64_t)floor((origin + i * step) * 65536 + 0.5);
+        if(pos < 0) pos = 0;
+        if(pos > maxPos) pos = maxPos;
+        index[i] = (int)(pos >> 16);
+        weight[i] = (int)((pos >> 8) & 0xff); //8 bits are plenty for 8 bit channels
+    }
+}
+
+static inline void blendRowsScalar(const uint8_t *top, const uint8_t *bottom, int16_t *sums,
+                                   int from, int count, int wy){
+    int i;
+    for(i = from; i < count; i++){
+        sums[i] = (int16_t)((top[i] * (256 - wy) + bottom[i] * wy) >> 1);
+    }
+}
+
+static inline void blendColumnsScalar(const int16_t *sums, uint8_t *dst, int from, int width,
+                                      const int *left, const int *right, const int *weight){
+    int x, c;
+    for(x = from; x < width; x++){
+        const int16_t *l = sums + left[x];
+        const int16_t *r = sums + right[x];
+        int wx = weight[x];
+        for(c = 0; c < 4; c++){
+            dst[x * 4 + c] = (uint8_t)((l[c] * (256 - wx) + r[c] * wx + 16384) >> 15);
+        }
+    }
+}
+
+#if defined(PIXEL_CONVERT_NEON)
+
+//16 bytes per step, returns the first byte left for the scalar tail
+static int blendRowsVector(const uint8_t *top, const uint8_t *bottom, int16_t *sums, int count, int wy){
+    int i;
+    for(i = 0; i + 16 <= count; i += 16){
+        uint8x16_t t = vld1q_u8(top + i);
+        uint8x16_t b = vld1q_u8(bottom + i);
+        uint16x8_t low = vmulq_n_u16(vmovl_u8(vget_low_u8(t)), (uint16_t)(256 - wy));
+        low = vmlaq_n_u16(low, vmovl_u8(vget_low_u8(b)), (uint16_t)wy);
+        uint16x8_t high = vmulq_n_u16(vmovl_u8(vget_high_u8(t)), (uint16_t)(256 - wy));
+        high = vmlaq_n_u16(high, vmovl_u8(vget_high_u8(b)), (uint16_t)wy);
+        vst1q_s16(sums + i, vreinterpretq_s16_u16(vshrq_n_u16(low, 1)));
+        vst1q_s16(sums + i + 8, vreinterpretq_s16_u16(vshrq_n_u16(high, 1)));
+    }
+    return i;
+}
+
+//2 pixels per step, returns the first pixel left for the scalar tail
+static int blendColumnsVector(const int16_t *sums, uint8_t *dst, int width,
+                              const int *left, const int *right, const int *weight){
+    int x;
+    for(x = 0; x + 2 <= width; x += 2){
+        int32x4_t first = vmull_n_s16(vld1_s16(sums + left[x]), (int16_t)(256 - weight[x]));
+        first = vmlal_n_s16(first, vld1_s16(sums + right[x]), (int16_t)weight[x]);
+        int32x4_t second = vmull_n_s16(vld1_s16(sums + left[x + 1]), (int16_t)(256 - weight[x + 1]));
+        second = vmlal_n_s16(second, vld1_s16(sums + right[x + 1]), (int16_t)weight[x + 1]);
+        //Rounding narrow shift, the + 16384 of the scalar path
+        int16x8_t both = vcombine_s16(vrshrn_n_s32(first, 15), vrshrn_n_s32(second, 15));
+        vst1_u8(dst + x * 4, vqmovun_s16(both));
+    }
+    return x;
+}
+
+#elif defined(PIXEL_CONVERT_SSE2)
+
+//16 bytes per step, returns the first byte left for the scalar tail
+static int blendRowsVector(const uint8_t *top, const uint8_t *bottom, int16_t *sums, int count, int wy){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i topWeight = _mm_set1_epi16((short)(256 - wy));
+    const __m128i bottomWeight = _mm_set1_epi16((short)wy);
+    int i;
+    for(i = 0; i + 16 <= count; i += 16){
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i));
+        //At most 255 * 256, the 16 bit products and their sum don't wrap
+        __m128i low = _mm_add_epi16( _mm_mullo_epi16(_mm_unpacklo_epi8(t, zero), topWeight),
+                                     _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), bottomWeight) );
+        __m128i high = _mm_add_epi16( _mm_mullo_epi16(_mm_unpackhi_epi8(t, zero), topWeight),
+                                      _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), bottomWeight) );
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), _mm_srli_epi16(low, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8), _mm_srli_epi16(high, 1));
+    }
+    return i;
+}
+
+//The 4 channels of one pixel as 32 bit sums, left and right interleaved for _mm_madd_epi16
+static inline __m128i blendPixel(const int16_t *sums, int left, int right, int wx){
+    __m128i l = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sums + left));
+    __m128i r = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sums + right));
+    __m128i weights = _mm_set1_epi32((wx << 16) | (256 - wx));
+    __m128i sum = _mm_madd_epi16(_mm_unpacklo_epi16(l, r), weights);
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(16384)), 15);
+}
+
+//4 pixels per step, returns the first pixel left for the scalar tail
+static int blendColumnsVector(const int16_t *sums, uint8_t *dst, int width,
+                              const int *left, const int *right, const int *weight){
+    int x;
+    for(x = 0; x + 4 <= width; x += 4){
+        __m128i p0 = blendPixel(sums, left[x], right[x], weight[x]);
+        __m128i p1 = blendPixel(sums, left[x + 1], right[x + 1], weight[x + 1]);
+        __m128i p2 = blendPixel(sums, left[x + 2], right[x + 2], weight[x + 2]);
+        __m128i p3 = blendPixel(sums, left[x + 3], right[x + 3], weight[x + 3]);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), packed);
+    }
+    return x;
+}
+
+#endif
+
+static void resampleRGBx(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                         uint8_t *dst, int dstStride, int dstWidth, int dstHeight,
+                         double xOrigin, double xStep, double yOrigin, double yStep,
+                         bool vector){
+    if(srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) return;
+
+    std::vector<int> xIndex, xWeight, yIndex, yWeight;
+    buildResampleSteps(srcWidth, dstWidth, xOrigin, xStep, xIndex, xWeight);
+    buildResampleSteps(srcHeight, dstHeight, yOrigin, yStep, yIndex, yWeight);
+
+    //Only the source columns some destination pixel reads get blended
+    int firstColumn = xIndex[0], lastColumn = xIndex[0];
+    int x, y;
+    for(x = 1; x < dstWidth; x++){
+        if(xIndex[x] < firstColumn) firstColumn = xIndex[x];
+        if(xIndex[x] > lastColumn) lastColumn = xIndex[x];
+    }
+    if(lastColumn + 1 < srcWidth) lastColumn++;
+
+    //Offsets of each destination pixel's two columns in the row of sums
+    std::vector<int> left(dstWidth), right(dstWidth);
+    for(x = 0; x < dstWidth; x++){
+        left[x] = (xIndex[x] - firstColumn) * 4;
+        right[x] = (xIndex[x] + 1 < srcWidth)? left[x] + 4 : left[x];
+    }
+
+    int count = (lastColumn - firstColumn + 1) * 4;
+    std::vector<int16_t> sums(count);
+    for(y = 0; y < dstHeight; y++){
+        const uint8_t *top = src + yIndex[y] * srcStride + firstColumn * 4;
+        const uint8_t *bottom = (yIndex[y] + 1 < srcHeight)? top + srcStride : top;
+        uint8_t *dstRow = dst + y * dstStride;
+
+        int blended = 0, done = 0;
+#if defined(PIXEL_CONVERT_NEON) || defined(PIXEL_CONVERT_SSE2)
+        if(vector){
+            blended = blendRowsVector(top, bottom, &sums[0], count, yWeight[y]);
+        }
+#endif
+        blendRowsScalar(top, bottom, &sums[0], blended, count, yWeight[y]);
+#if defined(PIXEL_CONVERT_NEON) || defined(PIXEL_CONVERT_SSE2)
+        if(vector){
+            done = blendColumnsVector(&sums[0], dstRow, dstWidth, &left[0], &right[0], &xWeight[0]);
+        }
+#endif
+        blendColumnsScalar(&sums[0], dstRow, done, dstWidth, &left[0], &right[0], &xWeight[0]);
+    }
+}
+
+void resampleRGBxBilinear(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                          uint8_t *dst, int dstStride, int dstWidth, int dstHeight,
+                          double xOrigin, double xStep, double yOrigin, double yStep){
+    resampleRGBx( src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight,
+                  xOrigin, xStep, yOrigin, yStep, true );
+}
+
+void resampleRGBxBilinearScalar(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                                uint8_t *dst, int dstStride, int dstWidth, int dstHeight,
+                                double xOrigin, double xStep, double yOrigin, double yStep){
+    resampleRGBx( src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight,
+                  xOrigin, xStep, yOrigin, yStep, false );
+}
+
+void scaleRGBxBilinear(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                       uint8_t *dst, int dstStride, int dstWidth, int dstHeight){
+    if(srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) return;
+
+    //Pixel centers aligned: destination pixel i covers source (i + 0.5) * step - 0.5
+    double xStep = (double)srcWidth / dstWidth;
+    double yStep = (double)srcHeight / dstHeight;
+    resampleRGBxBilinear( src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight,
+                          xStep / 2 - 0.5, xStep, yStep / 2 - 0.5, yStep );
+}
@@ -0,0 +1,65 @@
+#ifndef _PIXEL_CONVERT_HPP_
+#define _PIXEL_CONVERT_HPP_
+
+extern "C" {
+    #include <stdint.h>
+}
+
+/*
+ * Packs rows of RGBx bytes (pdfium's BGRx with FPDF_REVERSE_BYTE_ORDER) into
+ * RGB_565 pixels as Android lays them out. Strides are in bytes.
+ * dither adds a 4x4 ordered (Bayer) threshold before truncating, which trades
+ * the banding of smooth gradients for a fine fixed pattern.
+ * Uses NEON or SSE2 when the build targets them.
+ */
+void convertRGBxToRGB565(const uint8_t *src, int srcStride,
+                         uint16_t *dst, int dstStride,
+                         int width, int height, bool dither);
+
+//Plain C version of the above, the reference for the vector paths
+void convertRGBxToRGB565Scalar(const uint8_t *src, int srcStride,
+                               uint16_t *dst, int dstStride,
+                               int width, int height, bool dither);
+
+//Keep in sync with PdfiumCore.DITHER_*
+enum DitherMode {
+    DITHER_NONE = 0,
+    DITHER_ORDERED = 1,
+    DITHER_FLOYD_STEINBERG = 2
+};
+
+/*
+ * Quantizes 8 bit gray rows to 1, 2 or 4 bits per pixel, packed most significant
+ * bits first, the highest level being white. Rows are padded to whole bytes.
+ * Ordered dithering uses the 4x4 Bayer matrix and vectorizes the 1 bit case;
+ * Floyd-Steinberg diffuses the error serially and is scalar only.
+ * False for an unsupported bitsPerPixel.
+ */
+bool packGray(const uint8_t *src, int srcStride,
+              uint8_t *dst, int dstStride,
+              int width, int height, int bitsPerPixel, DitherMode dither);
+
+/*
+ * Stretches rows of 4 byte pixels from srcWidth x srcHeight to dstWidth x dstHeight
+ * with bilinear filtering, pixel centers aligned and edges clamped. Strides are
+ * in bytes, the buffers must not overlap.
+ */
+void scaleRGBxBilinear(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                       uint8_t *dst, int dstStride, int dstWidth, int dstHeight);
+
+/*
+ * General form of the above: destination pixel (x, y) is sampled at source
+ * pixel (xOrigin + x * xStep, yOrigin + y * yStep), integers being pixel
+ * centers, clamped to the edges. Only the source columns sampled are read.
+ * Uses NEON or SSE2 when the build targets them, with the same result.
+ */
+void resampleRGBxBilinear(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                          uint8_t *dst, int dstStride, int dstWidth, int dstHeight,
+                          double xOrigin, double xStep, double yOrigin, double yStep);
+
+//Plain C version of the above, the reference for the vector paths
+void resampleRGBxBilinearScalar(const uint8_t *src, int srcStride, int srcWidth, int srcHeight,
+                                uint8_t *dst, int dstStride, int dstWidth, int dstHeight,
+                                double xOrigin, double xStep, double yOrigin, double yStep);
+
+#endif
@@ -0,0 +1,145 @@
+#include "util.hpp"
+#include "prefetch.hpp"
+
+extern "C" {
+    #include <math.h>
+}
+
+using namespace android;
+
+const float PrefetchScheduler::kLookaheadSeconds = 0.5f;
+const float PrefetchScheduler::kMinVelocity = 0.2f;
+
+PrefetchScheduler::PrefetchScheduler(DocumentFile *doc) :
+        doc(doc),
+        stopped(false),
+        generation(0),
+        direction(0),
+        pageCount(0),
+        pagesAhead(0),
+        jobsTaken(0),
+        activeToken(NULL) {
+
+    plan.pageIndex = -1;
+    plan.fromTop = true;
+    plan.startX = 0;
+    plan.viewHorSize = plan.viewVerSize = 0;
+    plan.dpi = 0;
+    plan.generation = 0;
+
+    //Created under the document lock
+    if(doc->pdfDocument != NULL) pageCount = FPDF_GetPageCount(doc->pdfDocument);
+}
+
+void PrefetchScheduler::update(int pageIndex, int startX, int viewHorSize, int viewVerSize,
+                               int dpi, float velocity){
+    int newDirection = 0;
+    int newPagesAhead = 1;
+    if(fabsf(velocity) >= kMinVelocity){
+        newDirection = (velocity > 0)? 1 : -1;
+        newPagesAhead = (int)ceilf(fabsf(velocity) * kLookaheadSeconds);
+        if(newPagesAhead > kMaxPages) newPagesAhead = kMaxPages;
+        if(newPagesAhead < 1) newPagesAhead = 1;
+    }
+
+    Mutex::Autolock autoLock(lock);
+    if(pageIndex == plan.pageIndex && startX == plan.startX &&
+       viewHorSize == plan.viewHorSize && viewVerSize == plan.viewVerSize &&
+       dpi == plan.dpi && newDirection == direction && newPagesAhead == pagesAhead) return;
+
+    //The tile in flight is of no use after turning around or zooming
+    if(activeToken != NULL && (newDirection * direction < 0 || dpi != plan.dpi)){
+        activeToken->cancel();
+    }
+
+    plan.pageIndex = pageIndex;
+    plan.startX = startX;
+    plan.viewHorSize = viewHorSize;
+    plan.viewVerSize = viewVerSize;
+    plan.dpi = dpi;
+    plan.generation = ++generation;
+    direction = newDirection;
+    pagesAhead = newPagesAhead;
+    jobsTaken = 0;
+    workAvailable.signal();
+}
+
+void PrefetchScheduler::stop(){
+    Mutex::Autolock autoLock(lock);
+    stopped = true;
+    if(activeToken != NULL) activeToken->cancel();
+    workAvailable.broadcast();
+}
+
+bool PrefetchScheduler::nextJob(Job *outJob){
+    Mutex::Autolock autoLock(lock);
+    while(!stopped){
+        //Standing still looks one page both ways, otherwise only ahead
+        int jobCount = (direction == 0)? 2 : pagesAhead;
+        while(jobsTaken < jobCount){
+            int job = jobsTaken++;
+            int step = (direction == 0)? ((job == 0)? 1 : -1) : direction * (job + 1);
+            int pageIndex = plan.pageIndex + step;
+            if(plan.pageIndex < 0 || pageIndex < 0 || pageIndex >= pageCount) continue;
+
+            *outJob = plan;
+            outJob->pageIndex = pageIndex;
+            //Pages scrolled into from above show their top first
+            outJob->fromTop = (step > 0);
+            return true;
+        }
+        workAvailable.wait(lock);
+    }
+    return false;
+}
+
+bool PrefetchScheduler::isCurrent(const Job &job){
+    return !stopped && job.generation == generation;
+}
+
+bool PrefetchScheduler::prefetchTile(const Job &job, int tileIndex){
+    CancelToken token;
+    {
+        Mutex::Autolock autoLock(lock);
+        if(!isCurrent(job)) return false;
+        activeToken = &token;
+    }
+
+    bool rendered = false;
+    PagePin page(doc, job.pageIndex);
+    if(page.get() != NULL){
+        //Same size renderPageTiled gets from getPageWidthPixel/getPageHeightPixel
+        TileKey key;
+        key.pageIndex = job.pageIndex;
+        key.pageWidth = (int)(FPDF_GetPageWidth(page.get()) * job.dpi / 72);
+        key.pageHeight = (int)(FPDF_GetPageHeight(page.get()) * job.dpi / 72);
+
+        //Columns in view at the current horizontal position, a screen of rows at the near end
+        int left = (job.startX < 0)? -job.startX : 0;
+        int right = job.viewHorSize - job.startX;
+        if(right > key.pageWidth) right = key.pageWidth;
+        int top = job.fromTop? 0 : key.pageHeight - job.viewVerSize;
+        if(top < 0) top = 0;
+        int bottom = job.fromTop? job.viewVerSize : key.pageHeight;
+        if(bottom > key.pageHeight) bottom = key.pageHeight;
+
+        const int tileSize = TileCache::kTileSize;
+        if(left < right && top < bottom){
+            int firstColumn = left / tileSize;
+            int columns = (right - 1) / tileSize - firstColumn + 1;
+            int firstRow = top / tileSize;
+            int lastRow = (bottom - 1) / tileSize;
+            int row = tileIndex / columns;
+
+            if(row <= lastRow - firstRow){
+                key.tileX = firstColumn + tileIndex % columns;
+                key.tileY = job.fromTop? firstRow + row : lastRow - row;
+                rendered = prefetchPageTile(&doc->tileCache, page.get(), key, &token);
+            }
+        }
+    }
+
+    Mutex::Autolock autoLock(lock);
+    activeToken = NULL;
+    return rendered && isCurrent(job);
+}
@@ -0,0 +1,81 @@
+#ifndef _PREFETCH_HPP_
+#define _PREFETCH_HPP_
+
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+
+#include "documentFile.hpp"
+#include "renderControl.hpp"
+
+/**
+ * Renders the tiles of the pages a scrolling view is about to reach into the
+ * document's tile cache, so renderPageTiled finds them there.
+ * The UI thread reports position and velocity through update(), which never
+ * waits for the document; a background worker takes one tile at a time with
+ * nextJob()/prefetchTile(), holding the document lock for a single tile only.
+ *
+ * The lookahead grows with the speed, up to kMaxPages pages in the direction of
+ * travel, and covers the part of each page that comes into view first. A
+ * reversal or a zoom change drops the plan and cancels the tile in flight.
+ */
+class PrefetchScheduler {
+    public:
+    static const int kMaxPages = 4;
+    //Pages covered per page/second of velocity
+    static const float kLookaheadSeconds;
+    //Slower than this counts as standing still, which prefetches one page each way
+    static const float kMinVelocity;
+
+    //Snapshot of the plan a worker is carrying out
+    struct Job {
+        int pageIndex;
+        bool fromTop;
+        int startX;
+        int viewHorSize, viewVerSize;
+        int dpi;
+        unsigned int generation;
+    };
+
+    explicit PrefetchScheduler(DocumentFile *doc);
+
+    /*
+     * pageIndex is the page mostly in view and startX its horizontal position
+     * like in renderPageTiled, pages are drawn at dpi. velocity is in pages per
+     * second, positive towards higher page indices.
+     */
+    void update(int pageIndex, int startX, int viewHorSize, int viewVerSize, int dpi, float velocity);
+    //Makes nextJob() return false, cancels the tile in flight
+    void stop();
+
+    //Blocks until there is a page to prefetch, false once stopped
+    bool nextJob(Job *outJob);
+    /*
+     * With the document locked: renders tile tileIndex (in the order they come
+     * into view) of the job's page unless cached. False when the page is done
+     * or the plan changed since the job was taken.
+     */
+    bool prefetchTile(const Job &job, int tileIndex);
+
+    private:
+    PrefetchScheduler(const PrefetchScheduler&); //Disallow copy
+
+    DocumentFile *doc;
+
+    android::Mutex lock;
+    android::Condition workAvailable;
+    bool stopped;
+    //Bumped whenever the plan changes, jobs of an older plan are abandoned
+    unsigned int generation;
+    Job plan;
+    int direction;
+    int pageCount;
+    int pagesAhead;
+    //Pages of the current plan handed out so far
+    int jobsTaken;
+    //Token of the tile being rendered, NULL between tiles
+    CancelToken *activeToken;
+
+    bool isCurrent(const Job &job);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "util.hpp"
+#include "progressiveRender.hpp"
+#include "oomHandler.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+ProgressiveRender::ProgressiveRender(DocumentFile *doc, int pageIndex,
+                                     int canvasHorSize, int canvasVerSize,
+                                     int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                     CancelToken *token) :
+        page(doc, pageIndex),
+        canvasHorSize(canvasHorSize),
+        canvasVerSize(canvasVerSize),
+        startX(startX),
+        startY(startY),
+        drawSizeHor(drawSizeHor),
+        drawSizeVer(drawSizeVer),
+        pixels(NULL),
+        pdfBitmap(NULL),
+        started(false),
+        status(RENDER_FAILED),
+        oomRetried(false),
+        pause(token) {
+
+    if(page.get() == NULL || canvasHorSize <= 0 || canvasVerSize <= 0) return;
+
+    pixels = (unsigned char*)malloc(canvasHorSize * canvasVerSize * 4);
+    if(pixels == NULL){
+        LOGE("Allocating render canvas failed");
+        return;
+    }
+    pdfBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
+                                     FPDFBitmap_BGRA, pixels, canvasHorSize * 4 );
+    if(pdfBitmap == NULL) return;
+
+    clearCanvas();
+    status = RENDER_IN_PROGRESS;
+}
+
+ProgressiveRender::~ProgressiveRender(){
+    closeRender();
+    if(pdfBitmap != NULL) FPDFBitmap_Destroy(pdfBitmap);
+    free(pixels);
+}
+
+void ProgressiveRender::clearCanvas(){
+    if(drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize){
+        FPDFBitmap_FillRect( pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
+                             0x84, 0x84, 0x84, 255); //Gray
+    }
+
+    int baseHorSize = (canvasHorSize < drawSizeHor)? canvasHorSize : drawSizeHor;
+    int baseVerSize = (canvasVerSize < drawSizeVer)? canvasVerSize : drawSizeVer;
+    int baseX = (startX < 0)? 0 : startX;
+    int baseY = (startY < 0)? 0 : startY;
+    FPDFBitmap_FillRect( pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
+                         255, 255, 255, 255); //White
+}
+
+void ProgressiveRender::closeRender(){
+    if(!started) return;
+    FPDF_RenderPage_Close(page.get());
+    started = false;
+}
+
+RenderStatus ProgressiveRender::abort(){
+    closeRender();
+    pause.token->onAborted();
+    status = RENDER_CANCELLED;
+    return status;
+}
+
+RenderStatus ProgressiveRender::renderFor(long budgetMillis){
+    if(status != RENDER_IN_PROGRESS) return status;
+    if(pause.isCancelled()) return abort();
+
+    //Slices may run on different threads, only this one's OOMs concern it
+    OOMRetry oom(&page.getDocument()->pageCache);
+    pause.deadline = currentTimeNanos() + (int64_t)budgetMillis * 1000000LL;
+    int ret;
+    if(!started){
+        started = true;
+        ret = FPDF_RenderPageBitmap_Start( pdfBitmap, page.get(),
+                                           startX, startY,
+                                           drawSizeHor, drawSizeVer,
+                                           0, FPDF_REVERSE_BYTE_ORDER, &pause.iface );
+    }else{
+        ret = FPDF_RenderPage_Continue(page.get(), &pause.iface);
+    }
+    if(ret == FPDF_RENDER_TOBECOUNTINUED){
+        //Paused for a cancel rather than the deadline or a preemption, give up right away
+        return pause.isCancelled()? abort() : status;
+    }
+
+    closeRender();
+    //A pass that ran out of memory leaves an incomplete picture, start over once
+    if(!oomRetried && oom.shouldRetry()){
+        oomRetried = true;
+        clearCanvas();
+        return status;
+    }
+    status = (ret == FPDF_RENDER_DONE)? RENDER_DONE : RENDER_FAILED;
+    return status;
+}
+
+void ProgressiveRender::copyTo(void *dst, int dstStride, int dstHorSize, int dstVerSize) const {
+    if(pixels == NULL) return;
+
+    int rowBytes = ((dstHorSize < canvasHorSize)? dstHorSize : canvasHorSize) * 4;
+    int rows = (dstVerSize < canvasVerSize)? dstVerSize : canvasVerSize;
+    unsigned char *dstRow = reinterpret_cast<unsigned char*>(dst);
+    const unsigned char *srcRow = pixels;
+    int i;
+    for(i = 0; i < rows; i++){
+        memcpy(dstRow, srcRow, rowBytes);
+        dstRow += dstStride;
+        srcRow += canvasHorSize * 4;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _PROGRESSIVE_RENDER_HPP_
+#define _PROGRESSIVE_RENDER_HPP_
+
+#include <fpdfview.h>
+#include <fpdf_progressive.h>
+
+#include "documentFile.hpp"
+#include "renderControl.hpp"
+
+/**
+ * One page rendered across several calls through FPDF_RenderPageBitmap_Start
+ * and FPDF_RenderPage_Continue, each call working for at most a time budget.
+ * Renders into its own RGBA canvas so the picture can be posted at any point,
+ * the part not drawn yet simply stays white.
+ * The page stays pinned until the render is deleted; pdfium keeps one
+ * progressive context per page, so only one render per page at a time.
+ * A cancelled token ends the render within the current slice.
+ */
+class ProgressiveRender {
+    public:
+    //token may be NULL, it must outlive the render otherwise
+    ProgressiveRender(DocumentFile *doc, int pageIndex,
+                      int canvasHorSize, int canvasVerSize,
+                      int startX, int startY, int drawSizeHor, int drawSizeVer,
+                      CancelToken *token);
+    ~ProgressiveRender();
+
+    //Renders for about budgetMillis (at least one step of pdfium's), returns the new status
+    RenderStatus renderFor(long budgetMillis);
+    RenderStatus getStatus() const { return status; }
+
+    //Copies the current picture into an RGBA buffer, clipped to both sizes
+    void copyTo(void *dst, int dstStride, int dstHorSize, int dstVerSize) const;
+
+    private:
+    ProgressiveRender(const ProgressiveRender&); //Disallow copy
+
+    PagePin page;
+    int canvasHorSize, canvasVerSize;
+    int startX, startY;
+    int drawSizeHor, drawSizeVer;
+
+    unsigned char *pixels;
+    FPDF_BITMAP pdfBitmap;
+    //Set while pdfium holds a progressive context for the page
+    bool started;
+    RenderStatus status;
+    //A pass that failed for memory was started over already
+    bool oomRetried;
+    RenderPause pause;
+
+    void clearCanvas();
+    void closeRender();
+    RenderStatus abort();
+};
+
+#endif
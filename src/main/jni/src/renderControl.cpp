@@ -0,0 +1,95 @@
+#include "util.hpp"
+#include "renderControl.hpp"
+#include "jobScheduler.hpp"
+
+extern "C" {
+    #include <time.h>
+}
+
+#include <utils/Mutex.h>
+using namespace android;
+
+int64_t currentTimeNanos(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static Mutex sCancelStatsLock;
+static int64_t sCancelCount = 0;
+static int64_t sCancelTotalNanos = 0;
+static int64_t sCancelMaxNanos = 0;
+
+void CancelToken::cancel(){
+    //Only the first cancel counts for the latency
+    if(!__sync_bool_compare_and_swap(&cancelRequested, 0, 1)) return;
+    cancelTime = currentTimeNanos();
+    __sync_fetch_and_or(&cancelled, 1);
+}
+
+bool CancelToken::isCancelled() const {
+    return __sync_fetch_and_add(const_cast<volatile int*>(&cancelled), 0) != 0;
+}
+
+void CancelToken::onAborted(){
+    if(!isCancelled() || !__sync_bool_compare_and_swap(&aborted, 0, 1)) return;
+    cancelLatency = currentTimeNanos() - cancelTime;
+
+    Mutex::Autolock lock(sCancelStatsLock);
+    sCancelCount++;
+    sCancelTotalNanos += cancelLatency;
+    if(cancelLatency > sCancelMaxNanos) sCancelMaxNanos = cancelLatency;
+}
+
+int64_t CancelToken::getCancelLatency() const {
+    if(__sync_fetch_and_add(const_cast<volatile int*>(&aborted), 0) == 0) return -1;
+    return cancelLatency;
+}
+
+void getCancelLatencyStats(int64_t *count, int64_t *totalNanos, int64_t *maxNanos){
+    Mutex::Autolock lock(sCancelStatsLock);
+    *count = sCancelCount;
+    *totalNanos = sCancelTotalNanos;
+    *maxNanos = sCancelMaxNanos;
+}
+
+RenderPause::RenderPause(CancelToken *token) : deadline(0), token(token), preempted(false) {
+    iface.version = 1;
+    iface.NeedToPauseNow = needToPauseNowCallback;
+    iface.user = NULL;
+}
+
+FPDF_BOOL RenderPause::needToPauseNowCallback(IFSDK_PAUSE *pThis){
+    RenderPause *pause = reinterpret_cast<RenderPause*>(pThis);
+    if(pause->isCancelled()) return 1;
+    pause->preempted = JobScheduler::shouldCurrentJobYield();
+    if(pause->preempted) return 1;
+    return (pause->deadline != 0 && currentTimeNanos() >= pause->deadline)? 1 : 0;
+}
+
+RenderStatus renderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page,
+                              int startX, int startY, int sizeX, int sizeY,
+                              int flags, CancelToken *token){
+    if(token == NULL && !JobScheduler::isCurrentJobPreemptible()){
+        FPDF_RenderPageBitmap(bitmap, page, startX, startY, sizeX, sizeY, 0, flags);
+        return RENDER_DONE;
+    }
+
+    RenderPause pause(token);
+    int ret = RENDER_IN_PROGRESS;
+    if(!pause.isCancelled()){
+        ret = FPDF_RenderPageBitmap_Start(bitmap, page, startX, startY, sizeX, sizeY, 0, flags, &pause.iface);
+        //Without a deadline pdfium only pauses for a cancel or a preemption
+        while(ret == FPDF_RENDER_TOBECOUNTINUED && !pause.isCancelled() && !pause.preempted){
+            ret = FPDF_RenderPage_Continue(page, &pause.iface);
+        }
+        FPDF_RenderPage_Close(page);
+    }
+
+    if(ret == FPDF_RENDER_TOBECOUNTINUED){
+        //A one-shot render can't resume, the preempted job renders it again
+        if(token != NULL) token->onAborted();
+        return RENDER_CANCELLED;
+    }
+    return (ret == FPDF_RENDER_DONE)? RENDER_DONE : RENDER_FAILED;
+}
@@ -0,0 +1,80 @@
+#ifndef _RENDER_CONTROL_HPP_
+#define _RENDER_CONTROL_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+}
+
+#include <fpdfview.h>
+#include <fpdf_progressive.h>
+
+//Monotonic clock in nanoseconds
+int64_t currentTimeNanos();
+
+//Keep in sync with PdfiumCore.RENDER_*
+enum RenderStatus {
+    RENDER_IN_PROGRESS = FPDF_RENDER_TOBECOUNTINUED,
+    RENDER_DONE = FPDF_RENDER_DONE,
+    RENDER_FAILED = FPDF_RENDER_FAILED,
+    RENDER_CANCELLED = 4
+};
+
+/**
+ * Flag a render polls to find out it should stop, set from any thread
+ * without taking the document lock. Also measures how long the render took
+ * to actually give up after the cancel.
+ */
+class CancelToken {
+    public:
+    CancelToken() : cancelRequested(0), cancelled(0), aborted(0), cancelTime(0), cancelLatency(-1) {}
+
+    void cancel();
+    bool isCancelled() const;
+    //Called by the render once it stopped because of the cancel, records the latency
+    void onAborted();
+    //Nanoseconds from cancel() to onAborted(), -1 until then
+    int64_t getCancelLatency() const;
+
+    private:
+    volatile int cancelRequested;
+    volatile int cancelled;
+    volatile int aborted;
+    //Written before cancelled is set, read after it was seen set
+    int64_t cancelTime;
+    int64_t cancelLatency;
+};
+
+//Cancel latencies over all tokens since the library was loaded
+void getCancelLatencyStats(int64_t *count, int64_t *totalNanos, int64_t *maxNanos);
+
+/**
+ * IFSDK_PAUSE that asks pdfium to pause once the deadline passed (0 for none),
+ * the token (may be NULL) was cancelled or more urgent work is waiting for the
+ * job this thread runs, see JobScheduler.
+ */
+struct RenderPause {
+    IFSDK_PAUSE iface;
+    int64_t deadline;
+    CancelToken *token;
+    //Set by the last pause that gave way to more urgent work
+    bool preempted;
+
+    explicit RenderPause(CancelToken *token);
+    bool isCancelled() const { return token != NULL && token->isCancelled(); }
+
+    private:
+    static FPDF_BOOL needToPauseNowCallback(IFSDK_PAUSE *pThis);
+};
+
+/*
+ * FPDF_RenderPageBitmap that gives up as soon as the token is cancelled or the
+ * thread's job is preempted. Without either possibility it is the plain
+ * synchronous call. Returns RENDER_DONE, RENDER_FAILED or RENDER_CANCELLED,
+ * the latter also when preempted (JobScheduler::leave() tells).
+ */
+RenderStatus renderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page,
+                              int startX, int startY, int sizeX, int sizeY,
+                              int flags, CancelToken *token);
+
+#endif
@@ -0,0 +1,294 @@
+#include "util.hpp"
+#include "renderPool.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <string.h>
+    #include <signal.h>
+    #include <poll.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+}
+
+#include <new>
+
+static const int kMaxWorkers = 32;
+//How often a waiting batch looks at its cancel token
+static const int kCancelPollMillis = 20;
+
+struct WorkerReply {
+    int32_t status;
+    int64_t renderNanos;
+};
+
+static int bytesPerPixel(PixelFormat format){
+    return (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+}
+
+//No SIGPIPE if the other side is gone, that just fails
+static bool sendFully(int fd, const void *data, size_t size){
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    while(size > 0){
+        ssize_t ret = send(fd, src, size, MSG_NOSIGNAL);
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            return false;
+        }
+        src += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+//False on error or when the other side closed
+static bool recvFully(int fd, void *data, size_t size){
+    unsigned char *dst = reinterpret_cast<unsigned char*>(data);
+    while(size > 0){
+        ssize_t ret = recv(fd, dst, size, 0);
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            return false;
+        }
+        if(ret == 0) return false;
+        dst += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+RenderPool::RenderPool(int workerCount, void *shared, size_t slotSize) :
+        workerCount(0),
+        workers(new Worker[workerCount]),
+        shared(shared),
+        sharedSize(slotSize * workerCount),
+        slotSize(slotSize),
+        maxPixelBytes(slotSize - sizeof(Slot)) {
+
+    stats.jobs = 0;
+    stats.batchNanos = 0;
+    stats.renderNanos = 0;
+}
+
+RenderPool* RenderPool::start(DocumentFile *doc, int workerCount, int maxWidth, int maxHeight){
+    if(doc == NULL || doc->pdfDocument == NULL || maxWidth <= 0 || maxHeight <= 0) return NULL;
+    if(workerCount < 1) workerCount = 1;
+    if(workerCount > kMaxWorkers) workerCount = kMaxWorkers;
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t slotSize = sizeof(Slot) + (size_t)maxWidth * maxHeight * 4;
+    slotSize = (slotSize + pageSize - 1) / pageSize * pageSize;
+
+    //Made before the fork, so parent and children see the same pages
+    void *shared = mmap(NULL, slotSize * workerCount, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED){
+        LOGE("Mapping render pool slots failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    RenderPool *pool = new RenderPool(workerCount, shared, slotSize);
+    int i;
+    for(i = 0; i < workerCount; i++){
+        int sockets[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0){
+            LOGE("Creating worker socket failed: %s", strerror(errno));
+            break;
+        }
+        //Processes the app execs must not keep the workers' sockets open
+        fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+        fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+        Slot *slot = pool->getSlot(i);
+        new (slot) Slot();
+
+        pid_t pid = fork();
+        if(pid == 0){
+            //Only the parent may talk to the other workers
+            int j;
+            for(j = 0; j < pool->workerCount; j++) close(pool->workers[j].fd);
+            //Now the parent holds the only other end: it closing, or dying, ends the worker
+            close(sockets[0]);
+            workerMain(doc, sockets[1], slot, pool->getSlotPixels(i), pool->maxPixelBytes);
+        }
+        close(sockets[1]);
+        if(pid < 0){
+            LOGE("Starting render worker failed: %s", strerror(errno));
+            close(sockets[0]);
+            break;
+        }
+
+        Worker &worker = pool->workers[pool->workerCount++];
+        worker.pid = pid;
+        worker.fd = sockets[0];
+        worker.jobIndex = -1;
+        worker.stride = 0;
+    }
+
+    if(pool->workerCount == 0){
+        delete pool;
+        return NULL;
+    }
+    LOGD("Render pool started with %d workers", pool->workerCount);
+    return pool;
+}
+
+RenderPool::~RenderPool(){
+    int i;
+    for(i = 0; i < workerCount; i++) retireWorker(i);
+    delete[] workers;
+    munmap(shared, sharedSize);
+}
+
+RenderPool::Slot* RenderPool::getSlot(int worker) const {
+    return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(shared) + worker * slotSize);
+}
+
+unsigned char* RenderPool::getSlotPixels(int worker) const {
+    return reinterpret_cast<unsigned char*>(getSlot(worker)) + sizeof(Slot);
+}
+
+void RenderPool::retireWorker(int worker){
+    Worker &w = workers[worker];
+    if(w.fd < 0) return;
+
+    //Nothing of the child outlives it, no need to wait for a render to finish
+    close(w.fd);
+    w.fd = -1;
+    kill(w.pid, SIGKILL);
+    while(waitpid(w.pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+bool RenderPool::dispatch(int worker, int jobIndex, const Job &job){
+    Worker &w = workers[worker];
+    //The previous job is answered, nobody reads the token anymore
+    new (&getSlot(worker)->token) CancelToken();
+    if(!sendFully(w.fd, &job, sizeof(job))){
+        LOGE("Render worker %d is gone", (int)w.pid);
+        retireWorker(worker);
+        return false;
+    }
+    w.jobIndex = jobIndex;
+    w.stride = job.width * bytesPerPixel(job.format);
+    return true;
+}
+
+void RenderPool::run(const Job *jobs, int count, ResultSink *sink, CancelToken *token){
+    int64_t batchStart = currentTimeNanos();
+    struct pollfd *fds = new struct pollfd[workerCount];
+    int *fdWorkers = new int[workerCount];
+    int next = 0;
+    bool cancelled = false;
+
+    while(true){
+        if(!cancelled && token != NULL && token->isCancelled()){
+            cancelled = true;
+            int i;
+            for(i = 0; i < workerCount; i++){
+                if(workers[i].jobIndex >= 0) getSlot(i)->token.cancel();
+            }
+        }
+
+        //Hand out jobs to the idle workers
+        int i, busy = 0;
+        for(i = 0; i < workerCount; i++){
+            Worker &w = workers[i];
+            while(w.fd >= 0 && w.jobIndex < 0 && next < count && !cancelled){
+                const Job &job = jobs[next];
+                if(job.width <= 0 || job.height <= 0 ||
+                   (size_t)job.width * job.height * bytesPerPixel(job.format) > maxPixelBytes){
+                    LOGE("Render pool job %d doesn't fit a slot", next);
+                    sink->onResult(next++, RENDER_FAILED, NULL, 0);
+                    continue;
+                }
+                if(!dispatch(i, next, job)) break;
+                next++;
+            }
+            if(w.fd >= 0 && w.jobIndex >= 0){
+                fds[busy].fd = w.fd;
+                fds[busy].events = POLLIN;
+                fds[busy].revents = 0;
+                fdWorkers[busy++] = i;
+            }
+        }
+
+        if(busy == 0){
+            //Cancelled, done, or all workers died
+            RenderStatus rest = cancelled? RENDER_CANCELLED : RENDER_FAILED;
+            if(!cancelled && next < count) LOGE("No render workers left, %d jobs failed", count - next);
+            while(next < count) sink->onResult(next++, rest, NULL, 0);
+            break;
+        }
+
+        int ret = poll(fds, busy, (token != NULL && !cancelled)? kCancelPollMillis : -1);
+        if(ret < 0 && errno != EINTR){
+            LOGE("Waiting for render workers failed: %s", strerror(errno));
+            break;
+        }
+
+        for(i = 0; i < busy && ret > 0; i++){
+            if(fds[i].revents == 0) continue;
+            int worker = fdWorkers[i];
+            Worker &w = workers[worker];
+            int jobIndex = w.jobIndex;
+            w.jobIndex = -1;
+
+            WorkerReply reply;
+            if(!recvFully(w.fd, &reply, sizeof(reply))){
+                LOGE("Render worker %d died on job %d", (int)w.pid, jobIndex);
+                retireWorker(worker);
+                sink->onResult(jobIndex, RENDER_FAILED, NULL, 0);
+                continue;
+            }
+            stats.renderNanos += reply.renderNanos;
+            RenderStatus status = (RenderStatus)reply.status;
+            sink->onResult(jobIndex, status, (status == RENDER_DONE)? getSlotPixels(worker) : NULL, w.stride);
+        }
+    }
+
+    //An error above may leave jobs in flight, their workers can't be trusted anymore
+    int i;
+    for(i = 0; i < workerCount; i++){
+        if(workers[i].jobIndex < 0) continue;
+        sink->onResult(workers[i].jobIndex, RENDER_FAILED, NULL, 0);
+        workers[i].jobIndex = -1;
+        retireWorker(i);
+    }
+    while(next < count) sink->onResult(next++, RENDER_FAILED, NULL, 0);
+
+    delete[] fds;
+    delete[] fdWorkers;
+    stats.jobs += count;
+    stats.batchNanos += currentTimeNanos() - batchStart;
+}
+
+//The child's whole life, never returns
+void RenderPool::workerMain(DocumentFile *doc, int fd, Slot *slot, unsigned char *pixels, size_t maxPixelBytes){
+    FPDF_PAGE page = NULL;
+    int loadedIndex = -1;
+    Job job;
+
+    while(recvFully(fd, &job, sizeof(job))){
+        WorkerReply reply;
+        reply.status = RENDER_FAILED;
+        int64_t start = currentTimeNanos();
+
+        //Consecutive regions of one page keep it loaded
+        if(job.pageIndex != loadedIndex){
+            if(page != NULL) FPDF_ClosePage(page);
+            page = FPDF_LoadPage(doc->pdfDocument, job.pageIndex);
+            loadedIndex = (page != NULL)? job.pageIndex : -1;
+        }
+        int stride = job.width * bytesPerPixel(job.format);
+        if(page != NULL && (size_t)stride * job.height <= maxPixelBytes){
+            reply.status = renderPageToBuffer( page, pixels, job.width, job.height, stride, job.format,
+                                               job.startX, job.startY, job.drawSizeHor, job.drawSizeVer,
+                                               &slot->token );
+        }
+
+        reply.renderNanos = currentTimeNanos() - start;
+        if(!sendFully(fd, &reply, sizeof(reply))) break;
+    }
+    _exit(0);
+}
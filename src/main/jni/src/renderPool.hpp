@@ -0,0 +1,107 @@
+#ifndef _RENDER_POOL_HPP_
+#define _RENDER_POOL_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+    #include <sys/types.h>
+}
+
+#include "documentFile.hpp"
+#include "renderControl.hpp"
+#include "bitmapRender.hpp"
+
+/**
+ * Batch rendering of one document on all cores. pdfium's global state can't
+ * be shared between threads, so the workers are forked child processes, each
+ * with its own copy of the document: the file mapping is shared through the
+ * page cache and everything pdfium builds from it is copied on write.
+ *
+ * Jobs go to the workers over a socket; each worker renders into its own slot
+ * of a shared anonymous mapping made before the fork and answers with the
+ * status, the parent then hands the slot's pixels to a ResultSink.
+ * Children never touch the VM and leave with _exit() once their socket is
+ * closed, which also happens when the parent dies. PR_SET_PDEATHSIG isn't used:
+ * it fires when the forking thread exits, not the process.
+ */
+class RenderPool {
+    public:
+    //A page region, placed like renderPageToBuffer's arguments
+    struct Job {
+        int pageIndex;
+        int width, height;
+        PixelFormat format;
+        int startX, startY;
+        int drawSizeHor, drawSizeVer;
+    };
+
+    class ResultSink {
+        public:
+        virtual ~ResultSink() { }
+        //pixels is only valid during the call and NULL unless status is RENDER_DONE
+        virtual void onResult(int jobIndex, RenderStatus status, const void *pixels, int stride) = 0;
+    };
+
+    //Totals over all batches, renderNanos / batchNanos is the parallelism achieved
+    struct Stats {
+        int64_t jobs;
+        int64_t batchNanos;
+        int64_t renderNanos;
+    };
+
+    /*
+     * With every open document locked and none being opened, so no other
+     * thread is inside pdfium: the children start as a copy of this moment
+     * (see PdfiumCore.newRenderPool). Jobs may be up to
+     * maxWidth x maxHeight RGBA pixels. NULL if no worker could be started.
+     */
+    static RenderPool* start(DocumentFile *doc, int workerCount, int maxWidth, int maxHeight);
+    //Stops the workers and waits for them to exit
+    ~RenderPool();
+
+    int getWorkerCount() const { return workerCount; }
+    /*
+     * Runs the jobs on the workers, results arrive in completion order. Doesn't
+     * need the document lock, the workers don't share anything with it.
+     * Jobs left when the token gets cancelled are reported RENDER_CANCELLED,
+     * jobs of a worker that died RENDER_FAILED.
+     */
+    void run(const Job *jobs, int count, ResultSink *sink, CancelToken *token);
+    Stats getStats() const { return stats; }
+
+    private:
+    struct Worker {
+        pid_t pid;
+        //Parent end of the socket pair, -1 once the worker is gone
+        int fd;
+        //In-flight job, -1 when idle
+        int jobIndex;
+        int stride;
+    };
+
+    //Head of each slot in the shared mapping, the pixels follow
+    struct Slot {
+        //Placed anew for every job, cancelled by the parent
+        CancelToken token;
+    };
+
+    RenderPool(int workerCount, void *shared, size_t slotSize);
+    RenderPool(const RenderPool&); //Disallow copy
+
+    int workerCount;
+    Worker *workers;
+    void *shared;
+    size_t sharedSize;
+    size_t slotSize;
+    size_t maxPixelBytes;
+    Stats stats;
+
+    Slot* getSlot(int worker) const;
+    unsigned char* getSlotPixels(int worker) const;
+    bool dispatch(int worker, int jobIndex, const Job &job);
+    void retireWorker(int worker);
+
+    static void workerMain(DocumentFile *doc, int fd, Slot *slot, unsigned char *pixels, size_t maxPixelBytes);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "scratchBuffer.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+}
+
+#include <utils/Mutex.h>
+using namespace android;
+
+static Mutex sIdleLock;
+static void *sIdleData = NULL;
+static size_t sIdleCapacity = 0;
+
+ScratchBuffer::ScratchBuffer(size_t size) : data(NULL), capacity(0) {
+    {
+        Mutex::Autolock lock(sIdleLock);
+        if(sIdleData != NULL && sIdleCapacity >= size){
+            data = sIdleData;
+            capacity = sIdleCapacity;
+            sIdleData = NULL;
+            sIdleCapacity = 0;
+            return;
+        }
+    }
+
+    if( (data = malloc(size)) != NULL ) capacity = size;
+}
+
+ScratchBuffer::~ScratchBuffer(){
+    if(data == NULL) return;
+
+    void *unused = data;
+    {
+        Mutex::Autolock lock(sIdleLock);
+        if(capacity > sIdleCapacity){
+            unused = sIdleData;
+            sIdleData = data;
+            sIdleCapacity = capacity;
+        }
+    }
+    free(unused);
+}
+
+size_t trimScratchBuffers(){
+    void *unused;
+    size_t released;
+    {
+        Mutex::Autolock lock(sIdleLock);
+        unused = sIdleData;
+        released = sIdleCapacity;
+        sIdleData = NULL;
+        sIdleCapacity = 0;
+    }
+    free(unused);
+    return released;
+}
@@ -0,0 +1,31 @@
+#ifndef _SCRATCH_BUFFER_HPP_
+#define _SCRATCH_BUFFER_HPP_
+
+extern "C" {
+    #include <stddef.h>
+}
+
+/**
+ * Temporary memory for one render, e.g. the 32 bit picture a 16 bit output is
+ * converted from. The process keeps the largest released buffer around for the
+ * next user instead of allocating a frame sized buffer for every render.
+ * get() is NULL if the allocation failed.
+ */
+class ScratchBuffer {
+    public:
+    explicit ScratchBuffer(size_t size);
+    ~ScratchBuffer();
+
+    void* get() const { return data; }
+
+    private:
+    ScratchBuffer(const ScratchBuffer&); //Disallow copy
+
+    void *data;
+    size_t capacity;
+};
+
+//Frees the idle buffer, returns the bytes released
+size_t trimScratchBuffers();
+
+#endif
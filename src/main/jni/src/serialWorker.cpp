@@ -0,0 +1,102 @@
+#include "util.hpp"
+#include "serialWorker.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+using namespace android;
+
+SerialWorker::SerialWorker(JavaVM *vm, const char *name) :
+        vm(vm),
+        name(name),
+        quitting(false),
+        detached(false) {}
+
+SerialWorker::~SerialWorker(){}
+
+SerialWorker* SerialWorker::start(JavaVM *vm, const char *name){
+    SerialWorker *worker = new SerialWorker(vm, name);
+    int ret = pthread_create(&worker->thread, NULL, threadEntry, worker);
+    if(ret != 0){
+        LOGE("Starting worker thread failed: %s", strerror(ret));
+        delete worker;
+        return NULL;
+    }
+    return worker;
+}
+
+bool SerialWorker::post(JNIEnv *env, Task *task){
+    {
+        Mutex::Autolock autoLock(lock);
+        if(!quitting){
+            tasks.push_back(task);
+            taskPosted.signal();
+            return true;
+        }
+    }
+    task->discard(env);
+    delete task;
+    return false;
+}
+
+void SerialWorker::quit(JNIEnv *env){
+    std::deque<Task*> pending;
+    bool ownThread = pthread_equal(pthread_self(), thread);
+    {
+        Mutex::Autolock autoLock(lock);
+        quitting = true;
+        detached = ownThread;
+        pending.swap(tasks);
+        taskPosted.signal();
+    }
+
+    for(std::deque<Task*>::iterator it = pending.begin(); it != pending.end(); ++it){
+        (*it)->discard(env);
+        delete *it;
+    }
+
+    if(ownThread){
+        pthread_detach(thread);
+        return;
+    }
+    pthread_join(thread, NULL);
+    delete this;
+}
+
+void SerialWorker::loop(){
+    JNIEnv *env;
+    JavaVMAttachArgs attachArgs;
+    attachArgs.version = JNI_VERSION_1_6;
+    attachArgs.name = name.c_str();
+    attachArgs.group = NULL;
+    if(vm->AttachCurrentThread(&env, &attachArgs) != JNI_OK){
+        LOGE("Attaching worker thread failed");
+        env = NULL;
+    }
+
+    lock.lock();
+    while(true){
+        while(!quitting && tasks.empty()) taskPosted.wait(lock);
+        if(quitting) break;
+
+        Task *task = tasks.front();
+        tasks.pop_front();
+        lock.unlock();
+
+        if(env != NULL) task->run(env);
+        delete task;
+
+        lock.lock();
+    }
+    bool freeSelf = detached;
+    lock.unlock();
+
+    if(env != NULL) vm->DetachCurrentThread();
+    if(freeSelf) delete this;
+}
+
+void* SerialWorker::threadEntry(void *arg){
+    reinterpret_cast<SerialWorker*>(arg)->loop();
+    return NULL;
+}
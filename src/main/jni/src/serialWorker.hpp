@@ -0,0 +1,66 @@
+#ifndef _SERIAL_WORKER_HPP_
+#define _SERIAL_WORKER_HPP_
+
+extern "C" {
+    #include <pthread.h>
+}
+
+#include <deque>
+#include <string>
+
+#include <jni.h>
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+
+/**
+ * A thread running posted tasks one after the other, in order. Each document
+ * gets one, so everything done to a document happens on its thread and
+ * documents don't wait for each other. The thread is attached to the VM for
+ * the tasks' JNI calls.
+ * utils/Thread.h and utils/Looper.h live in libutils, which isn't linked;
+ * this is the part of them needed here, on pthreads and the header only
+ * Mutex/Condition.
+ */
+class SerialWorker {
+    public:
+    class Task {
+        public:
+        virtual ~Task() { }
+        virtual void run(JNIEnv *env) = 0;
+        //Dropped without running because the worker quit
+        virtual void discard(JNIEnv *env) = 0;
+    };
+
+    //NULL if the thread couldn't be started
+    static SerialWorker* start(JavaVM *vm, const char *name);
+
+    //Takes over the task; false if the worker is quitting, the task was discarded then
+    bool post(JNIEnv *env, Task *task);
+    /*
+     * Discards the pending tasks, waits for the running one and frees the worker.
+     * From a task of this worker it returns right away, the worker frees
+     * itself once that task is done.
+     */
+    void quit(JNIEnv *env);
+
+    private:
+    SerialWorker(JavaVM *vm, const char *name);
+    ~SerialWorker();
+    SerialWorker(const SerialWorker&); //Disallow copy
+
+    JavaVM *vm;
+    std::string name;
+    pthread_t thread;
+
+    android::Mutex lock;
+    android::Condition taskPosted;
+    std::deque<Task*> tasks;
+    bool quitting;
+    //Set when quit() came from the worker's own thread, nobody joins it then
+    bool detached;
+
+    void loop();
+    static void* threadEntry(void *arg);
+};
+
+#endif
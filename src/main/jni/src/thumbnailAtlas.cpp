@@ -0,0 +1,135 @@
+#include "util.hpp"
+#include "thumbnailAtlas.hpp"
+
+extern "C" {
+    #include <unistd.h>
+    #include <errno.h>
+    #include <string.h>
+}
+
+#include <vector>
+
+#include <utils/Flattenable.h>
+using namespace android;
+
+static bool writeFully(int fd, const void *data, size_t size, off_t offset){
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    while(size > 0){
+        ssize_t ret = pwrite(fd, src, size, offset);
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            LOGE("Writing atlas failed: %s", strerror(errno));
+            return false;
+        }
+        src += ret;
+        offset += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+static bool writeIndex(int fd, PixelFormat format, const std::vector<AtlasEntry> &entries){
+    AtlasHeader header;
+    header.magic = kAtlasMagic;
+    header.version = kAtlasVersion;
+    header.format = (uint32_t)format;
+    header.entryCount = (uint32_t)entries.size();
+
+    if(!writeFully(fd, &header, sizeof(header), 0)) return false;
+    return entries.empty() || writeFully(fd, &entries[0], entries.size() * sizeof(AtlasEntry), sizeof(header));
+}
+
+int renderThumbnailAtlas(DocumentFile *doc, int fromIndex, int toIndex,
+                         int targetWidth, PixelFormat format, int fd,
+                         CancelToken *token, AtlasCallbacks *callbacks){
+    if(doc == NULL || targetWidth <= 0 || fromIndex > toIndex) return -1;
+    int bytesPerPixel = (format == PIXEL_FORMAT_RGBA_8888)? 4 : 2;
+
+    //Lay the whole file out first, page sizes don't need the pages loaded
+    std::vector<AtlasEntry> entries;
+    size_t offset = FlattenableUtils::align<8>(sizeof(AtlasHeader) +
+                                               (toIndex - fromIndex + 1) * sizeof(AtlasEntry));
+    size_t maxImageSize = 0;
+    if(!callbacks->lockDocument()) return -1;
+    int i;
+    for(i = fromIndex; i <= toIndex; i++){
+        AtlasEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.pageIndex = i;
+
+        double width, height;
+        if(FPDF_GetPageSizeByIndex(doc->pdfDocument, i, &width, &height) && width > 0){
+            entry.width = targetWidth;
+            entry.height = (int32_t)(height * targetWidth / width + 0.5);
+            if(entry.height < 1) entry.height = 1;
+            entry.offset = (int64_t)offset;
+
+            size_t imageSize = (size_t)entry.width * entry.height * bytesPerPixel;
+            offset += FlattenableUtils::align<8>(imageSize);
+            if(imageSize > maxImageSize) maxImageSize = imageSize;
+        }
+        entries.push_back(entry);
+    }
+    callbacks->unlockDocument();
+
+    if(ftruncate(fd, (off_t)offset) != 0 || !writeIndex(fd, format, entries)){
+        LOGE("Preparing atlas failed: %s", strerror(errno));
+        return -1;
+    }
+
+    //One buffer reused for every page
+    void *pixels = malloc((maxImageSize > 0)? maxImageSize : 1);
+    if(pixels == NULL){
+        LOGE("Allocating thumbnail buffer failed");
+        return -1;
+    }
+
+    int rendered = 0;
+    int total = (int)entries.size();
+    bool failed = false;
+    for(i = 0; i < total && !failed; i++){
+        if(token != NULL && token->isCancelled()) break;
+        AtlasEntry &entry = entries[i];
+
+        if(entry.width > 0){
+            RenderStatus status;
+            bool preempted;
+            do{
+                if(!callbacks->lockDocument()){
+                    failed = true;
+                    break;
+                }
+                bool wasLoaded = doc->pageCache.contains(entry.pageIndex);
+                {
+                    PagePin page(doc, entry.pageIndex);
+                    status = renderPageToBuffer( page.get(), pixels,
+                                                 entry.width, entry.height, entry.width * bytesPerPixel, format,
+                                                 0, 0, entry.width, entry.height, token );
+                }
+                if(!wasLoaded) doc->pageCache.close(entry.pageIndex);
+                preempted = callbacks->unlockDocument();
+            }while(preempted && status == RENDER_CANCELLED && (token == NULL || !token->isCancelled()));
+            if(failed) break;
+
+            if(status == RENDER_DONE){
+                if(writeFully(fd, pixels, (size_t)entry.width * entry.height * bytesPerPixel, (off_t)entry.offset)){
+                    entry.flags |= ATLAS_ENTRY_RENDERED;
+                    rendered++;
+                }else{
+                    failed = true;
+                }
+            }
+        }
+
+        callbacks->onProgress(entry.pageIndex, i + 1, total);
+    }
+    free(pixels);
+
+    //The flags are only known now
+    if(failed || !writeIndex(fd, format, entries)) return -1;
+    if(token != NULL && token->isCancelled()){
+        token->onAborted();
+        return -1;
+    }
+    return rendered;
+}
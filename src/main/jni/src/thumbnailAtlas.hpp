@@ -0,0 +1,63 @@
+#ifndef _THUMBNAIL_ATLAS_HPP_
+#define _THUMBNAIL_ATLAS_HPP_
+
+extern "C" {
+    #include <stdint.h>
+}
+
+#include "documentFile.hpp"
+#include "bitmapRender.hpp"
+#include "renderControl.hpp"
+
+/**
+ * Layout of a thumbnail atlas file, read back by ThumbnailAtlas.java:
+ * an AtlasHeader, entryCount AtlasEntry records, then the pixels of every
+ * rendered page packed row after row without padding. Native byte order.
+ */
+struct AtlasHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t entryCount;
+};
+struct AtlasEntry {
+    int32_t pageIndex;
+    int32_t width;
+    int32_t height;
+    //ATLAS_ENTRY_* bits
+    int32_t flags;
+    int64_t offset;
+};
+
+static const uint32_t kAtlasMagic = ('_' << 24) + ('P' << 16) + ('T' << 8) + 'A';
+static const uint32_t kAtlasVersion = 1;
+static const int32_t ATLAS_ENTRY_RENDERED = 0x1;
+
+/**
+ * Hooks into the caller while a batch runs. The document is only used between
+ * lockDocument() and unlockDocument(), one page at a time, so other renders
+ * can get in between pages. lockDocument() returns false, without locking,
+ * once the document was closed meanwhile.
+ */
+class AtlasCallbacks {
+    public:
+    virtual ~AtlasCallbacks() {}
+    virtual bool lockDocument() = 0;
+    //True if more urgent work preempted what was rendered under the lock, it is redone then
+    virtual bool unlockDocument() = 0;
+    //Called without the document locked after every page, rendered or not
+    virtual void onProgress(int pageIndex, int done, int total) = 0;
+};
+
+/*
+ * Renders pages fromIndex..toIndex scaled to targetWidth into an atlas written to fd.
+ * Pages that weren't loaded before are closed right after rendering, so memory
+ * stays flat however many pages there are.
+ * Returns the number of pages rendered, -1 if the atlas couldn't be written
+ * or the token was cancelled.
+ */
+int renderThumbnailAtlas(DocumentFile *doc, int fromIndex, int toIndex,
+                         int targetWidth, PixelFormat format, int fd,
+                         CancelToken *token, AtlasCallbacks *callbacks);
+
+#endif
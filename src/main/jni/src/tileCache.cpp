@@ -0,0 +1,213 @@
+#include "util.hpp"
+#include "tileCache.hpp"
+#include "oomHandler.hpp"
+
+extern "C" {
+    #include <string.h>
+}
+
+using namespace android;
+
+TileCache::TileCache(size_t maxBytes) :
+        tiles(maxBytes),
+        tileFreer(&stats) {
+    memset(&stats, 0, sizeof(stats));
+    tiles.setOnEntryRemovedListener(&tileFreer);
+}
+
+TileCache::~TileCache(){
+    clear();
+}
+
+static void copyRows(unsigned char *dst, int dstStride,
+                     const unsigned char *src, int srcStride,
+                     int rowBytes, int rows){
+    int i;
+    for(i = 0; i < rows; i++){
+        memcpy(dst, src, rowBytes);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+bool TileCache::contains(const TileKey &key){
+    Mutex::Autolock lock(cacheLock);
+    return tiles.contains(key);
+}
+
+bool TileCache::draw(const TileKey &key, int srcX, int srcY, int width, int height,
+                     unsigned char *dst, int dstStride){
+    //Copy under the lock, the tile may be evicted by another thread right after
+    Mutex::Autolock lock(cacheLock);
+    Tile *tile = tiles.getPointer(key);
+    if(tile == NULL){
+        stats.misses++;
+        return false;
+    }
+
+    stats.hits++;
+    if(tile->prefetched){
+        stats.prefetchUsed++;
+        tile->prefetched = false;
+    }
+    int tileStride = tile->width * 4;
+    copyRows(dst, dstStride, tile->pixels + srcY * tileStride + srcX * 4, tileStride, width * 4, height);
+    return true;
+}
+
+void TileCache::put(const TileKey &key, const Tile &tile){
+    Mutex::Autolock lock(cacheLock);
+    if(tile.prefetched) stats.prefetched++;
+    if(tiles.getMaxCost() == 0 || !tiles.put(key, tile, (size_t)(tile.width * tile.height * 4))){
+        free(tile.pixels);
+    }
+}
+
+void TileCache::setMaxBytes(size_t maxBytes){
+    Mutex::Autolock lock(cacheLock);
+    tiles.setMaxCost(maxBytes);
+}
+
+size_t TileCache::getMaxBytes(){
+    Mutex::Autolock lock(cacheLock);
+    return tiles.getMaxCost();
+}
+
+int TileCache::trim(size_t keepBytes){
+    Mutex::Autolock lock(cacheLock);
+    size_t before = tiles.size();
+    tiles.trimToCost(keepBytes);
+    return (int)(before - tiles.size());
+}
+
+void TileCache::clear(){
+    Mutex::Autolock lock(cacheLock);
+    tiles.clear();
+}
+
+void TileCache::getStats(Stats *outStats){
+    Mutex::Autolock lock(cacheLock);
+    *outStats = stats;
+}
+
+//Renders the tile's part of the page into a new RGBA buffer
+static bool renderTile(FPDF_PAGE page, const TileKey &key, int width, int height,
+                       CancelToken *token, TileCache::Tile *tile){
+    unsigned char *pixels = (unsigned char*)malloc(width * height * 4);
+    if(pixels == NULL){
+        LOGE("Allocating tile failed");
+        return false;
+    }
+
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(width, height, FPDFBitmap_BGRA, pixels, width * 4);
+    if(pdfBitmap == NULL){
+        free(pixels);
+        return false;
+    }
+
+    //Not under any cache lock, the OOM retry may trim the tile cache
+    RenderStatus status;
+    OOMRetry oom;
+    do{
+        FPDFBitmap_FillRect(pdfBitmap, 0, 0, width, height, 255, 255, 255, 255); //White
+        status = renderPageBitmap( pdfBitmap, page,
+                                   -key.tileX * TileCache::kTileSize, -key.tileY * TileCache::kTileSize,
+                                   key.pageWidth, key.pageHeight,
+                                   FPDF_REVERSE_BYTE_ORDER, token );
+    }while(status == RENDER_FAILED && oom.shouldRetry());
+    FPDFBitmap_Destroy(pdfBitmap);
+
+    //Half a tile, or a blank one from a failed render, must not end up in the cache
+    if(status != RENDER_DONE){
+        free(pixels);
+        return false;
+    }
+
+    tile->width = width;
+    tile->height = height;
+    tile->pixels = pixels;
+    tile->prefetched = false;
+    return true;
+}
+
+//Edge tiles are cut at the page border
+static int tileExtent(int tileIndex, int pageSize){
+    int tileStart = tileIndex * TileCache::kTileSize;
+    return (tileStart + TileCache::kTileSize < pageSize)? TileCache::kTileSize : pageSize - tileStart;
+}
+
+int drawPageTiles(TileCache *cache, FPDF_PAGE page, int pageIndex,
+                  void *canvas, int canvasStride, int canvasHorSize, int canvasVerSize,
+                  int startX, int startY, int drawSizeHor, int drawSizeVer,
+                  CancelToken *token){
+    const int tileSize = TileCache::kTileSize;
+    unsigned char *canvasBits = reinterpret_cast<unsigned char*>(canvas);
+
+    if(startX > 0 || startY > 0 ||
+       startX + drawSizeHor < canvasHorSize || startY + drawSizeVer < canvasVerSize){
+        FPDF_BITMAP canvasBitmap = FPDFBitmap_CreateEx( canvasHorSize, canvasVerSize,
+                                                        FPDFBitmap_BGRA, canvas, canvasStride );
+        if(canvasBitmap == NULL) return -1;
+        FPDFBitmap_FillRect( canvasBitmap, 0, 0, canvasHorSize, canvasVerSize,
+                             0x84, 0x84, 0x84, 255); //Gray
+        FPDFBitmap_Destroy(canvasBitmap);
+    }
+
+    //Visible part of the page, in page pixels
+    int left = (startX < 0)? -startX : 0;
+    int top = (startY < 0)? -startY : 0;
+    int right = canvasHorSize - startX;
+    int bottom = canvasVerSize - startY;
+    if(right > drawSizeHor) right = drawSizeHor;
+    if(bottom > drawSizeVer) bottom = drawSizeVer;
+    if(left >= right || top >= bottom) return 0;
+
+    TileKey key;
+    key.pageIndex = pageIndex;
+    key.pageWidth = drawSizeHor;
+    key.pageHeight = drawSizeVer;
+
+    int rendered = 0;
+    for(key.tileY = top / tileSize; key.tileY * tileSize < bottom; key.tileY++){
+        for(key.tileX = left / tileSize; key.tileX * tileSize < right; key.tileX++){
+            int tileLeft = key.tileX * tileSize;
+            int tileTop = key.tileY * tileSize;
+
+            //Part of this tile that is visible
+            int x0 = (tileLeft > left)? tileLeft : left;
+            int y0 = (tileTop > top)? tileTop : top;
+            int x1 = (tileLeft + tileSize < right)? tileLeft + tileSize : right;
+            int y1 = (tileTop + tileSize < bottom)? tileTop + tileSize : bottom;
+            unsigned char *dst = canvasBits + (y0 + startY) * canvasStride + (x0 + startX) * 4;
+
+            if(cache->draw(key, x0 - tileLeft, y0 - tileTop, x1 - x0, y1 - y0, dst, canvasStride)){
+                continue;
+            }
+
+            int tileWidth = tileExtent(key.tileX, drawSizeHor);
+            int tileHeight = tileExtent(key.tileY, drawSizeVer);
+            TileCache::Tile tile;
+            if(!renderTile(page, key, tileWidth, tileHeight, token, &tile)) return -1;
+            rendered++;
+
+            //Draw before handing it over, the cache may drop it right away
+            int tileStride = tileWidth * 4;
+            copyRows(dst, canvasStride,
+                     tile.pixels + (y0 - tileTop) * tileStride + (x0 - tileLeft) * 4, tileStride,
+                     (x1 - x0) * 4, y1 - y0);
+            cache->put(key, tile);
+        }
+    }
+    return rendered;
+}
+
+bool prefetchPageTile(TileCache *cache, FPDF_PAGE page, const TileKey &key, CancelToken *token){
+    if(cache->contains(key)) return true;
+
+    TileCache::Tile tile;
+    if(!renderTile( page, key, tileExtent(key.tileX, key.pageWidth), tileExtent(key.tileY, key.pageHeight),
+                    token, &tile )) return false;
+    tile.prefetched = true;
+    cache->put(key, tile);
+    return true;
+}
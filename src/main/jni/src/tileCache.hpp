@@ -0,0 +1,121 @@
+#ifndef _TILE_CACHE_HPP_
+#define _TILE_CACHE_HPP_
+
+extern "C" {
+    #include <stdint.h>
+    #include <stddef.h>
+    #include <stdlib.h>
+}
+
+#include <utils/Mutex.h>
+
+#include <fpdfview.h>
+
+#include "lruCache.hpp"
+#include "renderControl.hpp"
+
+/**
+ * Addresses a square of a page rendered at one scale.
+ * Tiles are composed 1:1 into the window, so the zoom level is the exact
+ * pixel size of the whole rendered page rather than a rounded factor.
+ */
+struct TileKey {
+    int pageIndex;
+    int pageWidth;
+    int pageHeight;
+    int tileX;
+    int tileY;
+
+    bool operator<(const TileKey &other) const {
+        if(pageIndex != other.pageIndex) return pageIndex < other.pageIndex;
+        if(pageWidth != other.pageWidth) return pageWidth < other.pageWidth;
+        if(pageHeight != other.pageHeight) return pageHeight < other.pageHeight;
+        if(tileY != other.tileY) return tileY < other.tileY;
+        return tileX < other.tileX;
+    }
+};
+
+/**
+ * Rendered tiles of one document, RGBA rows ready to be copied into a window
+ * buffer. LRU bounded by the bytes of pixel data it holds.
+ */
+class TileCache {
+    public:
+    static const int kTileSize = 256;
+    static const size_t kDefaultMaxBytes = 16 * 1024 * 1024;
+
+    struct Tile {
+        int width;
+        int height;
+        unsigned char *pixels;
+        //Rendered ahead of time and not drawn yet
+        bool prefetched;
+    };
+
+    //Counted since the cache was created
+    struct Stats {
+        int64_t hits;
+        int64_t misses;
+        int64_t prefetched;
+        //Prefetched tiles that were drawn later
+        int64_t prefetchUsed;
+        //Prefetched tiles evicted without ever being drawn
+        int64_t prefetchWasted;
+    };
+
+    explicit TileCache(size_t maxBytes);
+    ~TileCache();
+
+    bool contains(const TileKey &key);
+    //Copies part of a cached tile into dst, false if the tile isn't cached
+    bool draw(const TileKey &key, int srcX, int srcY, int width, int height,
+              unsigned char *dst, int dstStride);
+    //Takes over the pixels, which must come from malloc
+    void put(const TileKey &key, const Tile &tile);
+
+    void setMaxBytes(size_t maxBytes);
+    size_t getMaxBytes();
+    //Drops the oldest tiles until at most keepBytes remain, returns the number dropped
+    int trim(size_t keepBytes);
+    void clear();
+    void getStats(Stats *outStats);
+
+    private:
+    class TileFreer : public BoundedLruCache<TileKey, Tile>::OnEntryRemoved {
+        public:
+        explicit TileFreer(Stats *stats) : stats(stats) {}
+        void operator()(const TileKey &key, Tile &tile){
+            if(tile.prefetched) stats->prefetchWasted++;
+            free(tile.pixels);
+        }
+
+        private:
+        Stats *stats;
+    };
+
+    android::Mutex cacheLock;
+    BoundedLruCache<TileKey, Tile> tiles;
+    Stats stats;
+    TileFreer tileFreer;
+};
+
+/*
+ * Composes the visible part of a page into an RGBA canvas from cached tiles,
+ * rendering only the ones missing. startX/startY and drawSizeHor/drawSizeVer
+ * place the whole page on the canvas, like FPDF_RenderPageBitmap's arguments.
+ * Returns the number of tiles rendered, -1 on failure or when token (may be NULL)
+ * got cancelled.
+ */
+int drawPageTiles(TileCache *cache, FPDF_PAGE page, int pageIndex,
+                  void *canvas, int canvasStride, int canvasHorSize, int canvasVerSize,
+                  int startX, int startY, int drawSizeHor, int drawSizeVer,
+                  CancelToken *token);
+
+/*
+ * Renders one tile of a page drawn at key.pageWidth x key.pageHeight into the
+ * cache ahead of time, unless it is cached already.
+ * Returns false if it had to be rendered and that failed or got cancelled.
+ */
+bool prefetchPageTile(TileCache *cache, FPDF_PAGE page, const TileKey &key, CancelToken *token);
+
+#endif
@@ -0,0 +1,127 @@
+#include "util.hpp"
+#include "viewportRender.hpp"
+#include "bitmapRender.hpp"
+
+extern "C" {
+    #include <stdlib.h>
+    #include <string.h>
+}
+
+ViewportRender::ViewportRender() :
+        pixels(NULL),
+        canvasHorSize(0),
+        canvasVerSize(0),
+        valid(false),
+        pageIndex(-1),
+        startX(0),
+        startY(0),
+        drawSizeHor(0),
+        drawSizeVer(0),
+        renderedArea(0) {}
+
+ViewportRender::~ViewportRender(){
+    free(pixels);
+}
+
+bool ViewportRender::resizeCanvas(int horSize, int verSize){
+    if(pixels != NULL && horSize == canvasHorSize && verSize == canvasVerSize) return true;
+
+    free(pixels);
+    valid = false;
+    canvasHorSize = canvasVerSize = 0;
+    pixels = (unsigned char*)malloc(horSize * verSize * 4);
+    if(pixels == NULL){
+        LOGE("Allocating viewport canvas failed");
+        return false;
+    }
+    canvasHorSize = horSize;
+    canvasVerSize = verSize;
+    return true;
+}
+
+//Moves the picture by dx/dy pixels, the part moved out of the canvas is lost
+void ViewportRender::shiftCanvas(int dx, int dy){
+    int stride = canvasHorSize * 4;
+    int rowBytes = (canvasHorSize - abs(dx)) * 4;
+    int rows = canvasVerSize - abs(dy);
+    unsigned char *dst = pixels + ((dx > 0)? dx * 4 : 0);
+    const unsigned char *src = pixels + ((dx < 0)? -dx * 4 : 0);
+    int i;
+
+    //Walk away from the rows being written, so none is overwritten before it moved
+    if(dy > 0){
+        for(i = rows - 1; i >= 0; i--){
+            memmove(dst + (i + dy) * stride, src + i * stride, rowBytes);
+        }
+    }else{
+        for(i = 0; i < rows; i++){
+            memmove(dst + i * stride, src + (i - dy) * stride, rowBytes);
+        }
+    }
+}
+
+RenderStatus ViewportRender::renderRect(FPDF_PAGE page, int x, int y, int horSize, int verSize,
+                                        CancelToken *token){
+    renderedArea += horSize * verSize;
+    return renderPageToBuffer( page, pixels + y * canvasHorSize * 4 + x * 4,
+                               horSize, verSize, canvasHorSize * 4, PIXEL_FORMAT_RGBA_8888,
+                               startX - x, startY - y, drawSizeHor, drawSizeVer, token );
+}
+
+RenderStatus ViewportRender::render(FPDF_PAGE page, int pageIndex,
+                                    int canvasHorSize, int canvasVerSize,
+                                    int startX, int startY, int drawSizeHor, int drawSizeVer,
+                                    CancelToken *token){
+    renderedArea = 0;
+    if(page == NULL || canvasHorSize <= 0 || canvasVerSize <= 0) return RENDER_FAILED;
+    if(!resizeCanvas(canvasHorSize, canvasVerSize)) return RENDER_FAILED;
+
+    int dx = startX - this->startX;
+    int dy = startY - this->startY;
+    bool scrolled = valid &&
+                    pageIndex == this->pageIndex &&
+                    drawSizeHor == this->drawSizeHor && drawSizeVer == this->drawSizeVer &&
+                    abs(dx) < canvasHorSize && abs(dy) < canvasVerSize;
+
+    valid = false;
+    this->pageIndex = pageIndex;
+    this->startX = startX;
+    this->startY = startY;
+    this->drawSizeHor = drawSizeHor;
+    this->drawSizeVer = drawSizeVer;
+
+    RenderStatus status = RENDER_DONE;
+    if(!scrolled){
+        status = renderRect(page, 0, 0, canvasHorSize, canvasVerSize, token);
+    }else if(dx != 0 || dy != 0){
+        shiftCanvas(dx, dy);
+
+        //Full width strip at the top or bottom, then the rest of the left or right edge
+        if(dy != 0){
+            status = renderRect( page, 0, (dy > 0)? 0 : canvasVerSize + dy,
+                                 canvasHorSize, abs(dy), token );
+        }
+        if(status == RENDER_DONE && dx != 0){
+            status = renderRect( page, (dx > 0)? 0 : canvasHorSize + dx, (dy > 0)? dy : 0,
+                                 abs(dx), canvasVerSize - abs(dy), token );
+        }
+    }
+
+    valid = (status == RENDER_DONE);
+    return status;
+}
+
+void ViewportRender::copyTo(void *dst, int dstStride, int dstHorSize, int dstVerSize) const {
+    if(pixels == NULL) return;
+
+    int rowBytes = ((dstHorSize < canvasHorSize)? dstHorSize : canvasHorSize) * 4;
+    int rows = (dstVerSize < canvasVerSize)? dstVerSize : canvasVerSize;
+    unsigned char *dstRow = reinterpret_cast<unsigned char*>(dst);
+    const unsigned char *srcRow = pixels;
+    int i;
+    for(i = 0; i < rows; i++){
+        memcpy(dstRow, srcRow, rowBytes);
+        dstRow += dstStride;
+        srcRow += canvasHorSize * 4;
+    }
+}
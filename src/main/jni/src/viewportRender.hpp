@@ -0,0 +1,56 @@
+#ifndef _VIEWPORT_RENDER_HPP_
+#define _VIEWPORT_RENDER_HPP_
+
+#include <fpdfview.h>
+
+#include "renderControl.hpp"
+
+/**
+ * Viewport of a page that remembers its last frame, so scrolling at a fixed
+ * zoom doesn't render the whole viewport again: the still visible part of the
+ * picture is moved in place and only the strips that came into view are
+ * rendered, through bitmaps wrapping sub-rectangles of the canvas.
+ * Any other change (page, zoom, canvas size) or an unfinished frame makes the
+ * next frame a full render.
+ *
+ * The frame lives in the viewport's own RGBA canvas rather than the window:
+ * a locked window buffer holds whatever was posted with it a few frames ago.
+ * Not thread safe, callers guard it with the document lock.
+ */
+class ViewportRender {
+    public:
+    ViewportRender();
+    ~ViewportRender();
+
+    //Renders the page placed like in FPDF_RenderPageBitmap into a canvas of the given size
+    RenderStatus render(FPDF_PAGE page, int pageIndex,
+                        int canvasHorSize, int canvasVerSize,
+                        int startX, int startY, int drawSizeHor, int drawSizeVer,
+                        CancelToken *token);
+
+    //Copies the current frame into an RGBA buffer, clipped to both sizes
+    void copyTo(void *dst, int dstStride, int dstHorSize, int dstVerSize) const;
+
+    //Drops the last frame, e.g. after the page content changed
+    void invalidate(){ valid = false; }
+    //Pixels rendered by pdfium for the last frame, canvas size for a full render
+    int getRenderedArea() const { return renderedArea; }
+
+    private:
+    ViewportRender(const ViewportRender&); //Disallow copy
+
+    unsigned char *pixels;
+    int canvasHorSize, canvasVerSize;
+    //Set while the canvas holds a complete picture of the placement below
+    bool valid;
+    int pageIndex;
+    int startX, startY;
+    int drawSizeHor, drawSizeVer;
+    int renderedArea;
+
+    bool resizeCanvas(int horSize, int verSize);
+    void shiftCanvas(int dx, int dy);
+    RenderStatus renderRect(FPDF_PAGE page, int x, int y, int horSize, int verSize, CancelToken *token);
+};
+
+#endif